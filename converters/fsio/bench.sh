@@ -0,0 +1,187 @@
+#!/bin/sh
+#
+# Benchmark and regression harness for fsio.
+#
+# Usage: bench.sh [-k] [-f files] [-s "sizes"] fsio fstype...
+#
+#       -k              keep the work directory
+#       -f files        # of files to create on each volume (default 100)
+#       -s sizes        file sizes (in bytes) assigned to the files in
+#                       rotation (default "512 2048 8192 20000")
+#
+# For each file system type (rt11, os8 or dos11) a synthetic RK05 volume is
+# created with "newfs" and populated with generated files. The volume is
+# then put through mount, dir, copy out and delete phases. Each phase runs
+# as a separate fsio invocation and is timed; the number of operations,
+# ops/s, bytes/s and the read/write system calls reported by "fsio -s" are
+# displayed.
+#
+# The harness also checks the results. The directory must list every file
+# after population and none after deletion, files copied out must match
+# the originals and fsio must not report any errors. Enough files are
+# created to force directory segments to be split, so regressions in that
+# code are caught. The exit status is non-zero if any check failed.
+#
+
+files=100
+sizes="512 2048 8192 20000"
+keep=0
+
+while getopts "f:ks:" opt; do
+  case $opt in
+    f) files=$OPTARG ;;
+    k) keep=1 ;;
+    s) sizes=$OPTARG ;;
+    *) echo "Usage: $0 [-k] [-f files] [-s sizes] fsio fstype..." >&2
+       exit 2 ;;
+  esac
+done
+shift `expr $OPTIND - 1`
+
+if [ $# -lt 2 ]; then
+  echo "Usage: $0 [-k] [-f files] [-s sizes] fsio fstype..." >&2
+  exit 2
+fi
+
+case $1 in
+  /*) fsio=$1 ;;
+  *) fsio=`pwd`/$1 ;;
+esac
+shift
+
+work=`mktemp -d ${TMPDIR:-/tmp}/fsiobench.XXXXXX` || exit 2
+if [ $keep -eq 0 ]; then
+  trap 'rm -rf $work' 0
+else
+  echo "Work directory: $work"
+fi
+cd $work || exit 2
+
+failed=0
+
+fail() {
+  echo "FAIL: $fs: $*"
+  failed=1
+}
+
+now() {
+  date +%s%N
+}
+
+#
+# Generate the source files. Each file is a different slice of a pool of
+# random data so that misplaced blocks are detected.
+#
+max=0
+for size in $sizes; do
+  [ $size -gt $max ] && max=$size
+done
+head -c `expr $max + $files \* 512` /dev/urandom > pool
+
+mkdir src
+i=1
+total=0
+while [ $i -le $files ]; do
+  for size in $sizes; do
+    [ $i -le $files ] || break
+    name=`printf "F%05d" $i`
+    tail -c +`expr $i \* 512` pool | head -c $size > src/$name
+    total=`expr $total + $size`
+    i=`expr $i + 1`
+  done
+done
+
+#
+# Run an fsio command script, timing it and reporting the results.
+#
+#       $1      phase name
+#       $2      # of operations performed by the script
+#       $3      # of bytes transferred by the script
+#
+run() {
+  start=`now`
+  $fsio -q -s script > out 2> err
+  end=`now`
+
+  if [ -s err ]; then
+    fail "$1: fsio reported errors"
+    sed -e 's/^/    /' err
+  fi
+
+  syscalls=`awk '/System calls:/ { print $3 + $5 }' out`
+  awk -v fs=$fs -v phase=$1 -v ops=$2 -v bytes=$3 \
+      -v ns=`expr $end - $start` -v sc="${syscalls:-n/a}" 'BEGIN {
+    secs = ns / 1000000000;
+    if (secs <= 0)
+      secs = 0.000001;
+    printf("%-6s %-9s %6d %9.3f %10.1f %12.0f %10s\n",
+           fs, phase, ops, secs, ops / secs, bytes / secs, sc);
+  }'
+}
+
+#
+# Count the generated files present in a directory listing.
+#
+count() {
+  grep -c 'F[0-9][0-9][0-9][0-9][0-9] *\.BN' out
+}
+
+printf "%-6s %-9s %6s %9s %10s %12s %10s\n" \
+       "fs" "phase" "ops" "seconds" "ops/s" "bytes/s" "syscalls"
+
+for fs in "$@"; do
+  case $fs in
+    rt11) type="-t rk05"; mtype=""; setup="" ;;
+    os8) type="-t rk05"; mtype="-t rk05"; setup="" ;;
+    dos11) type=""; mtype=""; setup="set dk: ufd [1,1]" ;;
+    *) fail "unsupported file system type"; continue ;;
+  esac
+
+  rm -rf vol.dsk dst
+  mkdir dst
+
+  echo "newfs $type vol.dsk $fs" > script
+  run newfs 1 0
+
+  echo "mount $mtype dk vol.dsk $fs" > script
+  [ -n "$setup" ] && echo "$setup" >> script
+  for name in `ls src`; do
+    echo "copy src/$name dk:$name.BN" >> script
+  done
+  run copyin $files $total
+
+  echo "mount -r $mtype dk vol.dsk $fs" > script
+  run mount 1 0
+
+  echo "dir dk:" >> script
+  run dir 1 0
+  n=`count`
+  [ "$n" -eq $files ] || fail "dir: $n of $files files listed"
+
+  echo "mount -r $mtype dk vol.dsk $fs" > script
+  for name in `ls src`; do
+    echo "copy dk:$name.BN dst/$name" >> script
+  done
+  run copyout $files $total
+
+  for name in `ls src`; do
+    size=`wc -c < src/$name`
+    if ! cmp -s -n $size src/$name dst/$name; then
+      fail "copyout: $name differs"
+    fi
+  done
+
+  echo "mount $mtype dk vol.dsk $fs" > script
+  for name in `ls src`; do
+    echo "delete dk:$name.BN" >> script
+  done
+  run delete $files 0
+
+  printf "mount -r $mtype dk vol.dsk $fs\ndir dk:\n" > script
+  $fsio -q script > out 2> err
+  n=`count`
+  [ -s err ] && fail "remount after delete: `head -1 err`"
+  [ "$n" -eq 0 ] || fail "delete: $n files remain"
+done
+
+exit $failed
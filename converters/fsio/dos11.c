@@ -40,7 +40,6 @@
 
 #include "fsio.h"
 
-extern uint16_t bits[], lowbits[], highbits[];
 extern uint8_t zeroes[];
 
 /*
@@ -57,12 +56,10 @@ static char *setCmds[] = {
 static uint16_t bitmapAllocBlock(struct mountedFS *);
 static uint16_t bitmapAllocContiguous(struct mountedFS *, uint16_t);
 static int bitmapFlush(struct mountedFS *);
-static int bitmapLoad(struct mountedFS *, uint16_t);
+static int bitmapLoad(struct mountedFS *);
+static void bitmapUnload(struct mountedFS *);
 static int bitmapReleaseBlock(struct mountedFS *, uint16_t);
-static int bitmapScan(struct mountedFS *, uint16_t, uint16_t, uint16_t *);
-static int bitmapClrBit(struct mountedFS *, uint16_t);
 static int bitmapSetBit(struct mountedFS *, uint16_t);
-static int bitmapGetWord(struct mountedFS *, uint16_t, uint16_t *);
 
 int dos11CreateFile(struct mountedFS *, struct dos11FileSpec *, struct dos11OpenFile *, unsigned long);
 int dos11LookupFile(struct mountedFS *, struct dos11FileSpec *, struct dos11OpenFile *);
@@ -79,454 +76,514 @@ extern char **words;
 extern int quiet;
 
 /*++
- *      b i t m a p A l l o c B l o c k
+ *      c t z 6 4
  *
- *  Find an unsed block and allocate it. Ths scan will start at the first
- *  known location of a free block (or 0 if this is the first scan) and will
- *  will remember this location to reduce the amount of scanning required
- *  for subsequent allocations.
+ *  Count the trailing zero bits in a non-zero 64-bit value.
  *
  * Inputs:
  *
- *      mount           - pointer to a mounted file system descriptor
+ *      value           - value to be examined (must not be 0)
  *
  * Outputs:
  *
- *      If the allocation is successful, the bitmap will be updated in
- *      memory and the bitmap buffer marked as dirty.
+ *      None
  *
  * Returns:
  *
- *      Allocated block # if successful, 0 otherwise
+ *      # of trailing zero bits
  *
  --*/
-static uint16_t bitmapAllocBlock(
-  struct mountedFS *mount
+static inline unsigned int ctz64(
+  uint64_t value
 )
 {
-  struct DOS11data *data = &mount->dos11data;
-  uint16_t map = data->bmscan / MAP_BLOCKS;
-  uint16_t offset = data->bmscan % MAP_BLOCKS;
+#ifdef __GNUC__
+  return __builtin_ctzll(value);
+#else
+  unsigned int count = 0;
 
-  /*
-   * Iterate across all available bitmaps.
-   */
-  while (map < data->bitmaps) {
-    uint16_t wrd = offset / 16;
-    uint16_t bit = offset % 16;
+  while ((value & 1) == 0) {
+    value >>= 1;
+    count++;
+  }
+  return count;
+#endif
+}
 
-    if (bitmapLoad(mount, map) == 0)
-      return 0;
+/*++
+ *      c l z 6 4
+ *
+ *  Count the leading zero bits in a non-zero 64-bit value.
+ *
+ * Inputs:
+ *
+ *      value           - value to be examined (must not be 0)
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      # of leading zero bits
+ *
+ --*/
+static inline unsigned int clz64(
+  uint64_t value
+)
+{
+#ifdef __GNUC__
+  return __builtin_clzll(value);
+#else
+  unsigned int count = 0;
 
-    /*
-     * Iterate across a single bitmap.
-     */
-    while (wrd < MAP_LEN) {
-      uint16_t val = le16toh(data->bmbuf[MAP_BMSTART + wrd]);
-
-      if (val != 0177777) {
-        data->bmscan = (map * MAP_BLOCKS) + (wrd * 16);
-
-        while (bit < 16) {
-          if ((val & bits[bit]) == 0) {
-            val |= bits[bit];
-            data->bmbuf[MAP_BMSTART + wrd] = htole16(val);
-            data->bmdirty = 1;
-            return (map * MAP_BLOCKS) + (wrd * 16) + bit;
-          }
-          bit++;
-        }
-      }
-      wrd++;
-      bit = 0;
-    }
-    map++;
-    offset = 0;
+  while ((value & 0x8000000000000000ULL) == 0) {
+    value <<= 1;
+    count++;
   }
-  return 0;
+  return count;
+#endif
 }
-
+
 /*++
- *      b i t m a p A l l o c C o n t i g u o u s
+ *      b i t m a p W o r d
  *
- *  Find a sequence of contiguous bits in the bitmaps and allocate them.
+ *  Return a 64-bit word of the in-memory bitmap. Bits for blocks beyond the
+ *  end of the file system are returned as allocated.
  *
  * Inputs:
  *
- *      mount           - pointer to a mounted file system descriptor
- *      count           - # of contiguous blocks to allocate
+ *      data            - pointer to the DOS-11 specific data area
+ *      idx             - index of the 64-bit word
  *
  * Outputs:
  *
- *      If the allocation is successful, the bitmap will be updated in
- *      memory and possibly on disk. The last referenced bitmap will be
- *      marked as dirty.
+ *      None
  *
  * Returns:
  *
- *      First allocated block # if successful, 0 otherwise
+ *      Bitmap word (1 => allocated)
  *
  --*/
-static uint16_t bitmapAllocContiguous(
-  struct mountedFS *mount,
-  uint16_t count
+static inline uint64_t bitmapWord(
+  struct DOS11data *data,
+  unsigned int idx
 )
 {
-  struct DOS11data *data = &mount->dos11data;
-  uint16_t map, offset, scan = data->bmscan;
-  uint16_t i;
-  uint8_t first = 1;
-
-  /*
-   * Check that the request is reasonable
-   */
-  if (count >= data->blocks)
-    return 0;
+  unsigned int first = idx * 64;
 
- restart:
-  /*
-   * Make sure that there may be sufficient space to satisfy the request.
-   */
-  if (((data->blocks - 1) - scan) < count)
-    return 0;
+  if (first >= data->bmlimit)
+    return ~(uint64_t)0;
 
-  map = scan / MAP_BLOCKS;
-  offset = scan % MAP_BLOCKS;
+  if ((data->bmlimit - first) < 64)
+    return data->bitmap[idx] | (~(uint64_t)0 << (data->bmlimit - first));
 
-  /*
-   * Iterate across all available bitmaps.
-   */
-  while (map < data->bitmaps) {
-    uint16_t wrd = offset / 16;
+  return data->bitmap[idx];
+}
 
-    if (bitmapLoad(mount, map) == 0)
-      return 0;
+/*++
+ *      b i t m a p F i n d R u n
+ *
+ *  Search a range of the in-memory bitmap for free blocks, 64 blocks at a
+ *  time. Runs of allocated and free blocks are skipped using ctz64().
+ *
+ * Inputs:
+ *
+ *      data            - pointer to the DOS-11 specific data area
+ *      from            - first block # to search
+ *      to              - search up to (but not including) this block #
+ *      count           - # of contiguous free blocks required
+ *                        0 means find the largest free run
+ *      start           - return the first block # of the run here
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      Length of the free run found, 0 if none
+ *
+ --*/
+static unsigned int bitmapFindRun(
+  struct DOS11data *data,
+  unsigned int from,
+  unsigned int to,
+  unsigned int count,
+  unsigned int *start
+)
+{
+  unsigned int pos = from, run = 0, runstart = from, best = 0;
 
-    /*
-     * Iterate across a single bitmap.
-     */
-    while (wrd < MAP_LEN) {
-      uint16_t val = le16toh(data->bmbuf[MAP_BMSTART + wrd]);
-
-      if (val != 0177777) {
-        if (first) {
-          /*
-           * Update cache of where to start scanning
-           */
-          data->bmscan = (map * MAP_BLOCKS) + (wrd * 16);
-          first = 0;
-        }
+  while (pos < to) {
+    unsigned int shift = pos % 64, avail = 64 - shift, n;
+    uint64_t value = bitmapWord(data, pos / 64) >> shift;
 
-        if (count <= 16) {
-          /*
-           * The required blocks could fit into a single. See if that is the
-           * case.
-           */
-          uint16_t mask = lowbits[count - 1];
+    if (avail > (to - pos))
+      avail = to - pos;
 
-          for (i = 0; i < (17 - count); i++)
-            if ((val & (mask << i)) == 0) {
-              /*
-               * We have a fit. Allocate the space.
-               */
-              val |= (mask << i);
-              data->bmbuf[MAP_BMSTART + wrd] = htole16(val);
-              data->bmdirty = 1;
-              return (map * MAP_BLOCKS) + (wrd * 16) + i;
-            }
-        }
+    if ((value & 1) != 0) {
+      /*
+       * Skip over allocated blocks.
+       */
+      n = ~value == 0 ? 64 : ctz64(~value);
+      run = 0;
+    } else {
+      /*
+       * Accumulate free blocks.
+       */
+      n = value == 0 ? avail : ctz64(value);
+      if (run == 0)
+        runstart = pos;
+      if (n > avail)
+        n = avail;
+      run += n;
+
+      if ((count != 0) && (run >= count)) {
+        *start = runstart;
+        return run;
+      }
 
-        /*
-         * Let's see if we can make use of the last blocks described by
-         * this word.
-         */
-        if ((val & 0100000) == 0) {
-          uint16_t base = (map * MAP_BLOCKS) + (wrd * 16);
-
-          /*
-           * See how many bits we can use
-           */
-          for (i = 1; i <= 16; i++)
-            if ((val & highbits[i]) != 0)
-              break;
-
-          if (bitmapScan(mount, count - i, base + 16, &scan) == 0)
-            goto restart;
-
-          base = base + 16 - i;
-
-          /*
-           * Allocate the blocks
-           */
-          for (i = 0; i < count; i++)
-            if (bitmapSetBit(mount, base + i) == 0)
-              return 0;
-          
-          return base;
-        }
+      if (run > best) {
+        best = run;
+        *start = runstart;
       }
-      wrd++;
     }
-    map++;
-    offset = 0;
+    pos += n;
   }
-  return 0;
+  return count == 0 ? best : 0;
 }
-
+
 /*++
- *      b i t m a p F l u s h
+ *      b i t m a p S u m m a r y
  *
- *  If the currently loaded bitmap is dirty, write it back to disk.
+ *  Return the free space summary for a bitmap, recomputing it if the
+ *  bitmap has been modified since it was last computed.
  *
  * Inputs:
  *
- *      mount           - pointer to a mounted file system descriptor
+ *      data            - pointer to the DOS-11 specific data area
+ *      map             - logical bitmap # in the range 0 - N
  *
  * Outputs:
  *
- *      None
+ *      The free space summary may be updated
  *
  * Returns:
  *
- *      1 if successful, 0 otherwise
+ *      Pointer to the free space summary
  *
  --*/
-static int bitmapFlush(
-  struct mountedFS *mount
+static struct bitmapSummary *bitmapSummary(
+  struct DOS11data *data,
+  uint16_t map
 )
 {
-  struct DOS11data *data = &mount->dos11data;
+  struct bitmapSummary *sum = &data->bmsum[map];
 
-  if (data->bmdirty != 0) {
-    if (dos11WriteBlock(mount, data->bmblk[data->bmindex], data->bmbuf) == 0)
-      return 0;
-    data->bmdirty = 0;
+  if (data->bmvalid[map] == 0) {
+    unsigned int i, first = map * MAP_LEN64, start;
+
+    sum->head = sum->tail = 0;
+
+    for (i = 0; i < MAP_LEN64; i++) {
+      uint64_t value = bitmapWord(data, first + i);
+
+      if (value != 0) {
+        sum->head += ctz64(value);
+        break;
+      }
+      sum->head += 64;
+    }
+
+    for (i = MAP_LEN64; i != 0; i--) {
+      uint64_t value = bitmapWord(data, first + i - 1);
+
+      if (value != 0) {
+        sum->tail += clz64(value);
+        break;
+      }
+      sum->tail += 64;
+    }
+
+    sum->run = bitmapFindRun(data, map * MAP_BLOCKS,
+                             (map + 1) * MAP_BLOCKS, 0, &start);
+    data->bmvalid[map] = 1;
   }
-  return 1;
+  return sum;
 }
-
+
 /*++
- *      b i t m a p L o a d
+ *      b i t m a p M o d i f y
  *
- *  Load the specified bitmap into the bitmap buffer. If the buffer is dirty,
- *  write the current contents of the buffer back to disk before loading the
- *  new bitmap.
+ *  Set or clear a sequence of bits in the in-memory bitmap.
  *
  * Inputs:
  *
  *      mount           - pointer to a mounted file system descriptor
- *      map             - logical bitmap # in the range 0 - N
+ *      block           - first block # to modify
+ *      count           - # of blocks to modify
+ *      set             - 1 to allocate the blocks, 0 to release them
  *
  * Outputs:
  *
- *      None
+ *      The bitmap will be updated and the affected maps marked as dirty.
  *
  * Returns:
  *
  *      1 if successful, 0 otherwise
  *
  --*/
-static int bitmapLoad(
+static int bitmapModify(
   struct mountedFS *mount,
-  uint16_t map
+  unsigned int block,
+  unsigned int count,
+  int set
 )
 {
   struct DOS11data *data = &mount->dos11data;
+  unsigned int end = block + count;
 
-  if (map >= data->bitmaps) {
-    ERROR("Invalid bitmap # (%d), max is %d\n", map, data->bitmaps);
+  if (end > (data->bitmaps * MAP_BLOCKS)) {
+    ERROR("Invalid bitmap # (%d), max is %d\n",
+          (end - 1) / MAP_BLOCKS, data->bitmaps);
     return 0;
   }
 
-  /*
-   * If the map is already loaded, nothing to do.
-   */
-  if (map != data->bmindex) {
-    if (data->bmdirty != 0) {
-      if (dos11WriteBlock(mount, data->bmblk[data->bmindex], data->bmbuf) == 0)
-        return 0;
-      data->bmdirty = 0;
-    }
+  while (block < end) {
+    unsigned int shift = block % 64, n = 64 - shift;
+    uint64_t mask;
 
-    data->bmindex = map;
-    if (dos11ReadBlock(mount, data->bmblk[map], data->bmbuf) == 0)
-      return 0;
-  }
+    if (n > (end - block))
+      n = end - block;
 
+    mask = (n == 64 ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1)) << shift;
+
+    if (set)
+      data->bitmap[block / 64] |= mask;
+    else data->bitmap[block / 64] &= ~mask;
+
+    data->bmdirty[block / MAP_BLOCKS] = 1;
+    data->bmvalid[block / MAP_BLOCKS] = 0;
+    block += n;
+  }
   return 1;
 }
-
+
 /*++
- *      b i t m a p R e l e a s e B l o c k
+ *      b i t m a p A l l o c B l o c k
  *
- *  Release a specified block in the bitmap.
+ *  Find an unsed block and allocate it. Ths scan will start at the first
+ *  known location of a free block (or 0 if this is the first scan) and will
+ *  will remember this location to reduce the amount of scanning required
+ *  for subsequent allocations.
  *
  * Inputs:
  *
  *      mount           - pointer to a mounted file system descriptor
- *      block           - block # to be released
  *
  * Outputs:
  *
- *      The bitmap will be updated by releasing the block and the bitmap
- *      will be marked as dirty.
+ *      If the allocation is successful, the bitmap will be updated in
+ *      memory and the bitmap marked as dirty.
  *
  * Returns:
  *
- *      1 if successful, 0 otherwise
+ *      Allocated block # if successful, 0 otherwise
  *
  --*/
-static int bitmapReleaseBlock(
-  struct mountedFS *mount,
-  uint16_t block
+static uint16_t bitmapAllocBlock(
+  struct mountedFS *mount
 )
 {
-  return bitmapClrBit(mount, block);
+  struct DOS11data *data = &mount->dos11data;
+  unsigned int block;
+
+  if (bitmapFindRun(data, data->bmscan, data->bmlimit, 1, &block) == 0)
+    return 0;
+
+  if (bitmapModify(mount, block, 1, 1) == 0)
+    return 0;
+
+  data->bmscan = block;
+  return block;
 }
-
+
 /*++
- *      b i t m a p S c a n
+ *      b i t m a p A l l o c C o n t i g u o u s
  *
- *  Scan forward from a word boundary to check whether a sequence of blocks
- *  is free.
+ *  Find a sequence of contiguous bits in the bitmaps and allocate them. The
+ *  free space summary of each bitmap is used to skip over bitmaps which
+ *  cannot contain (or start) a large enough run of free blocks.
  *
  * Inputs:
  *
  *      mount           - pointer to a mounted file system descriptor
  *      count           - # of contiguous blocks to allocate
- *      start           - starting block # (always aligned on a 16 block
- *                        boundary)
- *      restart         - return restart point here on failure
  *
  * Outputs:
  *
- *      None
+ *      If the allocation is successful, the bitmap will be updated in
+ *      memory and the affected bitmaps marked as dirty.
  *
  * Returns:
  *
- *      1 on success, 0 otherwise
+ *      First allocated block # if successful, 0 otherwise
  *
  --*/
-static int bitmapScan(
+static uint16_t bitmapAllocContiguous(
   struct mountedFS *mount,
-  uint16_t count,
-  uint16_t start,
-  uint16_t *restart
+  uint16_t count
 )
 {
-  uint16_t value;
+  struct DOS11data *data = &mount->dos11data;
+  unsigned int map, carry = 0, start;
 
-  while (count >= 16) {
-    if ((bitmapGetWord(mount, start, &value) == 0) ||
-        (value != 0)) {
-      *restart = start;
-      return 0;
+  /*
+   * Check that the request is reasonable
+   */
+  if ((count == 0) || (count >= data->blocks))
+    return 0;
+
+  for (map = data->bmscan / MAP_BLOCKS; map < data->bitmaps; map++) {
+    struct bitmapSummary *sum = bitmapSummary(data, map);
+    unsigned int base = map * MAP_BLOCKS;
+
+    /*
+     * A run may continue from the end of the previous bitmap(s).
+     */
+    if ((carry != 0) && ((carry + sum->head) >= count)) {
+      start = base - carry;
+      goto found;
     }
-    start += 16;
-    count -= 16;
+
+    if (sum->run >= count)
+      if (bitmapFindRun(data, base, base + MAP_BLOCKS, count, &start) != 0)
+        goto found;
+
+    carry = sum->head == MAP_BLOCKS ? carry + MAP_BLOCKS : sum->tail;
   }
+  return 0;
 
-  if (count != 0)
-    if ((bitmapGetWord(mount, start, &value) == 0) ||
-        ((value & lowbits[count - 1]) != 0)) {
-      *restart = start;
-      return 0;
-    }
+ found:
+  if (bitmapModify(mount, start, count, 1) == 0)
+    return 0;
 
-  return 1;
+  return start;
 }
-
+
 /*++
- *      b i t m a p C l r B i t
+ *      b i t m a p F l u s h
  *
- *  Modify the bitmap by clearing the bit associated with a specific block.
+ *  Write any modified bitmaps back to disk.
  *
  * Inputs:
  *
  *      mount           - pointer to a mounted file system descriptor
- *      block           - block # whose associated bit is to be cleared
  *
  * Outputs:
  *
- *      The bitmap will be updated by clearing the bit and the bitmap will
- *      be marked as dirty.
+ *      None
  *
  * Returns:
  *
  *      1 if successful, 0 otherwise
  *
  --*/
-static int bitmapClrBit(
-  struct mountedFS *mount,
-  uint16_t block
+static int bitmapFlush(
+  struct mountedFS *mount
 )
 {
   struct DOS11data *data = &mount->dos11data;
-  uint16_t map = block / MAP_BLOCKS;
-  uint16_t offset = block % MAP_BLOCKS;
-  uint16_t wrd = offset / 16;
-  uint16_t bit = offset % 16;
+  uint16_t map;
 
-  if (bitmapLoad(mount, map) == 0)
-    return 0;
+  for (map = 0; map < data->bitmaps; map++)
+    if (data->bmdirty[map] != 0) {
+      uint16_t *buf = &data->bmbuf[map * (mount->blocksz / 2)];
+      unsigned int i;
 
-  data->bmbuf[MAP_BMSTART + wrd] =
-    htole16(le16toh(data->bmbuf[MAP_BMSTART + wrd]) & ~bits[bit]);
-  data->bmdirty = 1;
+      for (i = 0; i < MAP_LEN; i++)
+        buf[MAP_BMSTART + i] =
+          htole16(data->bitmap[(map * MAP_LEN64) + (i / 4)] >> ((i % 4) * 16));
+
+      if (dos11WriteBlock(mount, data->bmblk[map], buf) == 0)
+        return 0;
+      data->bmdirty[map] = 0;
+    }
   return 1;
 }
-
+
 /*++
- *      b i t m a p S e t B i t
+ *      b i t m a p L o a d
  *
- *  Modify the bitmap by setting the bit associated with a specific block.
+ *  Load all of the bitmaps, whose block addresses have already been
+ *  located, into memory.
  *
  * Inputs:
  *
  *      mount           - pointer to a mounted file system descriptor
- *      block           - block # whose associated bit is to be set
  *
  * Outputs:
  *
- *      The bitmap will be updated by setting the bit and the bitmap will
- *      be marked as dirty.
+ *      None
  *
  * Returns:
  *
  *      1 if successful, 0 otherwise
  *
  --*/
-static int bitmapSetBit(
-  struct mountedFS *mount,
-  uint16_t block
+static int bitmapLoad(
+  struct mountedFS *mount
 )
 {
   struct DOS11data *data = &mount->dos11data;
-  uint16_t map = block / MAP_BLOCKS;
-  uint16_t offset = block % MAP_BLOCKS;
-  uint16_t wrd = offset / 16;
-  uint16_t bit = offset % 16;
+  uint16_t map;
+
+  data->bmbuf = malloc(data->bitmaps * mount->blocksz);
+  data->bitmap = malloc(data->bitmaps * MAP_LEN64 * sizeof(uint64_t));
 
-  if (bitmapLoad(mount, map) == 0)
+  if ((data->bmbuf == NULL) || (data->bitmap == NULL)) {
+    ERROR("%s: Unable to allocate bitmap memory\n", mount->name);
+    bitmapUnload(mount);
     return 0;
+  }
+
+  for (map = 0; map < data->bitmaps; map++) {
+    uint16_t *buf = &data->bmbuf[map * (mount->blocksz / 2)];
+    unsigned int i;
+
+    if (dos11ReadBlock(mount, data->bmblk[map], buf) == 0) {
+      bitmapUnload(mount);
+      return 0;
+    }
+
+    for (i = 0; i < MAP_LEN64; i++)
+      data->bitmap[(map * MAP_LEN64) + i] =
+        (uint64_t)le16toh(buf[MAP_BMSTART + (i * 4)]) |
+        ((uint64_t)le16toh(buf[MAP_BMSTART + (i * 4) + 1]) << 16) |
+        ((uint64_t)le16toh(buf[MAP_BMSTART + (i * 4) + 2]) << 32) |
+        ((uint64_t)le16toh(buf[MAP_BMSTART + (i * 4) + 3]) << 48);
+
+    data->bmdirty[map] = 0;
+    data->bmvalid[map] = 0;
+  }
+
+  data->bmscan = 0;
+  data->bmlimit = data->bitmaps * MAP_BLOCKS;
+  if (data->bmlimit > data->blocks)
+    data->bmlimit = data->blocks;
 
-  data->bmbuf[MAP_BMSTART + wrd] =
-    htole16(le16toh(data->bmbuf[MAP_BMSTART + wrd]) | bits[bit]);
-  data->bmdirty = 1;
   return 1;
 }
-
+
 /*++
- *      b i t m a p G e t W o r d
+ *      b i t m a p U n l o a d
  *
- *  Get the bitmap word which contains the bit associated with a specified
- *  block.
+ *  Release the memory used to hold the bitmaps.
  *
  * Inputs:
  *
  *      mount           - pointer to a mounted file system descriptor
- *      block           - block # associated with the bitmap word
- *      value           - bitmap word is returned here
  *
  * Outputs:
  *
@@ -534,27 +591,87 @@ static int bitmapSetBit(
  *
  * Returns:
  *
+ *      None
+ *
+ --*/
+static void bitmapUnload(
+  struct mountedFS *mount
+)
+{
+  struct DOS11data *data = &mount->dos11data;
+
+  free(data->bmbuf);
+  free(data->bitmap);
+  data->bmbuf = NULL;
+  data->bitmap = NULL;
+}
+
+/*++
+ *      b i t m a p R e l e a s e B l o c k
+ *
+ *  Release a specified block in the bitmap.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      block           - block # to be released
+ *
+ * Outputs:
+ *
+ *      The bitmap will be updated by releasing the block and the bitmap
+ *      will be marked as dirty.
+ *
+ * Returns:
+ *
  *      1 if successful, 0 otherwise
  *
  --*/
-static int bitmapGetWord(
+static int bitmapReleaseBlock(
   struct mountedFS *mount,
-  uint16_t block,
-  uint16_t *value
+  uint16_t block
 )
 {
   struct DOS11data *data = &mount->dos11data;
-  uint16_t map = block / MAP_BLOCKS;
-  uint16_t offset = block % MAP_BLOCKS;
-  uint16_t wrd = offset / 16;
 
-  if (bitmapLoad(mount, map) == 0)
+  if (bitmapModify(mount, block, 1, 0) == 0)
     return 0;
 
-  *value = le16toh(data->bmbuf[MAP_BMSTART + wrd]);
+  /*
+   * Make the block available to the next scan.
+   */
+  if (block < data->bmscan)
+    data->bmscan = block;
   return 1;
 }
-
+
+/*++
+ *      b i t m a p S e t B i t
+ *
+ *  Modify the bitmap by setting the bit associated with a specific block.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      block           - block # whose associated bit is to be set
+ *
+ * Outputs:
+ *
+ *      The bitmap will be updated by setting the bit and the bitmap will
+ *      be marked as dirty.
+ *
+ * Returns:
+ *
+ *      1 if successful, 0 otherwise
+ *
+ --*/
+static int bitmapSetBit(
+  struct mountedFS *mount,
+  uint16_t block
+)
+{
+  return bitmapModify(mount, block, 1, 1);
+}
+
 /*++
  *      d o s 1 1 C r e a t e U F D
  *
@@ -632,7 +749,8 @@ static int dos11CreateUFD(
        */
       uint16_t buf[512], newblk;
 
-      if ((newblk = bitmapAllocBlock(mount)) == 0) {
+      if (((newblk = bitmapAllocBlock(mount)) == 0) ||
+          (bitmapFlush(mount) == 0)) {
         ERROR("No space available to extend MFD on \"%s:\"\n", mount->name);
         return 0;
       }
@@ -838,7 +956,7 @@ int dos11CreateFile(
               }
             }
 
-            if ((ufdblk = le16toh(data->buf[UFD_LINK])) == 0) {
+            if ((ufdblk2 = le16toh(data->buf[UFD_LINK])) == 0) {
               if ((ufdblk2 = dos11XtndDirectory(mount)) == 0) {
                 ERROR("%s: Unable to extend UFD\n", mount->name);
                 return 0;
@@ -847,8 +965,8 @@ int dos11CreateFile(
               data->buf[UFD_LINK] = htole16(ufdblk2);
               if (dos11WriteBlock(mount, ufdblk, NULL) == 0)
                 return 0;
-              ufdblk = ufdblk2;
             }
+            ufdblk = ufdblk2;
           }
         }
       }
@@ -1451,6 +1569,7 @@ int dos11WriteBytes(
         file->current = next;
         file->last = htole16(next);
         file->length = htole16(le16toh(file->length) + 1);
+        *((uint16_t *)(file->buffer)) = 0;
         file->nab = 2;
       } else {
         if (dos11WriteBlock(file->mount, file->current, file->buffer) == 0)
@@ -1504,9 +1623,16 @@ static int dos11Mount(
   unsigned int i, freeblocks = 0;
 
   if (fstat(fileno(mount->container), &stat) == 0) {
-    if (stat.st_blocks < DISKSIZE_RK05)
+    /*
+     * Select the block size from the container size (in 256 word units)
+     * rather than the space allocated to it, which will be smaller for
+     * sparse container files.
+     */
+    off_t size = stat.st_size / (BLOCKSIZE_RK11 * 2);
+
+    if (size < DISKSIZE_RK05)
       mount->blocksz = BLOCKSIZE_RF11 * 2;
-    if (stat.st_blocks > DISKSIZE_RK05)
+    if (size > DISKSIZE_RK05)
       mount->blocksz = BLOCKSIZE_RP03 * 2;
 
     data->blocks = stat.st_size / mount->blocksz;
@@ -1567,13 +1693,9 @@ static int dos11Mount(
     } while (mfdblk != 0);
 
     /*
-     * Preload bitmap 0
+     * Load all the bitmaps into memory
      */
-    data->bmindex = 0;
-    data->bmscan = 0;
-    data->bmdirty = 0;
-
-    if (dos11ReadBlock(mount, data->bmblk[0], data->bmbuf) == 0)
+    if (bitmapLoad(mount) == 0)
       return 0;
 
     if (!quiet) {
@@ -1595,7 +1717,8 @@ static int dos11Mount(
 /*++
  *      d o s 1 1 U m o u n t
  *
- *  Unmount the DOS-11 file system, releasing any storage allocated.
+ *  Unmount the DOS-11 file system, writing back any modified bitmaps and
+ *  releasing any storage allocated.
  *
  * Inputs:
  *
@@ -1611,9 +1734,11 @@ static int dos11Mount(
  *
  --*/
 static void dos11Umount(
-  struct mountedFS *UNUSED(mount)
+  struct mountedFS *mount
 )
 {
+  bitmapFlush(mount);
+  bitmapUnload(mount);
 }
 
 /*++
@@ -1636,7 +1761,7 @@ static void dos11Umount(
  --*/
 static size_t dos11Size(void)
 {
-  return DISKSIZE_RK05 * BLOCKSIZE_RK11;
+  return DISKSIZE_RK05 * BLOCKSIZE_RK11 * 2;
 }
 
 /*++
@@ -1672,14 +1797,13 @@ static int dos11Newfs(
 
   memset(data, 0, sizeof(*data));
 
-  data->blocks = size / BLOCKSIZE_RK11;
+  data->blocks = size / mount->blocksz;
   data->bitmaps = 5;
   data->bmblk[0] = MAP_BLOCK;
   data->bmblk[1] = MAP_BLOCK + 1;
   data->bmblk[2] = MAP_BLOCK + 2;
   data->bmblk[3] = MAP_BLOCK + 3;
   data->bmblk[4] = MAP_BLOCK + 4;
-  data->bmindex = 0177777;
 
   /*
    * Build and write MFD Block #1:
@@ -1726,28 +1850,37 @@ static int dos11Newfs(
       return 0;
   }
 
+  if (bitmapLoad(mount) == 0)
+    return 0;
+
   /*
    * Reserve used blocks in the bitmap(s).
    */
-  if (bitmapSetBit(mount, BOOT_BLOCK) == 0)
-    return 0;
-  if (bitmapSetBit(mount, MFD1_BLOCK) == 0)
-    return 0;
-  if (bitmapSetBit(mount, MFD2_BLOCK) == 0)
-    return 0;
+  if ((bitmapSetBit(mount, BOOT_BLOCK) == 0) ||
+      (bitmapSetBit(mount, MFD1_BLOCK) == 0) ||
+      (bitmapSetBit(mount, MFD2_BLOCK) == 0))
+    goto fail;
 
   for (i = 1; i < 6; i++)
     if (bitmapSetBit(mount, MAP_BLOCK + i - 1) == 0)
-      return 0;
+      goto fail;
 
   /*
    * Reserve all blocks past the end of the disk.
    */
   for (i = 4800; i < (5 * MAP_BLOCKS); i++)
     if (bitmapSetBit(mount, i) == 0)
-    return 0;
+      goto fail;
+
+  if (bitmapFlush(mount) == 0)
+    goto fail;
+
+  bitmapUnload(mount);
+  return 1;
 
-  return bitmapFlush(mount);
+ fail:
+  bitmapUnload(mount);
+  return 0;
 }
 
 /*++
@@ -2241,6 +2374,48 @@ static off_t dos11FileSize(
   return le16toh(file->length) * mount->blocksz;
 }
 
+/*++
+ *      d o s 1 1 F i l e E x t e n t
+ *
+ *  Return the location of an open file within the container. Only
+ *  "Contiguous" files qualify; "Linked" files have a link word at the start
+ *  of each block.
+ *
+ * Inputs:
+ *
+ *      filep           - pointer to open file descriptor
+ *      block           - pointer to return the starting block #
+ *      size            - pointer to return the size of the file in bytes
+ *
+ * Outputs:
+ *
+ *      The starting block # and file size are returned if possible
+ *
+ * Returns:
+ *
+ *      1 if the file is a single extent in the container, 0 otherwise
+ *
+ --*/
+static int dos11FileExtent(
+  void *filep,
+  off_t *block,
+  off_t *size
+)
+{
+  struct dos11OpenFile *file = filep;
+  struct mountedFS *mount = file->mount;
+  uint16_t start = le16toh(file->start), last = le16toh(file->last);
+
+  if (((le16toh(file->creation) & UFD_TYPE) == 0) ||
+      (last < start) || ((last - start) >= le16toh(file->length)) ||
+      (le16toh(file->nfb) > mount->blocksz))
+    return 0;
+
+  *block = start;
+  *size = (off_t)(last - start) * mount->blocksz + le16toh(file->nfb);
+  return 1;
+}
+
 /*++
  *      d o s 1 1 D e l e t e F i l e
  *
@@ -2483,6 +2658,7 @@ struct FSdef dos11FS = {
   dos11ReadFile,
   dos11WriteFile,
   dos11DeleteFile,
+  dos11FileExtent,
   NULL,                                 /* No tape support functions */
   NULL,
   NULL,
@@ -188,6 +188,8 @@
 #define MAP_BMSTART             4
 #define MAP_LEN                 60              /* 60 words in each entry */
 #define MAP_BLOCKS              (MAP_LEN * 16)
+#define MAP_LEN64               (MAP_LEN / 4)   /* 64-bit words in a map */
+#define MAP_MAX                 128             /* Max # of bitmaps */
 
 #define FILE_LINK               0
 
@@ -269,18 +271,37 @@ struct dos11OpenFile {
   uint16_t              eob;            /* End of buffer */
 };
 
+/*
+ * Summary of the free space described by a single bitmap, used to skip
+ * over bitmaps which cannot satisfy a contiguous allocation.
+ */
+struct bitmapSummary {
+  uint16_t              head;           /* Free blocks at start of map */
+  uint16_t              tail;           /* Free blocks at end of map */
+  uint16_t              run;            /* Largest free run in map */
+};
+
 /*
  * DOS-11 specific data area. Some fields are sized for the worst case -
  * RP03 disk pack with 65535 blocks of 1024 bytes each.
+ *
+ * All bitmaps are held in memory while the file system is mounted. The
+ * bitmap itself is kept as an array of 64-bit words (block N is bit N % 64
+ * of word N / 64, each map is exactly MAP_LEN64 words) and is written back
+ * to the bitmap blocks on disk by bitmapFlush().
  */
 struct DOS11data {
   unsigned int          blocks;         /* # of blocks in file system */
   uint16_t              bitmaps;        /* # of bitmaps */
-  uint16_t              bmblk[128];     /* Bitmap block addresses */
-  uint16_t              bmindex;        /* Current bitmap in buffer */
+  uint16_t              bmblk[MAP_MAX]; /* Bitmap block addresses */
   uint16_t              bmscan;         /* Start bitmap scans here */
-  uint8_t               bmdirty;        /* 0 => clean, 1 => dirty */
-  uint16_t              bmbuf[512];     /* Buffer for bitmap access */
+  unsigned int          bmlimit;        /* Blocks covered by the bitmap */
+  uint16_t              *bmbuf;         /* Bitmap blocks (bitmaps * */
+                                        /*   blocksz) */
+  uint64_t              *bitmap;        /* In-memory bitmap */
+  uint8_t               bmdirty[MAP_MAX]; /* Map modified since flush */
+  uint8_t               bmvalid[MAP_MAX]; /* Summary is up to date */
+  struct bitmapSummary  bmsum[MAP_MAX]; /* Free space summary per map */
   uint16_t              buf[512];       /* Disk buffer */
   /*
    * Settable parameters
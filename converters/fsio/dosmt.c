@@ -1314,6 +1314,7 @@ struct FSdef dosmtFS = {
   dosmtReadFile,
   dosmtWriteFile,
   NULL,
+  NULL,
   dosmtRewind,
   dosmtEOM,
   dosmtSkipF,
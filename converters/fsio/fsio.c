@@ -191,6 +191,18 @@
  *      is the filename used when opening the file, it may be used in those
  *      cases where it is not possible to delete an open file (e.g. Unix).
  *
+ *  int (*fileExtent)(void *filep, off_t *block, off_t *size)
+ *
+ *      Optional (may be NULL). If a file currently open for reading is
+ *      stored as a single contiguous extent of the container whose bytes
+ *      are exactly the file's binary-mode contents, return 1 with the
+ *      starting block # (in units of the active block size, as used by
+ *      FSioReadBlock()) and the size of the file in bytes. "copy" then
+ *      moves the data with large transfers straight from the container
+ *      instead of calling readFile(). Return 0 if the file is not
+ *      contiguous or needs conversion (e.g. sector interleave, 12-bit
+ *      packing). This routine is never called in ASCII mode.
+ *
  *  void (*rewind)(struct mountedFS *mount)
  *
  *      This function is only valid for magtape container files. Rewind the
@@ -248,20 +260,60 @@
  *              Enables debug output. Such debug code may not be included
  *              in the default build.
  *
+ *        FS_MAPPED
+ *
+ *              The container file has been mapped into memory and the
+ *              FSio* block I/O routines copy directly to/from the mapped
+ *              region rather than using stdio. Set by the "mount" command
+ *              and never set for magtape file systems.
+ *
  *  FILE *container;
  *
  *      The open file handle for performing I/O on file system(s).
  *
+ *  uint8_t *map;
+ *  size_t mapsz;
+ *
+ *      If FS_MAPPED is set, the address and size of the memory-mapped
+ *      container file. File system code should not access these directly,
+ *      all I/O should go through the FSio* routines.
+ *
+ *  struct blockCache *cache;
+ *
+ *      If non-NULL, an LRU cache of file system blocks which sits under
+ *      FSioReadBlock() and FSioWriteBlock(). Modified blocks are written
+ *      back to the container when they are evicted or when the file system
+ *      is unmounted. Sector and blob I/O bypasses the cache but is kept
+ *      coherent with it. The cache is private to fsio.c.
+ *
+ *  struct sectorImage *image;
+ *
+ *      If non-NULL, the entire container (for small, sector-interleaved
+ *      devices such as RX01/RX02 floppies) has been read into memory in
+ *      logical sector order by FSioImageLoad(). File system code accesses
+ *      the image via FSioImageSectors() instead of issuing sector I/O and
+ *      modified sectors are written back when the file system is unmounted.
+ *
  *  union {} FSdata;
  *
  *      Private region for use by the file system code.
  */
+#if defined(__linux__)
+#define _GNU_SOURCE                     /* For copy_file_range() */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
 #include <ctype.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
 
 #include "fsio.h"
 
@@ -311,9 +363,9 @@ struct command {
   cmd_t         func;                   /* Command execution function */
 } cmdTable[] = {
 #ifdef DEBUG
-  { "mount", OPTIONS("dfrt:x"), 3, 3, 0, doMount },
+  { "mount", OPTIONS("c:dfmrst:x"), 3, 3, 0, doMount },
 #else
-  { "mount", OPTIONS("frt:x"), 3, 3, 0, doMount },
+  { "mount", OPTIONS("c:fmrst:x"), 3, 3, 0, doMount },
 #endif
   { "umount", NULL, 1, 1, 0, doUmount },
   { "newfs", OPTIONS("e:t:"), 2, 2, 0, doNewfs },
@@ -354,6 +406,87 @@ FILE *DEBUGout = NULL;
 
 struct mountedFS *mounts;
 
+/*
+ * Batch mode. Each job in a batch manifest runs its command script in a
+ * separate worker process so that switch values, mounted file systems and
+ * the getopt() state are private to the job. Output from each job is
+ * collected in temporary files and reported in manifest order.
+ */
+struct batchJob {
+  char          *image;                 /* Container file for the job */
+  char          *script;                /* Command script for the job */
+  FILE          *out;                   /* Collected stdout */
+  FILE          *err;                   /* Collected stderr */
+  pid_t         pid;                    /* Worker process ID */
+  int           status;                 /* Worker exit status */
+  int           done;                   /* Worker has completed */
+};
+
+/*
+ * Container file name for the current batch job, substituted for "%I" in
+ * command lines. NULL when not running a batch job.
+ */
+static char *batchImage = NULL;
+
+/*
+ * Set if modified data could not be written back to a container file when
+ * it was unmounted, so that fsio exits with a failure status.
+ */
+static int writeFailed = 0;
+
+/*
+ * Container I/O statistics, displayed at exit if requested (-s).
+ */
+static int showStats = 0;
+
+static struct {
+  unsigned long         reads;          /* Container read requests */
+  unsigned long         writes;         /* Container write requests */
+  unsigned long long    rbytes;         /* Bytes read from containers */
+  unsigned long long    wbytes;         /* Bytes written to containers */
+} ioStats;
+
+/*
+ * Block cache. Each cached block is on a doubly linked LRU list (most
+ * recently used first) and on a hash chain indexed by block number.
+ */
+#define CACHE_DEFAULT   256             /* Default # of blocks cached */
+#define CACHE_MAX       65536           /* Maximum # of blocks cached */
+
+struct cacheBlock {
+  struct cacheBlock     *next;          /* LRU list */
+  struct cacheBlock     *prev;
+  struct cacheBlock     *chain;         /* Hash chain */
+  unsigned int          block;          /* Logical block # */
+  uint8_t               dirty;          /* Needs to be written back */
+  uint8_t               data[];         /* Block contents */
+};
+
+struct blockCache {
+  struct cacheBlock     *head;          /* Most recently used */
+  struct cacheBlock     *tail;          /* Least recently used */
+  struct cacheBlock     **hash;         /* Hash table */
+  unsigned int          hashmask;       /* Hash table size - 1 */
+  unsigned int          capacity;       /* Max # of blocks cached */
+  unsigned int          count;          /* Current # of blocks cached */
+  unsigned long         hits;
+  unsigned long         misses;
+  unsigned long         writebacks;
+};
+
+#define CACHEHASH(c, b) (((b) ^ ((b) >> 12)) & (c)->hashmask)
+
+/*
+ * Deinterleaved (logical sector order) container image.
+ */
+struct sectorImage {
+  const uint16_t        *map;           /* Logical => physical sector map */
+  unsigned int          nsect;          /* # of sectors in the image */
+  unsigned int          sectsz;         /* Sector size (in bytes) */
+  uint8_t               *dirty;         /* Modified sector bitmap */
+  uint8_t               data[];         /* Sector data (logical order) */
+};
+
 struct FSdef *fileSystems = NULL;
 
 /*
@@ -398,6 +531,12 @@ uint8_t zeroes[256] = {
 
 void FSioCommands(FILE *);
 static void FSioExecute(char *);
+static int FSioBatch(char *, int);
+static void displayStats(void);
+static void cacheCreate(struct mountedFS *, unsigned int);
+static int cacheDestroy(struct mountedFS *);
+static int cacheSync(struct mountedFS *, off_t, size_t, int);
+static int imageDestroy(struct mountedFS *);
 
 extern struct mountedFS localMount;
 
@@ -485,7 +624,8 @@ static void FSioInit(void)
  --*/
 void Usage(void)
 {
-  fprintf(stderr, "Usage: fsio [cmdFile]\n");
+  fprintf(stderr, "Usage: fsio [-qsv] [cmdFile]\n");
+  fprintf(stderr, "       fsio [-qsv] [-j jobs] -b manifest\n");
   exit(1);
 }
 
@@ -514,6 +654,8 @@ int main(
 )
 {
   FILE *commands = stdin;
+  char *manifest = NULL, *end;
+  long workers = 0;
   int ch;
 
   FSioInit();
@@ -521,12 +663,28 @@ int main(
   /*
    * Process command line switches
    */
-  while ((ch = getopt(argc, argv, "qv")) != -1) {
+  while ((ch = getopt(argc, argv, "b:j:qsv")) != -1) {
     switch (ch) {
+      case 'b':
+        manifest = optarg;
+        break;
+
+      case 'j':
+        workers = strtol(optarg, &end, 10);
+        if ((*end != '\0') || (workers <= 0) || (workers > 1024)) {
+          fprintf(stderr, "Invalid job count \"%s\"\n", optarg);
+          exit(1);
+        }
+        break;
+
       case 'q':
         quiet = 1;
         break;
 
+      case 's':
+        showStats = 1;
+        break;
+
       case 'v':
         verbose = 1;
         break;
@@ -541,8 +699,21 @@ int main(
 
 #if !defined(__linux__)
   optreset = 1;
-#endif
   optind = 1;
+#else
+  optind = 0;
+#endif
+
+  if (manifest != NULL) {
+    if (argc != 0)
+      Usage();
+
+    if (workers == 0)
+      if ((workers = sysconf(_SC_NPROCESSORS_ONLN)) <= 0)
+        workers = 1;
+
+    return FSioBatch(manifest, workers) == 0 ? 0 : 1;
+  }
 
   if (argc <= 1) {
     if (argc == 1) {
@@ -554,11 +725,423 @@ int main(
       }
     }
     FSioCommands(commands);
+
+    /*
+     * End of input is equivalent to an "exit" command so that cached data
+     * is written back to the container files.
+     */
+    doExit();
   } else Usage();
 
   return 0;
 }
 
+/*++
+ *      b a t c h L o a d
+ *
+ *  Read a batch manifest. Each non-blank line, other than comment lines
+ *  starting with '#', contains a container file name followed by the name
+ *  of the command script to be run against it.
+ *
+ * Inputs:
+ *
+ *      manifest        - name of the manifest file
+ *      njobs           - pointer to return the number of jobs
+ *
+ * Outputs:
+ *
+ *      The number of jobs is returned through njobs
+ *
+ * Returns:
+ *
+ *      Pointer to the array of jobs, NULL if an error was detected
+ *
+ --*/
+static struct batchJob *batchLoad(
+  char *manifest,
+  int *njobs
+)
+{
+  FILE *file;
+  struct batchJob *jobs = NULL;
+  char buf[MAX_CMDLEN], *image, *script;
+  int line = 0, count = 0, size = 0;
+
+  if ((file = fopen(manifest, "r")) == NULL) {
+    fprintf(stderr, "Failed to open \"%s\": %s\n", manifest, strerror(errno));
+    return NULL;
+  }
+
+  while (fgets(buf, sizeof(buf), file) != NULL) {
+    line++;
+
+    if ((image = strtok(buf, " \t\r\n")) == NULL)
+      continue;
+    if (*image == '#')
+      continue;
+
+    if (((script = strtok(NULL, " \t\r\n")) == NULL) ||
+        (strtok(NULL, " \t\r\n") != NULL)) {
+      fprintf(stderr, "%s:%d: expected \"image script\"\n", manifest, line);
+      goto error;
+    }
+
+    if (count == size) {
+      struct batchJob *more;
+
+      size = size == 0 ? 64 : size * 2;
+      if ((more = realloc(jobs, size * sizeof(struct batchJob))) == NULL) {
+        fprintf(stderr, "Memory allocation failure\n");
+        goto error;
+      }
+      jobs = more;
+    }
+
+    memset(&jobs[count], 0, sizeof(struct batchJob));
+    if (((jobs[count].image = strdup(image)) == NULL) ||
+        ((jobs[count].script = strdup(script)) == NULL)) {
+      fprintf(stderr, "Memory allocation failure\n");
+      count++;
+      goto error;
+    }
+    count++;
+  }
+  fclose(file);
+
+  if (count == 0) {
+    fprintf(stderr, "%s: no jobs\n", manifest);
+    free(jobs);
+    return NULL;
+  }
+
+  *njobs = count;
+  return jobs;
+
+ error:
+  while (count--) {
+    free(jobs[count].image);
+    free(jobs[count].script);
+  }
+  free(jobs);
+  fclose(file);
+  return NULL;
+}
+
+/*++
+ *      b a t c h S t a r t
+ *
+ *  Start a worker process to run a batch job. The worker's stdout and
+ *  stderr are redirected to temporary files which are reported when the
+ *  job completes. The worker closes the temporary files of the jobs
+ *  started before it so that it holds no descriptors but its own.
+ *
+ * Inputs:
+ *
+ *      jobs            - pointer to the array of jobs
+ *      num             - index of the job to start
+ *
+ * Outputs:
+ *
+ *      job->pid is set if the worker was started, otherwise the job is
+ *      marked as complete with a failure status
+ *
+ * Returns:
+ *
+ *      1 if a worker process was started, 0 otherwise
+ *
+ --*/
+static int batchStart(
+  struct batchJob *jobs,
+  int num
+)
+{
+  struct batchJob *job = &jobs[num];
+  FILE *commands;
+  int i;
+
+  if (((job->out = tmpfile()) == NULL) || ((job->err = tmpfile()) == NULL)) {
+    fprintf(stderr, "Failed to create temporary file: %s\n", strerror(errno));
+    goto error;
+  }
+
+  /*
+   * Make sure the worker does not inherit any buffered output.
+   */
+  fflush(NULL);
+
+  switch (job->pid = fork()) {
+    case -1:
+      fprintf(stderr, "Failed to start job: %s\n", strerror(errno));
+      goto error;
+
+    case 0:
+      if ((dup2(fileno(job->out), STDOUT_FILENO) == -1) ||
+          (dup2(fileno(job->err), STDERR_FILENO) == -1))
+        _exit(2);
+
+      for (i = 0; i <= num; i++) {
+        if (jobs[i].out != NULL)
+          fclose(jobs[i].out);
+        if (jobs[i].err != NULL)
+          fclose(jobs[i].err);
+      }
+
+      if ((commands = fopen(job->script, "r")) == NULL) {
+        fprintf(stderr, "Failed to open \"%s\": %s\n",
+                job->script, strerror(errno));
+        exit(2);
+      }
+      batchImage = job->image;
+      FSioCommands(commands);
+      doExit();
+      /* NOTREACHED */
+  }
+  return 1;
+
+ error:
+  job->status = 2 << 8;
+  job->done = 1;
+  return 0;
+}
+
+/*++
+ *      b a t c h C o p y
+ *
+ *  Copy the collected output from a completed job to a stdio stream.
+ *
+ * Inputs:
+ *
+ *      from            - temporary file holding the output
+ *      to              - stdio stream to copy to
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      Number of bytes copied
+ *
+ --*/
+static size_t batchCopy(
+  FILE *from,
+  FILE *to
+)
+{
+  char buf[8192];
+  size_t len, total = 0;
+
+  if (from == NULL)
+    return 0;
+
+  rewind(from);
+  while ((len = fread(buf, 1, sizeof(buf), from)) != 0) {
+    fwrite(buf, 1, len, to);
+    total += len;
+  }
+  fclose(from);
+  return total;
+}
+
+/*++
+ *      b a t c h R e p o r t
+ *
+ *  Report the output and completion status of a batch job. A job is
+ *  considered to have failed if the worker exited abnormally or with a
+ *  non-zero status, or if any error messages were written to stderr.
+ *
+ * Inputs:
+ *
+ *      job             - pointer to the completed job
+ *      num             - job number (1 based)
+ *      njobs           - total number of jobs
+ *
+ * Outputs:
+ *
+ *      job->status is updated to be non-zero if the job failed
+ *
+ * Returns:
+ *
+ *      None
+ *
+ --*/
+static void batchReport(
+  struct batchJob *job,
+  int num,
+  int njobs
+)
+{
+  size_t errors;
+
+  printf("=== [%d/%d] %s (%s)\n", num, njobs, job->image, job->script);
+  batchCopy(job->out, stdout);
+  errors = batchCopy(job->err, stdout);
+  job->out = job->err = NULL;
+
+  if (WIFSIGNALED(job->status))
+    printf("=== [%d/%d] FAILED: killed by signal %d\n",
+           num, njobs, WTERMSIG(job->status));
+  else if (WEXITSTATUS(job->status) != 0)
+    printf("=== [%d/%d] FAILED: exit status %d\n",
+           num, njobs, WEXITSTATUS(job->status));
+  else if (errors != 0) {
+    printf("=== [%d/%d] FAILED: errors reported\n", num, njobs);
+    job->status = 1 << 8;
+  }
+  fflush(stdout);
+}
+
+/*++
+ *      F S i o B a t c h
+ *
+ *  Run the jobs described by a batch manifest on a pool of worker
+ *  processes. The output from each job is reported in manifest order,
+ *  followed by a summary of failed jobs.
+ *
+ * Inputs:
+ *
+ *      manifest        - name of the manifest file
+ *      workers         - maximum number of concurrent jobs
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      Number of failed jobs (-1 if the manifest could not be loaded)
+ *
+ --*/
+static int FSioBatch(
+  char *manifest,
+  int workers
+)
+{
+  struct batchJob *jobs;
+  int i, njobs, next = 0, reported = 0, running = 0, failed = 0;
+
+  if ((jobs = batchLoad(manifest, &njobs)) == NULL)
+    return -1;
+
+  while (reported < njobs) {
+    while ((running < workers) && (next < njobs))
+      running += batchStart(jobs, next++);
+
+    if (running != 0) {
+      pid_t pid;
+      int status;
+
+      if ((pid = wait(&status)) == -1) {
+        if (errno == EINTR)
+          continue;
+        fprintf(stderr, "wait() failed: %s\n", strerror(errno));
+        exit(2);
+      }
+
+      for (i = 0; i < next; i++)
+        if (!jobs[i].done && (jobs[i].pid == pid)) {
+          jobs[i].status = status;
+          jobs[i].done = 1;
+          running--;
+          break;
+        }
+    }
+
+    while ((reported < njobs) && jobs[reported].done) {
+      batchReport(&jobs[reported], reported + 1, njobs);
+      reported++;
+    }
+  }
+
+  for (i = 0; i < njobs; i++)
+    if (jobs[i].status != 0)
+      failed++;
+
+  printf("=== %d job%s, %d failed\n", njobs, njobs == 1 ? "" : "s", failed);
+  for (i = 0; i < njobs; i++)
+    if (jobs[i].status != 0)
+      printf("    %s (%s)\n", jobs[i].image, jobs[i].script);
+
+  for (i = 0; i < njobs; i++) {
+    free(jobs[i].image);
+    free(jobs[i].script);
+  }
+  free(jobs);
+  return failed;
+}
+
+/*++
+ *      b a t c h E x p a n d
+ *
+ *  Expand a command line for the current batch job. "%I" is replaced by
+ *  the container file name and "%B" by its base name (without directory
+ *  or extension). "%%" is replaced by a single '%'.
+ *
+ * Inputs:
+ *
+ *      in              - pointer to the command line
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      Pointer to the expanded command line, NULL if too long
+ *
+ --*/
+static char *batchExpand(
+  char *in
+)
+{
+  static char buf[MAX_CMDLEN];
+  char *base, *ext, *out = buf;
+  size_t baselen;
+
+  if ((base = strrchr(batchImage, '/')) != NULL)
+    base++;
+  else base = batchImage;
+  if ((ext = strrchr(base, '.')) != NULL)
+    baselen = ext - base;
+  else baselen = strlen(base);
+
+  while (*in != '\0') {
+    char *sub = NULL;
+    size_t len = 1;
+
+    if (*in == '%') {
+      switch (in[1]) {
+        case 'I':
+          sub = batchImage;
+          len = strlen(batchImage);
+          in++;
+          break;
+
+        case 'B':
+          sub = base;
+          len = baselen;
+          in++;
+          break;
+
+        case '%':
+          in++;
+          break;
+      }
+    }
+    if ((out + len) >= &buf[sizeof(buf)]) {
+      fprintf(stderr, "Command line too long after expansion\n");
+      return NULL;
+    }
+    if (sub != NULL) {
+      memcpy(out, sub, len);
+      out += len;
+    } else *out++ = *in;
+    in++;
+  }
+  *out = '\0';
+  return buf;
+}
+
 /*++
  *      c h e c k D e v
  *
@@ -770,46 +1353,241 @@ static struct FSdef *lookupFS(
 }
 
 /*++
- *      d o M o u n t
+ *      m a p C o n t a i n e r
  *
- *  Mount command processing routine.
+ *  Attempt to map the container file into memory so that block I/O may be
+ *  performed by copying directly to/from the mapped region. Failure is not
+ *  an error, I/O will continue to be performed using stdio.
  *
  * Inputs:
  *
- *      None
+ *      mount           - pointer to a mounted file system descriptor
  *
  * Outputs:
  *
- *      None
+ *      The mount descriptor will be updated if the mapping succeeds
  *
  * Returns:
  *
- *      None
+ *      1 if the container was mapped, 0 otherwise
  *
  --*/
-static void doMount(void)
+static int mapContainer(
+  struct mountedFS *mount
+)
 {
-  struct FSdef *filesys;
-  FILE *container;
-  int status;
-  char *mode = SWISSET('r') ? "r" : "r+";
+  struct stat stat;
+  int prot = PROT_READ;
+  void *map;
 
-  if (checkDev(words[0]) != 0) { 
-    if (lookupDev(words[0]) == NULL) {
-      if ((filesys = lookupFS(words[2])) != NULL) {
-        if (filesys->mount == NULL) {
-          fprintf(stderr,
-                  "mount: \"%s\" is not a mountable filesystem\n", words[2]);
-          return;
-        }
+  /*
+   * Magtape file systems perform their own (record-based) I/O.
+   */
+  if ((mount->filesys->flags & FS_TAPE) != 0)
+    return 0;
 
-        if ((container = fopen(words[1], mode)) != NULL) {
-          struct mountedFS *mount;
+  if (fstat(fileno(mount->container), &stat) != 0)
+    return 0;
 
-          if ((mount = malloc(sizeof(struct mountedFS))) != NULL) {
-            memset(mount, 0, sizeof(struct mountedFS));
+  if (!S_ISREG(stat.st_mode) || (stat.st_size == 0) ||
+      ((uintmax_t)stat.st_size > SIZE_MAX))
+    return 0;
 
-            strcpy(mount->name, words[0]);
+  if ((mount->flags & FS_READONLY) == 0)
+    prot |= PROT_WRITE;
+
+  map = mmap(NULL, stat.st_size, prot, MAP_SHARED,
+             fileno(mount->container), 0);
+  if (map == MAP_FAILED)
+    return 0;
+
+  mount->map = map;
+  mount->mapsz = stat.st_size;
+  mount->flags |= FS_MAPPED;
+  return 1;
+}
+
+/*++
+ *      g r o w C o n t a i n e r
+ *
+ *  Extend a memory-mapped container file (some newfs implementations create
+ *  a container smaller than the full device) and map it again. If the new
+ *  mapping fails, the container reverts to stdio access.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      size            - new minimum size of the container file
+ *
+ * Outputs:
+ *
+ *      The mount descriptor will be updated with the new mapping
+ *
+ * Returns:
+ *
+ *      None
+ *
+ --*/
+static void growContainer(
+  struct mountedFS *mount,
+  off_t size
+)
+{
+  void *map = MAP_FAILED;
+
+  if (msync(mount->map, mount->mapsz, MS_SYNC) == 0) {
+    munmap(mount->map, mount->mapsz);
+
+    if (ftruncate(fileno(mount->container), size) == 0)
+      map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 fileno(mount->container), 0);
+  } else munmap(mount->map, mount->mapsz);
+
+  if (map != MAP_FAILED) {
+    mount->map = map;
+    mount->mapsz = size;
+  } else {
+    mount->map = NULL;
+    mount->mapsz = 0;
+    mount->flags &= ~FS_MAPPED;
+  }
+}
+
+/*++
+ *      u n m a p C o n t a i n e r
+ *
+ *  Remove the memory mapping for a container file, if present. If the file
+ *  system was mounted read-write, any modified pages are written back to the
+ *  container file first.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      1 if modified pages were written back (or there were none), 0
+ *      otherwise
+ *
+ --*/
+static int unmapContainer(
+  struct mountedFS *mount
+)
+{
+  int status = 1;
+
+  if ((mount->flags & FS_MAPPED) != 0) {
+    if ((mount->flags & FS_READONLY) == 0)
+      if (msync(mount->map, mount->mapsz, MS_SYNC) != 0) {
+        fprintf(stderr, "%s: failed to write back \"%s\" - %s\n",
+                wds[0], mount->name, strerror(errno));
+        status = 0;
+      }
+
+    munmap(mount->map, mount->mapsz);
+    mount->map = NULL;
+    mount->mapsz = 0;
+    mount->flags &= ~FS_MAPPED;
+  }
+  return status;
+}
+
+/*++
+ *      c l o s e C o n t a i n e r
+ *
+ *  Write back everything held in memory for a mounted file system (the
+ *  deinterleaved image, the block cache and the mapping) and close the
+ *  container file.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      1 if all modified data reached the container file, 0 otherwise
+ *
+ --*/
+static int closeContainer(
+  struct mountedFS *mount
+)
+{
+  int status = 1;
+
+  if (imageDestroy(mount) == 0)
+    status = 0;
+  if (cacheDestroy(mount) == 0)
+    status = 0;
+  if (unmapContainer(mount) == 0)
+    status = 0;
+  if (fclose(mount->container) != 0) {
+    fprintf(stderr, "%s: failed to close \"%s\" - %s\n",
+            wds[0], mount->name, strerror(errno));
+    status = 0;
+  }
+  return status;
+}
+
+/*++
+ *      d o M o u n t
+ *
+ *  Mount command processing routine.
+ *
+ * Inputs:
+ *
+ *      None
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      None
+ *
+ --*/
+static void doMount(void)
+{
+  struct FSdef *filesys;
+  FILE *container;
+  int status;
+  char *mode = SWISSET('r') ? "r" : "r+";
+  unsigned long cachesz = CACHE_DEFAULT;
+
+  if (SWISSET('c')) {
+    char *endptr;
+
+    cachesz = strtoul(SWGETVAL('c'), &endptr, 10);
+    if ((*endptr != '\0') || (cachesz > CACHE_MAX)) {
+      fprintf(stderr, "mount: Invalid '-c' argument\n");
+      return;
+    }
+  }
+
+  if (checkDev(words[0]) != 0) { 
+    if (lookupDev(words[0]) == NULL) {
+      if ((filesys = lookupFS(words[2])) != NULL) {
+        if (filesys->mount == NULL) {
+          fprintf(stderr,
+                  "mount: \"%s\" is not a mountable filesystem\n", words[2]);
+          return;
+        }
+
+        if ((container = fopen(words[1], mode)) != NULL) {
+          struct mountedFS *mount;
+
+          if ((mount = malloc(sizeof(struct mountedFS))) != NULL) {
+            memset(mount, 0, sizeof(struct mountedFS));
+
+            strcpy(mount->name, words[0]);
             mount->filesys = filesys;
             mount->blocksz = filesys->blocksz;
             mount->flags = SWISSET('r') ? FS_READONLY : 0;
@@ -831,14 +1609,31 @@ static void doMount(void)
             mount->container = container;
             mount->skip = 0;
 
+            /*
+             * Read-only mounts are memory-mapped by default, read-write
+             * mounts only if requested.
+             */
+            if (SWISSET('m') || (SWISSET('r') && !SWISSET('s')))
+              mapContainer(mount);
+
             /*
              * Verify that the container holds a valid file system
              */
             if ((status = (*filesys->mount)(mount)) > 0) {
+              /*
+               * A memory-mapped container gains nothing from caching
+               * unless explicitly requested.
+               */
+              if (((filesys->flags & FS_TAPE) == 0) &&
+                  (((mount->flags & FS_MAPPED) == 0) || SWISSET('c')))
+                cacheCreate(mount, cachesz);
+
               mount->next = mounts;
               mounts = mount;
               return;
             }
+            imageDestroy(mount);
+            unmapContainer(mount);
             free(mount);
             if (status == 0)
               fprintf(stderr,
@@ -885,7 +1680,8 @@ static void doUmount(void)
         if (*ptr == mount) {
           *ptr = mount->next;
           (*mount->filesys->umount)(mount);
-          fclose(mount->container);
+          if (closeContainer(mount) == 0)
+            writeFailed = 1;
           free(mount);
           return;
         }
@@ -1181,6 +1977,176 @@ static void doDump(void)
   }
 }
 
+#define BFRSIZ          512
+#define COPYBFRSIZ      (64 * 1024)
+
+/*
+ * Buffer for binary-mode copies. ASCII-mode copies are line at a time and
+ * use a BFRSIZ buffer on the stack.
+ */
+static char copyBuf[COPYBFRSIZ];
+
+/*++
+ *      w r i t e A l l
+ *
+ *  Write a buffer to a host file descriptor, retrying short writes.
+ *
+ * Inputs:
+ *
+ *      fd              - file descriptor to write to
+ *      buf             - pointer to the data
+ *      size            - size of the data (in bytes)
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      1 if write was successful, 0 otherwise
+ *
+ --*/
+static int writeAll(
+  int fd,
+  const void *buf,
+  size_t size
+)
+{
+  const char *ptr = buf;
+
+  while (size != 0) {
+    ssize_t len = write(fd, ptr, size);
+
+    if (len <= 0) {
+      if ((len < 0) && (errno == EINTR))
+        continue;
+      return 0;
+    }
+    ptr += len;
+    size -= len;
+  }
+  return 1;
+}
+
+/*++
+ *      c o p y E x t e n t
+ *
+ *  Copy a file which the source file system reports as a single extent of
+ *  its container (binary mode only). A local destination is written
+ *  directly from the mapped container, or by copy_file_range() when the
+ *  container is accessed via stdio. Other destinations are passed large
+ *  block-aligned chunks through their writeFile() routine.
+ *
+ * Inputs:
+ *
+ *      mountSrc        - pointer to the source mounted file system
+ *      block           - starting block # of the extent
+ *      size            - size of the file (in bytes)
+ *      mountDest       - pointer to the destination mounted file system
+ *      fileDest        - pointer to the open destination file
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      1 if copy was successful, 0 otherwise
+ *
+ --*/
+static int copyExtent(
+  struct mountedFS *mountSrc,
+  off_t block,
+  off_t size,
+  struct mountedFS *mountDest,
+  void *fileDest
+)
+{
+  off_t offset = mountSrc->skip + block * mountSrc->blocksz;
+  int mapped = ((mountSrc->flags & FS_MAPPED) != 0) &&
+    ((size_t)(offset + size) <= mountSrc->mapsz);
+
+  /*
+   * Make sure any modified blocks within the extent have reached the
+   * container file.
+   */
+  if (cacheSync(mountSrc, offset - mountSrc->skip, size, 0) == 0)
+    return 0;
+  if ((mountSrc->flags & FS_MAPPED) == 0)
+    fflush(mountSrc->container);
+
+  if (mountDest == &localMount) {
+    int fd = fileno((FILE *)fileDest);
+
+    fflush(fileDest);
+
+    if (mapped) {
+      ioStats.reads++;
+      ioStats.rbytes += size;
+      return writeAll(fd, mountSrc->map + offset, size);
+    }
+
+#if defined(__linux__)
+    if ((mountSrc->flags & FS_MAPPED) == 0) {
+      int src = fileno(mountSrc->container);
+
+      while (size != 0) {
+        ssize_t len = copy_file_range(src, &offset, fd, NULL, size, 0);
+
+        if (len <= 0) {
+          if ((len < 0) && (errno == EINTR))
+            continue;
+          /*
+           * Fall back to read/write if the kernel or the file systems
+           * involved do not support copy_file_range().
+           */
+          if ((len < 0) &&
+              ((errno == ENOSYS) || (errno == EXDEV) || (errno == EINVAL)))
+            break;
+          return 0;
+        }
+        ioStats.reads++;
+        ioStats.rbytes += len;
+        size -= len;
+      }
+    }
+#endif
+
+    while (size != 0) {
+      size_t len = size > COPYBFRSIZ ? COPYBFRSIZ : size;
+
+      if ((FSioReadBlob(mountSrc, offset, len, copyBuf) == 0) ||
+          (writeAll(fd, copyBuf, len) == 0))
+        return 0;
+
+      offset += len;
+      size -= len;
+    }
+    return 1;
+  }
+
+  while (size != 0) {
+    size_t len = size > COPYBFRSIZ ? COPYBFRSIZ : size;
+    void *buf = copyBuf;
+
+    /*
+     * The source mapping is stable unless the destination is on the same
+     * container (which may grow and be remapped during the copy).
+     */
+    if (mapped && (mountSrc != mountDest))
+      buf = mountSrc->map + offset;
+    else if (FSioReadBlob(mountSrc, offset, len, copyBuf) == 0)
+      return 0;
+
+    if ((*mountDest->filesys->writeFile)(fileDest, buf, len) != len)
+      return 0;
+
+    offset += len;
+    size -= len;
+  }
+  return 1;
+}
+
 /*++
  *      d o C o p y
  *
@@ -1199,8 +2165,6 @@ static void doDump(void)
  *      None
  *
  --*/
-#define BFRSIZ          512
-
 static void doCopy(void)
 {
   struct mountedFS *mountSrc, *mountDest;
@@ -1249,13 +2213,33 @@ static void doCopy(void)
       }
 
       if ((fileDest = (*fsDest->openFileW)(mountDest, unitDest, fnameDest, size)) != NULL) {
-        char buf[BFRSIZ];
-        size_t len;
-
-        while ((len = (*fsSrc->readFile)(fileSrc, buf, BFRSIZ)) != 0) {
-          if ((*fsDest->writeFile)(fileDest, buf, len) == 0) {
+        off_t block, extent;
+
+        if (!SWISSET('a') && (fsSrc->fileExtent != NULL) &&
+            (*fsSrc->fileExtent)(fileSrc, &block, &extent)) {
+          /*
+           * Contiguous source file, transfer it directly from the container
+           */
+          if (copyExtent(mountSrc, block, extent, mountDest, fileDest) == 0)
             fprintf(stderr, "copy: Error writing \"%s\"\n", fnameDest);
-            break;
+        } else if (!SWISSET('a')) {
+          size_t len;
+
+          while ((len = (*fsSrc->readFile)(fileSrc, copyBuf, COPYBFRSIZ)) != 0) {
+            if ((*fsDest->writeFile)(fileDest, copyBuf, len) != len) {
+              fprintf(stderr, "copy: Error writing \"%s\"\n", fnameDest);
+              break;
+            }
+          }
+        } else {
+          char buf[BFRSIZ];
+          size_t len;
+
+          while ((len = (*fsSrc->readFile)(fileSrc, buf, BFRSIZ)) != 0) {
+            if ((*fsDest->writeFile)(fileDest, buf, len) == 0) {
+              fprintf(stderr, "copy: Error writing \"%s\"\n", fnameDest);
+              break;
+            }
           }
         }
         (*fsDest->closeFile)(fileDest);
@@ -1378,8 +2362,16 @@ static void doStatus(void)
   if (mounts != NULL) {
     struct mountedFS *mount;
 
-    for (mount = mounts; mount != NULL; mount = mount->next)
-      printf("%-20s%s\n", mount->name, mount->filesys->fstype);
+    for (mount = mounts; mount != NULL; mount = mount->next) {
+      struct blockCache *cache = mount->cache;
+
+      printf("%-20s%s%s\n", mount->name, mount->filesys->fstype,
+             (mount->flags & FS_MAPPED) != 0 ? " (mapped)" : "");
+      if (cache != NULL)
+        printf("%-20scache: %u/%u blocks, %lu hits, %lu misses, "
+               "%lu write-backs\n", "", cache->count, cache->capacity,
+               cache->hits, cache->misses, cache->writebacks);
+    }
   }
 }
 
@@ -1467,10 +2459,13 @@ static void doHelp(void)
     "A common command format is used:\n\n"
     "  verb [switches] arg1 arg2 ...\n\n"
     "The following commands are supported:\n\n"
-    "  mount [-r] [-t type] dev[:] container fstype\n\n"
+    "  mount [-mrs] [-c blocks] [-t type] dev[:] container fstype\n\n"
     "The file system container file is made available to fsio (via the dev\n"
     "specifier). fstype specifies the type of the container file system.\n"
     "If -r is specified, the file system will be read-only.\n"
+    "Read-only container files are memory-mapped by default, -m requests\n"
+    "mapping for a read-write mount and -s forces the use of stdio.\n"
+    "\"-c blocks\" sets the size of the block cache (0 disables caching).\n"
     "In some cases (e.g. OS/8) fsio is unable to determine the type of the\n"
     "underlying disk so it must be specified using \"-t type\"\n\n"
     "  umount dev[:]\n\n"
@@ -1514,7 +2509,8 @@ static void doHelp(void)
     "  delete dev:file\n\n"
     "Delete the specified file from the container file system.\n\n"
     "  status\n\n"
-    "Display a list of the currently mounted file systems.\n\n"
+    "Display a list of the currently mounted file systems and block cache\n"
+    "statistics.\n\n"
     "  do [-q] cmdFile\n\n"
     "Echo and execute commands from a file. If -q is present suppress the echo.\n\n"
     "  help\n\n"
@@ -1563,14 +2559,74 @@ static void doExit(void)
 
   for (mount = mounts; mount != NULL; mount = mount->next)
     if (mount != &localMount)
-      fclose(mount->container);
+      if (closeContainer(mount) == 0)
+        writeFailed = 1;
 
 #ifdef DEBUG
   if ((DEBUGout != NULL) && (DEBUGout != stdout))
     fclose(DEBUGout);
 #endif
 
-  exit(0);
+  if (showStats)
+    displayStats();
+
+  exit(writeFailed ? 1 : 0);
+}
+
+/*++
+ *      d i s p l a y S t a t s
+ *
+ *  Display container I/O statistics and resource usage for this run of
+ *  fsio. On Linux, the number of read/write class system calls issued is
+ *  taken from /proc/self/io.
+ *
+ * Inputs:
+ *
+ *      None
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      None
+ *
+ --*/
+static void displayStats(void)
+{
+  struct rusage usage;
+
+  printf("I/O statistics:\n");
+  printf("  Container reads:  %lu (%llu bytes)\n",
+         ioStats.reads, ioStats.rbytes);
+  printf("  Container writes: %lu (%llu bytes)\n",
+         ioStats.writes, ioStats.wbytes);
+
+#if defined(__linux__)
+  {
+    FILE *io;
+    char buf[64];
+    unsigned long long syscr = 0, syscw = 0, value;
+
+    if ((io = fopen("/proc/self/io", "r")) != NULL) {
+      while (fgets(buf, sizeof(buf), io) != NULL) {
+        if (sscanf(buf, "syscr: %llu", &value) == 1)
+          syscr = value;
+        if (sscanf(buf, "syscw: %llu", &value) == 1)
+          syscw = value;
+      }
+      fclose(io);
+      printf("  System calls:     %llu read, %llu write\n", syscr, syscw);
+    }
+  }
+#endif
+
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    printf("  CPU time:         %ld.%03lds user, %ld.%03lds system\n",
+           (long)usage.ru_utime.tv_sec, (long)usage.ru_utime.tv_usec / 1000,
+           (long)usage.ru_stime.tv_sec, (long)usage.ru_stime.tv_usec / 1000);
+  fflush(stdout);
 }
 
 /*++
@@ -1761,6 +2817,10 @@ static void FSioExecute(
 {
   char quote;
 
+  if (batchImage != NULL)
+    if ((in = batchExpand(in)) == NULL)
+      return;
+
   words = wds;
   args = 0;
 
@@ -1839,8 +2899,10 @@ static void FSioExecute(
           if ((ch == '?') || ((ptr = strchr(switches, ch)) == NULL)) {
 #if !defined(__linux__)
             optreset = 1;
-#endif
             optind = 1;
+#else
+            optind = 0;
+#endif
             return;
           }
           SWSET(ch);
@@ -1856,8 +2918,10 @@ static void FSioExecute(
          */
 #if !defined(__linux__)
         optreset = 1;
-#endif
         optind = 1;
+#else
+        optind = 0;
+#endif
       } else args--, words++;
 
       if ((args < cmdTable[idx].minargs) || (args > cmdTable[idx].maxargs)) {
@@ -1967,11 +3031,10 @@ void FSioCommands(
 }
 
 /*++
- *      F S i o R e a d B l o b
+ *      c o n t a i n e r R e a d
  *
- *  Read an arbitrary sized blob of binary data from the container file. The
- *  caller is responsible for making sure that the buffer has sufficient
- *  space for the blob.
+ *  Read data from an arbitrary offset in the container file, using the
+ *  memory-mapped image if present.
  *
  * Inputs:
  *
@@ -1982,31 +3045,43 @@ void FSioCommands(
  *
  * Outputs:
  *
- *      The buffer will be overwrittn by the contents of the blob from the
- *      container file system
+ *      The buffer will be overwritten by data from the container file
  *
  * Returns:
  *
  *      1 if read was successful, 0 otherwise
  *
  --*/
-int FSioReadBlob(
+static int containerRead(
   struct mountedFS *mount,
   off_t offset,
-  unsigned int size,
+  size_t size,
   void *buf
 )
 {
+  ioStats.reads++;
+  ioStats.rbytes += size;
+
+  if ((mount->flags & FS_MAPPED) != 0) {
+    if ((offset < 0) || ((size_t)offset > mount->mapsz) ||
+        (size > (mount->mapsz - offset)))
+      return 0;
+
+    memcpy(buf, mount->map + offset, size);
+    return 1;
+  }
+
   if (fseeko(mount->container, offset, SEEK_SET) == 0)
     return fread(buf, size, 1, mount->container);
 
   return 0;
 }
-
+
 /*++
- *      F S i o W r i t e B l o b
+ *      c o n t a i n e r W r i t e
  *
- *  Write an arbitrary sized blob of binary to from the container file.
+ *  Write data to an arbitrary offset in the container file, using the
+ *  memory-mapped image if present.
  *
  * Inputs:
  *
@@ -2024,18 +3099,461 @@ int FSioReadBlob(
  *      1 if write was successful, 0 otherwise
  *
  --*/
-int FSioWriteBlob(
+static int containerWrite(
   struct mountedFS *mount,
   off_t offset,
-  unsigned int size,
+  size_t size,
   void *buf
 )
 {
+  ioStats.writes++;
+  ioStats.wbytes += size;
+
+  if ((mount->flags & FS_MAPPED) != 0) {
+    if (offset < 0)
+      return 0;
+
+    if (((size_t)offset > mount->mapsz) || (size > (mount->mapsz - offset)))
+      growContainer(mount, offset + size);
+
+    if ((mount->flags & FS_MAPPED) != 0) {
+      memcpy(mount->map + offset, buf, size);
+      return 1;
+    }
+  }
+
   if (fseeko(mount->container, offset, SEEK_SET) == 0)
     return fwrite(buf, size, 1, mount->container);
 
   return 0;
 }
+
+/*++
+ *      c a c h e C r e a t e
+ *
+ *  Create an empty block cache for a mounted file system. Failure to
+ *  allocate the cache is not an error, block I/O will be uncached.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      capacity        - maximum # of blocks to cache (0 disables the cache)
+ *
+ * Outputs:
+ *
+ *      The mount descriptor will point to the new cache
+ *
+ * Returns:
+ *
+ *      None
+ *
+ --*/
+static void cacheCreate(
+  struct mountedFS *mount,
+  unsigned int capacity
+)
+{
+  struct blockCache *cache;
+  unsigned int hashsz = 16;
+
+  if ((capacity == 0) || (mount->blocksz == 0))
+    return;
+
+  while (hashsz < capacity)
+    hashsz <<= 1;
+
+  if ((cache = malloc(sizeof(struct blockCache))) != NULL) {
+    memset(cache, 0, sizeof(struct blockCache));
+
+    if ((cache->hash = calloc(hashsz, sizeof(struct cacheBlock *))) != NULL) {
+      cache->hashmask = hashsz - 1;
+      cache->capacity = capacity;
+      mount->cache = cache;
+      return;
+    }
+    free(cache);
+  }
+}
+
+/*++
+ *      c a c h e L o o k u p
+ *
+ *  Locate a block in the cache, making it the most recently used block.
+ *
+ * Inputs:
+ *
+ *      cache           - pointer to the block cache
+ *      block           - logical block #
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      Pointer to the cached block, NULL if not present
+ *
+ --*/
+static struct cacheBlock *cacheLookup(
+  struct blockCache *cache,
+  unsigned int block
+)
+{
+  struct cacheBlock *cb;
+
+  for (cb = cache->hash[CACHEHASH(cache, block)]; cb != NULL; cb = cb->chain)
+    if (cb->block == block) {
+      if (cb != cache->head) {
+        /*
+         * Move to the front of the LRU list.
+         */
+        cb->prev->next = cb->next;
+        if (cb->next != NULL)
+          cb->next->prev = cb->prev;
+        else cache->tail = cb->prev;
+
+        cb->prev = NULL;
+        cb->next = cache->head;
+        cache->head->prev = cb;
+        cache->head = cb;
+      }
+      return cb;
+    }
+  return NULL;
+}
+
+/*++
+ *      c a c h e W r i t e B a c k
+ *
+ *  Write a dirty cached block back to the container file.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      cb              - pointer to the cached block
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      1 if write was successful (or not needed), 0 otherwise
+ *
+ --*/
+static int cacheWriteBack(
+  struct mountedFS *mount,
+  struct cacheBlock *cb
+)
+{
+  off_t offset = (off_t)cb->block * mount->blocksz;
+
+  if (cb->dirty) {
+    if (containerWrite(mount, offset + mount->skip,
+                       mount->blocksz, cb->data) == 0) {
+      ERROR("%s: failed to write back block %u\n", mount->name, cb->block);
+      return 0;
+    }
+    cb->dirty = 0;
+    mount->cache->writebacks++;
+  }
+  return 1;
+}
+
+/*++
+ *      c a c h e R e m o v e
+ *
+ *  Remove a block from the cache and release it's memory. Any modified
+ *  data is discarded.
+ *
+ * Inputs:
+ *
+ *      cache           - pointer to the block cache
+ *      cb              - pointer to the cached block
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      None
+ *
+ --*/
+static void cacheRemove(
+  struct blockCache *cache,
+  struct cacheBlock *cb
+)
+{
+  struct cacheBlock **ptr = &cache->hash[CACHEHASH(cache, cb->block)];
+
+  while (*ptr != cb)
+    ptr = &(*ptr)->chain;
+  *ptr = cb->chain;
+
+  if (cb->prev != NULL)
+    cb->prev->next = cb->next;
+  else cache->head = cb->next;
+  if (cb->next != NULL)
+    cb->next->prev = cb->prev;
+  else cache->tail = cb->prev;
+
+  cache->count--;
+  free(cb);
+}
+
+/*++
+ *      c a c h e A l l o c
+ *
+ *  Allocate a new cache entry for a block which is not currently cached,
+ *  evicting the least recently used block if the cache is full.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      block           - logical block #
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      Pointer to the new (clean, uninitialized) cached block, NULL if no
+ *      entry could be allocated
+ *
+ --*/
+static struct cacheBlock *cacheAlloc(
+  struct mountedFS *mount,
+  unsigned int block
+)
+{
+  struct blockCache *cache = mount->cache;
+  struct cacheBlock *cb;
+  unsigned int idx = CACHEHASH(cache, block);
+
+  if (cache->count >= cache->capacity) {
+    if (cacheWriteBack(mount, cache->tail) == 0)
+      return NULL;
+    cacheRemove(cache, cache->tail);
+  }
+
+  if ((cb = malloc(sizeof(struct cacheBlock) + mount->blocksz)) != NULL) {
+    cb->block = block;
+    cb->dirty = 0;
+
+    cb->chain = cache->hash[idx];
+    cache->hash[idx] = cb;
+
+    cb->prev = NULL;
+    cb->next = cache->head;
+    if (cache->head != NULL)
+      cache->head->prev = cb;
+    else cache->tail = cb;
+    cache->head = cb;
+
+    cache->count++;
+  }
+  return cb;
+}
+
+/*++
+ *      c a c h e F l u s h
+ *
+ *  Write all dirty blocks back to the container file.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      1 if all writes were successful, 0 otherwise
+ *
+ --*/
+static int cacheFlush(
+  struct mountedFS *mount
+)
+{
+  struct cacheBlock *cb;
+  int status = 1;
+
+  if (mount->cache != NULL)
+    for (cb = mount->cache->tail; cb != NULL; cb = cb->prev)
+      if (cacheWriteBack(mount, cb) == 0)
+        status = 0;
+
+  return status;
+}
+
+/*++
+ *      c a c h e D e s t r o y
+ *
+ *  Write back all dirty blocks and release the block cache for a mounted
+ *  file system.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      1 if all dirty blocks were written back, 0 otherwise
+ *
+ --*/
+static int cacheDestroy(
+  struct mountedFS *mount
+)
+{
+  struct blockCache *cache = mount->cache;
+  int status = 1;
+
+  if (cache != NULL) {
+    status = cacheFlush(mount);
+
+    while (cache->head != NULL)
+      cacheRemove(cache, cache->head);
+
+    free(cache->hash);
+    free(cache);
+    mount->cache = NULL;
+  }
+  return status;
+}
+
+/*++
+ *      c a c h e S y n c
+ *
+ *  Keep the block cache coherent with I/O which bypasses it (sector and
+ *  blob I/O). Any cached blocks overlapping the specified region of the
+ *  container are written back and, if the region is about to be written,
+ *  removed from the cache. A block which could not be written back stays
+ *  in the cache (still dirty) so its contents are not lost.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      offset          - offset of the region (relative to mount->skip)
+ *      size            - size of the region (in bytes)
+ *      invalidate      - if non-zero, remove overlapping blocks
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      1 if all overlapping dirty blocks were written back, 0 otherwise
+ *
+ --*/
+static int cacheSync(
+  struct mountedFS *mount,
+  off_t offset,
+  size_t size,
+  int invalidate
+)
+{
+  struct blockCache *cache = mount->cache;
+  off_t block, last;
+  int status = 1;
+
+  if ((cache == NULL) || (cache->count == 0) || (offset < 0) || (size == 0))
+    return 1;
+
+  last = (offset + size - 1) / mount->blocksz;
+
+  for (block = offset / mount->blocksz; block <= last; block++) {
+    struct cacheBlock *cb;
+
+    for (cb = cache->hash[CACHEHASH(cache, (unsigned int)block)];
+         cb != NULL; cb = cb->chain)
+      if (cb->block == block) {
+        if (cacheWriteBack(mount, cb) == 0)
+          status = 0;
+        else if (invalidate)
+          cacheRemove(cache, cb);
+        break;
+      }
+  }
+  return status;
+}
+
+/*++
+ *      F S i o R e a d B l o b
+ *
+ *  Read an arbitrary sized blob of binary data from the container file. The
+ *  caller is responsible for making sure that the buffer has sufficient
+ *  space for the blob.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      offset          - offset in the container file to start the read
+ *      size            - size of the data to read (in bytes)
+ *      buf             - pointer to the buffer to receive the data
+ *
+ * Outputs:
+ *
+ *      The buffer will be overwrittn by the contents of the blob from the
+ *      container file system
+ *
+ * Returns:
+ *
+ *      1 if read was successful, 0 otherwise
+ *
+ --*/
+int FSioReadBlob(
+  struct mountedFS *mount,
+  off_t offset,
+  unsigned int size,
+  void *buf
+)
+{
+  if (cacheSync(mount, offset - mount->skip, size, 0) == 0)
+    return 0;
+  return containerRead(mount, offset, size, buf);
+}
+
+/*++
+ *      F S i o W r i t e B l o b
+ *
+ *  Write an arbitrary sized blob of binary to from the container file.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      offset          - offset in the container file to start the write
+ *      size            - size of the data to write (in bytes)
+ *      buf             - pointer to the buffer with the data
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      1 if write was successful, 0 otherwise
+ *
+ --*/
+int FSioWriteBlob(
+  struct mountedFS *mount,
+  off_t offset,
+  unsigned int size,
+  void *buf
+)
+{
+  if (cacheSync(mount, offset - mount->skip, size, 1) == 0)
+    return 0;
+  return containerWrite(mount, offset, size, buf);
+}
 
 /*++
  *      F S i o R e a d B l o c k
@@ -2065,12 +3583,30 @@ int FSioReadBlock(
   void *buf
 )
 {
-  off_t offset = block * mount->blocksz;
+  off_t offset = (off_t)block * mount->blocksz;
+  struct blockCache *cache = mount->cache;
+  struct cacheBlock *cb;
+
+  if (cache != NULL) {
+    if ((cb = cacheLookup(cache, block)) != NULL) {
+      cache->hits++;
+      memcpy(buf, cb->data, mount->blocksz);
+      return 1;
+    }
+    cache->misses++;
 
-  if (fseeko(mount->container, offset + mount->skip, SEEK_SET) == 0)
-    return fread(buf, mount->blocksz, 1, mount->container);
+    if ((cb = cacheAlloc(mount, block)) != NULL) {
+      if (containerRead(mount, offset + mount->skip,
+                        mount->blocksz, cb->data) == 0) {
+        cacheRemove(cache, cb);
+        return 0;
+      }
+      memcpy(buf, cb->data, mount->blocksz);
+      return 1;
+    }
+  }
 
-  return 0;
+  return containerRead(mount, offset + mount->skip, mount->blocksz, buf);
 }
 
 /*++
@@ -2099,12 +3635,27 @@ int FSioWriteBlock(
   void *buf
 )
 {
-  off_t offset = block * mount->blocksz;
+  off_t offset = (off_t)block * mount->blocksz;
+  struct blockCache *cache = mount->cache;
+  struct cacheBlock *cb;
+
+  if (cache != NULL) {
+    if (((cb = cacheLookup(cache, block)) != NULL) ||
+        ((cb = cacheAlloc(mount, block)) != NULL)) {
+      memcpy(cb->data, buf, mount->blocksz);
+      cb->dirty = 1;
+      return 1;
+    }
 
-  if (fseeko(mount->container, offset + mount->skip, SEEK_SET) == 0)
-    return fwrite(buf, mount->blocksz, 1, mount->container);
+    /*
+     * A full cache means the least recently used block could not be
+     * written back to make room for this one.
+     */
+    if (cache->count >= cache->capacity)
+      return 0;
+  }
 
-  return 0;
+  return containerWrite(mount, offset + mount->skip, mount->blocksz, buf);
 }
 
 /*++
@@ -2140,12 +3691,11 @@ int FSioReadSector(
   void *buf
 )
 {
-  off_t offset = sector * size;
-
-  if (fseeko(mount->container, offset + mount->skip, SEEK_SET) == 0)
-    return fread(buf, size, 1, mount->container);
+  off_t offset = (off_t)sector * size;
 
-  return 0;
+  if (cacheSync(mount, offset, size, 0) == 0)
+    return 0;
+  return containerRead(mount, offset + mount->skip, size, buf);
 }
 
 /*++
@@ -2178,10 +3728,180 @@ int FSioWriteSector(
   void *buf
 )
 {
-  off_t offset = sector * size;
+  off_t offset = (off_t)sector * size;
 
-  if (fseeko(mount->container, offset + mount->skip, SEEK_SET) == 0)
-    return fwrite(buf, size, 1, mount->container);
+  if (cacheSync(mount, offset, size, 1) == 0)
+    return 0;
+  return containerWrite(mount, offset + mount->skip, size, buf);
+}
 
-  return 0;
+/*++
+ *      F S i o I m a g e L o a d
+ *
+ *  Read an entire sector-interleaved container into memory in logical sector
+ *  order. The container is read with a single request and then rearranged
+ *  using the supplied (precomputed) logical to physical sector map. Any part
+ *  of the image beyond the end of the container file reads as zero. Once the
+ *  image is loaded, the file system should use FSioImageSectors() rather
+ *  than FSioReadSector()/FSioWriteSector().
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      map             - pointer to the logical to physical sector map, the
+ *                        map must remain valid while the file system is
+ *                        mounted
+ *      nsect           - # of sectors in the map
+ *      sectsz          - size of each sector (in bytes)
+ *
+ * Outputs:
+ *
+ *      The mount descriptor will point to the new image
+ *
+ * Returns:
+ *
+ *      1 if the image was loaded, 0 otherwise (the file system should
+ *      continue to use sector I/O)
+ *
+ --*/
+int FSioImageLoad(
+  struct mountedFS *mount,
+  const uint16_t *map,
+  unsigned int nsect,
+  unsigned int sectsz
+)
+{
+  struct sectorImage *image;
+  struct stat stat;
+  size_t size = (size_t)nsect * sectsz, avail = size;
+  uint8_t *phys;
+  unsigned int i;
+
+  if (fstat(fileno(mount->container), &stat) != 0)
+    return 0;
+
+  if (stat.st_size <= mount->skip)
+    avail = 0;
+  else if ((stat.st_size - mount->skip) < (off_t)size)
+    avail = stat.st_size - mount->skip;
+
+  if ((image = malloc(sizeof(struct sectorImage) + size)) == NULL)
+    return 0;
+
+  if ((phys = calloc(1, size)) == NULL) {
+    free(image);
+    return 0;
+  }
+
+  if ((image->dirty = calloc((nsect + 7) / 8, 1)) == NULL) {
+    free(phys);
+    free(image);
+    return 0;
+  }
+
+  if ((avail != 0) &&
+      (containerRead(mount, mount->skip, avail, phys) == 0)) {
+    free(image->dirty);
+    free(phys);
+    free(image);
+    return 0;
+  }
+
+  image->map = map;
+  image->nsect = nsect;
+  image->sectsz = sectsz;
+
+  for (i = 0; i < nsect; i++)
+    memcpy(&image->data[i * sectsz], &phys[map[i] * sectsz], sectsz);
+
+  free(phys);
+  mount->image = image;
+  return 1;
+}
+
+/*++
+ *      F S i o I m a g e S e c t o r s
+ *
+ *  Return a pointer to a range of logically contiguous sectors in a
+ *  deinterleaved container image.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      sector          - first logical sector #
+ *      count           - # of sectors
+ *      write           - non-zero if the caller will modify the sectors
+ *
+ * Outputs:
+ *
+ *      If "write" is non-zero, the sectors are marked as modified
+ *
+ * Returns:
+ *
+ *      Pointer to the sector data, NULL if outside the image
+ *
+ --*/
+uint8_t *FSioImageSectors(
+  struct mountedFS *mount,
+  unsigned int sector,
+  unsigned int count,
+  int write
+)
+{
+  struct sectorImage *image = mount->image;
+  unsigned int i;
+
+  if ((sector >= image->nsect) || (count > (image->nsect - sector)))
+    return NULL;
+
+  if (write)
+    for (i = sector; i < sector + count; i++)
+      image->dirty[i / 8] |= 1 << (i % 8);
+
+  return &image->data[sector * image->sectsz];
+}
+
+/*++
+ *      i m a g e D e s t r o y
+ *
+ *  Write any modified sectors back to the container file and release a
+ *  deinterleaved container image.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      1 if all modified sectors were written back, 0 otherwise
+ *
+ --*/
+static int imageDestroy(
+  struct mountedFS *mount
+)
+{
+  struct sectorImage *image = mount->image;
+  unsigned int i;
+  int status = 1;
+
+  if (image != NULL) {
+    mount->image = NULL;
+
+    for (i = 0; i < image->nsect; i++)
+      if ((image->dirty[i / 8] & (1 << (i % 8))) != 0)
+        if (FSioWriteSector(mount, image->map[i], image->sectsz,
+                            &image->data[i * image->sectsz]) == 0) {
+          ERROR("%s: failed to write back sector %u\n",
+                mount->name, image->map[i]);
+          status = 0;
+        }
+
+    free(image->dirty);
+    free(image);
+  }
+  return status;
 }
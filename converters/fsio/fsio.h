@@ -100,6 +100,8 @@ extern FILE *DEBUGout;
 #endif
 
 struct mountedFS;
+struct blockCache;
+struct sectorImage;
 
 /*
  * File system definition
@@ -124,6 +126,7 @@ struct FSdef {
   size_t                (*readFile)(void *, void *, size_t);
   size_t                (*writeFile)(void *, void *, size_t);
   void                  (*deleteFile)(void *, char *);
+  int                   (*fileExtent)(void *, off_t *, off_t *);
   /*
    * The following functions are only supported by magtape file systems.
    */
@@ -148,10 +151,15 @@ struct mountedFS {
   uint16_t              flags;
 #define FS_READONLY     0x0001          /* Mounted read-only */
 #define FS_DEBUG        0x0002          /* Debug output */
+#define FS_MAPPED       0x0004          /* Container is memory-mapped */
                                         /* Bits after 0x0080 reserved for */
                                         /* file system use */
   FILE                  *container;     /* Container file access */
   off_t                 skip;           /* Data to skip in container file */
+  uint8_t               *map;           /* Memory-mapped container */
+  size_t                mapsz;          /* Size of mapped region */
+  struct blockCache     *cache;         /* Block cache (may be NULL) */
+  struct sectorImage    *image;         /* Deinterleaved image (may be NULL) */
   union {
     struct DOS11data    _dos11;
     struct RT11data     _rt11;
@@ -170,5 +178,7 @@ extern int FSioReadBlock(struct mountedFS *, unsigned int, void *);
 extern int FSioWriteBlock(struct mountedFS *, unsigned int, void *);
 extern int FSioReadSector(struct mountedFS *, unsigned int, unsigned int, void *);
 extern int FSioWriteSector(struct mountedFS *, unsigned int, unsigned int, void *);
+extern int FSioImageLoad(struct mountedFS *, const uint16_t *, unsigned int, unsigned int);
+extern uint8_t *FSioImageSectors(struct mountedFS *, unsigned int, unsigned int, int);
 
 #endif
@@ -365,6 +365,7 @@ struct FSdef localFS = {
   localReadFile,
   localWriteFile,
   localDeleteFile,
+  NULL,
   NULL,                                 /* No tape support functions */
   NULL,
   NULL,
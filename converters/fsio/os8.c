@@ -50,6 +50,8 @@ static int rx01WriteBlock(struct mountedFS *, uint8_t, unsigned int, void *);
 static int rx02BlockPresent(struct mountedFS *, uint8_t, unsigned int);
 static int rx02ReadBlock(struct mountedFS *, uint8_t, unsigned int, void *);
 static int rx02WriteBlock(struct mountedFS *, uint8_t, unsigned int, void *);
+static int rx01LoadImage(struct mountedFS *);
+static int rx02LoadImage(struct mountedFS *);
 
 /*
  * Floppy interleave tables:
@@ -97,6 +99,14 @@ static uint16_t rx02interleave[] = {
 };
 #define RX02REPEAT ((sizeof(rx02interleave)/sizeof(rx02interleave[0])) / 2)
 
+/*
+ * Full disk logical => physical sector maps, built from the interleave
+ * tables above on first use.
+ */
+static uint16_t rx01map[OS8_RX0xLSECT];
+static uint16_t rx02map[OS8_RX0xLSECT];
+static int rx01mapValid = 0, rx02mapValid = 0;
+
 /*
  * Six-bit code => character mapping table
  */
@@ -144,24 +154,24 @@ struct OS8device OS8Devices[] = {
   { "rk05", 2, 2 * OS8_RK05FS_BLKS,
     0,
     { OS8_RK05FS_BLKS, OS8_RK05FS_BLKS, 0, 0, 0, 0, 0,0 },
-       rk05BlockPresent, rk05ReadBlock, rk05WriteBlock },
+       rk05BlockPresent, rk05ReadBlock, rk05WriteBlock, NULL },
 
   { "rx01", 1, (OS8_RX0xSZ * OS8_RX01SS_W) / OS8_BLOCKSIZE,
     OS8_RX0xNSECT * OS8_RX01SS,
     { ((OS8_RX0xSZ - OS8_RX0xNSECT) * OS8_RX01SS_W) / OS8_BLOCKSIZE,
         0, 0, 0, 0, 0, 0, 0 },
-       rx01BlockPresent, rx01ReadBlock, rx01WriteBlock },
+       rx01BlockPresent, rx01ReadBlock, rx01WriteBlock, rx01LoadImage },
 
   { "rx02", 1, (OS8_RX0xSZ * OS8_RX02SS_W) / OS8_BLOCKSIZE,
     OS8_RX0xNSECT * OS8_RX02SS,
     { ((OS8_RX0xSZ - OS8_RX0xNSECT) * OS8_RX02SS_W) / OS8_BLOCKSIZE,
         0, 0, 0, 0, 0, 0, 0 },
-       rx02BlockPresent, rx02ReadBlock, rx02WriteBlock },
+       rx02BlockPresent, rx02ReadBlock, rx02WriteBlock, rx02LoadImage },
 
   { NULL, 0, 0,
     0,
     { 0, 0, 0, 0, 0, 0, 0, 0 },
-       NULL, NULL, NULL }
+       NULL, NULL, NULL, NULL }
 };
 
 /*++
@@ -386,6 +396,155 @@ static int os8UnitValid(
   return 0;
 }
 
+/*++
+ *      r x 0 x U n p a c k
+ *
+ *  Unpack 12-bit words from an RX01/RX02 sector (2 words in each 3 bytes).
+ *
+ * Inputs:
+ *
+ *      sector          - pointer to the sector data
+ *      buffer          - pointer to the buffer to receive the words
+ *      count           - # of words to unpack (must be even)
+ *
+ * Outputs:
+ *
+ *      The buffer will be overwritten by the unpacked words
+ *
+ * Returns:
+ *
+ *      None
+ *
+ --*/
+static void rx0xUnpack(
+  const uint8_t *sector,
+  uint16_t *buffer,
+  unsigned int count
+)
+{
+  unsigned int j, k;
+
+  for (j = 0, k = 0; j < count; j += 2, k += 3) {
+    buffer[j] = (sector[k] << 4) | (sector[k + 1] >> 4);
+    buffer[j + 1] = ((sector[k + 1] & 0xF) << 8) | sector[k + 2];
+  }
+}
+
+/*++
+ *      r x 0 x P a c k
+ *
+ *  Pack 12-bit words into an RX01/RX02 sector (2 words in each 3 bytes).
+ *
+ * Inputs:
+ *
+ *      buffer          - pointer to the buffer containing the words
+ *      sector          - pointer to the sector data
+ *      count           - # of words to pack (must be even)
+ *
+ * Outputs:
+ *
+ *      The sector will be overwritten by the packed words
+ *
+ * Returns:
+ *
+ *      None
+ *
+ --*/
+static void rx0xPack(
+  const uint16_t *buffer,
+  uint8_t *sector,
+  unsigned int count
+)
+{
+  unsigned int j, k;
+
+  for (j = 0, k = 0; j < count; j += 2, k += 3) {
+    sector[k] = (buffer[j] >> 4) & 0xFF;
+    sector[k + 1] = ((buffer[j] << 4) & 0xF0) | ((buffer[j + 1] >> 8) & 0xF);
+    sector[k + 2] = buffer[j + 1] & 0xFF;
+  }
+}
+
+/*++
+ *      r x 0 1 L o a d I m a g e
+ *
+ *  Read an entire RX01 disk into memory in logical sector order. The
+ *  logical to physical sector map is built from rx01interleave the first
+ *  time it is needed.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *
+ * Outputs:
+ *
+ *      The mount descriptor will point to the new image
+ *
+ * Returns:
+ *
+ *      1 if the image was loaded, 0 otherwise (the file system should
+ *      continue to use sector I/O)
+ *
+ --*/
+static int rx01LoadImage(
+  struct mountedFS *mount
+)
+{
+  unsigned int i;
+
+  if (!rx01mapValid) {
+    for (i = 0; i < OS8_RX0xLSECT; i++) {
+      unsigned int block = i / 4;
+      unsigned int base = (block / RX01REPEAT) * RX01REPEAT;
+      unsigned int offset = block % RX01REPEAT;
+
+      rx01map[i] = (base * 4) + rx01interleave[(offset * 4) + (i % 4)];
+    }
+    rx01mapValid = 1;
+  }
+  return FSioImageLoad(mount, rx01map, OS8_RX0xLSECT, OS8_RX01SS);
+}
+
+/*++
+ *      r x 0 2 L o a d I m a g e
+ *
+ *  Read an entire RX02 disk into memory in logical sector order. The
+ *  logical to physical sector map is built from rx02interleave the first
+ *  time it is needed.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *
+ * Outputs:
+ *
+ *      The mount descriptor will point to the new image
+ *
+ * Returns:
+ *
+ *      1 if the image was loaded, 0 otherwise (the file system should
+ *      continue to use sector I/O)
+ *
+ --*/
+static int rx02LoadImage(
+  struct mountedFS *mount
+)
+{
+  unsigned int i;
+
+  if (!rx02mapValid) {
+    for (i = 0; i < OS8_RX0xLSECT; i++) {
+      unsigned int block = i / 2;
+      unsigned int base = (block / RX02REPEAT) * RX02REPEAT;
+      unsigned int offset = block % RX02REPEAT;
+
+      rx02map[i] = (base * 2) + rx02interleave[(offset * 2) + (i % 2)];
+    }
+    rx02mapValid = 1;
+  }
+  return FSioImageLoad(mount, rx02map, OS8_RX0xLSECT, OS8_RX02SS);
+}
+
 /*++
  *      r k 0 5 B l o c k P r e s e n t
  *
@@ -570,7 +729,7 @@ static int rx01ReadBlock(
   unsigned int base = (block / RX01REPEAT) * RX01REPEAT;
   unsigned int offset = block % RX01REPEAT;
   uint16_t *buffer = buf;
-  int i, j, k, status;
+  int i, status;
 
 #ifdef DEBUG
   if ((mount->flags & FS_DEBUG) != 0)
@@ -578,6 +737,20 @@ static int rx01ReadBlock(
             mount->name, unit, base, offset);
 #endif
 
+  if (mount->image != NULL) {
+    uint8_t *sectors = FSioImageSectors(mount, block * 4, 4, 0);
+
+    if (sectors == NULL) {
+      ERROR("I/O error on \"%s%o:\"\n", mount->name, unit);
+      return 0;
+    }
+
+    for (i = 0; i < 4; i++)
+      rx0xUnpack(&sectors[i * OS8_RX01SS],
+                 &buffer[i * OS8_RX01SS_W], OS8_RX01SS_W);
+    return 1;
+  }
+
   /*
    * Convert to sector number
    */
@@ -606,10 +779,7 @@ static int rx01ReadBlock(
     /*
      * Unpack 64 words from the temporary buffer
      */
-    for (j = 0, k = 0; j < OS8_RX01SS_W; j += 2, k += 3) {
-      buffer[j] = ((temp[k] << 4) | ((temp[k + 1] >> 4) & 0xF)) & 0xFFF;
-      buffer[j + 1] = (((temp[k + 1] << 8) & 0xF00) | temp[k + 2]) & 0xFFF;
-    }
+    rx0xUnpack(temp, buffer, OS8_RX01SS_W);
     buffer += OS8_RX01SS_W;
   }
   return 1;
@@ -646,7 +816,7 @@ static int rx01WriteBlock(
   unsigned int base = (block / RX01REPEAT) * RX01REPEAT;
   unsigned int offset = block % RX01REPEAT;
   uint16_t *buffer = buf;
-  int i, j, k, status;
+  int i, status;
 
 #ifdef DEBUG
   if ((mount->flags & FS_DEBUG) != 0)
@@ -654,6 +824,20 @@ static int rx01WriteBlock(
             mount->name, unit, base, offset);
 #endif
 
+  if (mount->image != NULL) {
+    uint8_t *sectors = FSioImageSectors(mount, block * 4, 4, 1);
+
+    if (sectors == NULL) {
+      ERROR("I/O error on \"%s%o:\"\n", mount->name, unit);
+      return 0;
+    }
+
+    for (i = 0; i < 4; i++)
+      rx0xPack(&buffer[i * OS8_RX01SS_W],
+               &sectors[i * OS8_RX01SS], OS8_RX01SS_W);
+    return 1;
+  }
+
   /*
    * Convert to sector number
    */
@@ -669,11 +853,7 @@ static int rx01WriteBlock(
     /*
      * Pack 64 words into the temporary buffer
      */
-    for (j = 0, k = 0; j < OS8_RX01SS_W; j += 2, k += 3) {
-      temp[k] = (buffer[j] >> 4) & 0xFF;
-      temp[k + 1] = ((buffer[j] << 4) & 0xF0) | ((buffer[j + 1] >> 8) & 0xF);
-      temp[k + 2] = buffer[j + 1] & 0xFF;
-    }
+    rx0xPack(buffer, temp, OS8_RX01SS_W);
 
 #ifdef DEBUG
     if ((mount->flags & FS_DEBUG) != 0)
@@ -754,7 +934,7 @@ static int rx02ReadBlock(
   unsigned int base = (block / RX02REPEAT) * RX02REPEAT;
   unsigned int offset = block % RX02REPEAT;
   uint16_t *buffer = buf;
-  int i, j, k, status;
+  int i, status;
 
 #ifdef DEBUG
   if ((mount->flags & FS_DEBUG) != 0)
@@ -762,6 +942,20 @@ static int rx02ReadBlock(
             mount->name, unit, base, offset);
 #endif
 
+  if (mount->image != NULL) {
+    uint8_t *sectors = FSioImageSectors(mount, block * 2, 2, 0);
+
+    if (sectors == NULL) {
+      ERROR("I/O error on \"%s%o:\"\n", mount->name, unit);
+      return 0;
+    }
+
+    for (i = 0; i < 2; i++)
+      rx0xUnpack(&sectors[i * OS8_RX02SS],
+                 &buffer[i * OS8_RX02SS_W], OS8_RX02SS_W);
+    return 1;
+  }
+
   /*
    * Convert to sector number
    */
@@ -790,10 +984,7 @@ static int rx02ReadBlock(
     /*
      * Unpack 128 words from the temporary buffer
      */
-    for (j = 0, k = 0; j < OS8_RX02SS_W; j += 2, k += 3) {
-      buffer[j] = ((temp[k] << 4) | ((temp[k + 1] >> 4) & 0xF)) & 0xFFF;
-      buffer[j + 1] = (((temp[k + 1] << 8) & 0xF00) | temp[k + 2]) & 0xFFF;
-    }
+    rx0xUnpack(temp, buffer, OS8_RX02SS_W);
     buffer += OS8_RX02SS_W;
   }
   return 1;
@@ -830,7 +1021,7 @@ static int rx02WriteBlock(
   unsigned int base = (block / RX02REPEAT) * RX02REPEAT;
   unsigned int offset = block % RX02REPEAT;
   uint16_t *buffer = buf;
-  int i, j, k, status;
+  int i, status;
 
 #ifdef DEBUG
   if ((mount->flags & FS_DEBUG) != 0)
@@ -838,6 +1029,20 @@ static int rx02WriteBlock(
             mount->name, unit, base, offset);
 #endif
 
+  if (mount->image != NULL) {
+    uint8_t *sectors = FSioImageSectors(mount, block * 2, 2, 1);
+
+    if (sectors == NULL) {
+      ERROR("I/O error on \"%s%o:\"\n", mount->name, unit);
+      return 0;
+    }
+
+    for (i = 0; i < 2; i++)
+      rx0xPack(&buffer[i * OS8_RX02SS_W],
+               &sectors[i * OS8_RX02SS], OS8_RX02SS_W);
+    return 1;
+  }
+
   /*
    * Convert to sector number
    */
@@ -853,11 +1058,7 @@ static int rx02WriteBlock(
     /*
      * Pack 128 words into the temporary buffer
      */
-    for (j = 0, k = 0; j < OS8_RX02SS_W; j += 2, k += 3) {
-      temp[k] = (buffer[j] >> 4) & 0xFF;
-      temp[k + 1] = ((buffer[j] << 4) & 0xF0) | ((buffer[j + 1] >> 8) & 0xF);
-      temp[k + 2] = buffer[j + 1] & 0xFF;
-    }
+    rx0xPack(buffer, temp, OS8_RX02SS_W);
 
 #ifdef DEBUG
     if ((mount->flags & FS_DEBUG) != 0)
@@ -2226,12 +2427,12 @@ int os8WriteBytes(
         /* FALLTHROUGH */
 
       case OS8_BYTE0:
-        file->buffer[file->wordpos++] = os8Value(*buf++);
+        file->buffer[file->wordpos++] = os8Value((uint8_t)*buf++);
         file->bytepos = OS8_BYTE1;
         break;
 
       case OS8_BYTE1:
-        file->buffer[file->wordpos++] = os8Value(*buf++);
+        file->buffer[file->wordpos++] = os8Value((uint8_t)*buf++);
         file->bytepos = OS8_BYTE2;
         break;
 
@@ -2304,6 +2505,13 @@ static int os8Mount(
           mount->skip = dev->skip;
           data->device = dev;
 
+          /*
+           * Interleaved devices are small enough to be read into memory
+           * in logical order.
+           */
+          if (dev->loadImage != NULL)
+            (*dev->loadImage)(mount);
+
           /*
            * Validate all possible file systems.
            */
@@ -2825,7 +3033,10 @@ static off_t os8FileSize(
 {
   struct os8OpenFile *file = filep;
 
-  return (file->length * RT11_BLOCKSIZE * 2) / 3;
+  /*
+   * Each 256-word block holds 384 bytes (3 bytes packed into 2 words).
+   */
+  return (file->length * OS8_BLOCKSIZE * 3) / 2;
 }
 
 /*++
@@ -2862,8 +3073,11 @@ static void os8DeleteFile(
   data->buf[file->offset + OS8_DI_FNAME1] = 0;
   data->buf[file->offset + OS8_ED_LENGTH] =
     data->buf[file->offset + file->extra + OS8_DI_LENGTH];
-  data->buf[OS8_DH_ENTRIES] =
-    htole16(os8Value(-(os8Neg(le16toh(data->buf[OS8_DH_ENTRIES])) - 1)));
+
+  /*
+   * The file entry is replaced by an empty entry so the number of entries in
+   * the segment is unchanged (unless empty entries are merged below).
+   */
 
   os8SlideUp(mount, file->offset + OS8_ED_SIZE,
              file->offset + file->entrysz, file->entrysz, file->remain);
@@ -3007,6 +3221,7 @@ struct FSdef os8FS = {
   os8ReadFile,
   os8WriteFile,
   os8DeleteFile,
+  NULL,
   NULL,                                 /* No tape support functions */
   NULL,
   NULL,
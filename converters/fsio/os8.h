@@ -161,6 +161,8 @@
 #define OS8_RX02SS_W    128             /* Word sector size of RX02 floppy */
 #define OS8_RX0xNSECT   26              /* Sectors/track on RX01/RX02 */
 #define OS8_RX0xSZ      2002            /* Sectors on an RX01/RX02 */
+#define OS8_RX0xLSECT   (OS8_RX0xSZ - OS8_RX0xNSECT)
+                                        /* Logical sectors (no track 0) */
 
 /*
  * Structure to describe a filename. Asterisks may be used as wild card
@@ -231,6 +233,7 @@ struct OS8device {
   int                   (*blockPresent)(struct mountedFS *, uint8_t, unsigned int);
   int                   (*readBlock)(struct mountedFS *, uint8_t, unsigned int, void *);
   int                   (*writeBlock)(struct mountedFS *, uint8_t, unsigned int, void *);
+  int                   (*loadImage)(struct mountedFS *);
 };
 
 /*
@@ -37,7 +37,6 @@
 #include <ctype.h>
 #include <time.h>
 #include <sys/stat.h>
-#include <regex.h>
 
 #include "fsio.h"
 
@@ -53,6 +52,13 @@ static struct DiskSize {
   { NULL, 0 }
 };
 
+/*
+ * Precomputed logical => physical sector map for RX01/RX02 interleave
+ * (see MapLogToPhys).
+ */
+static uint16_t rxMap[RT11_RX0xLSECT];
+static int rxMapValid = 0;
+
 static int rt11BestFit(struct mountedFS *, uint8_t, uint16_t,
                        uint16_t *, uint16_t *, uint16_t *, uint16_t *);
 static void rt11CloseFile(void *);
@@ -195,151 +201,345 @@ int rt11ParseFilespec(
 }
 
 /*++
- *      r t 1 1 B u i l d R e g e x
+ *      r t 1 1 P a t t e r n C h a r
  *
- *  Build and compile a regular expression to match a filename with wildcard
- *  characters.
+ *  Convert a character from a file specification into its pattern code.
  *
  * Inputs:
  *
- *      spec            - pointer to the file specification block
- *      preg            - pointer to regex_t structure to receive the
- *                        compiled regular expression
+ *      ch              - character from the file name or type
  *
  * Outputs:
  *
- *      The compilation may dynamically allocate storage which must be
- *      released using regfree().
+ *      None
  *
  * Returns:
  *
- *      1 if regular expression was successfully compiled, 0 otherwise
+ *      RT11_PAT_STAR for '*', RT11_PAT_ANY for '%', otherwise the RAD50
+ *      character code
  *
  --*/
-static int rt11BuildRegex(
-  struct rt11FileSpec *spec,
-  regex_t *preg
+static uint8_t rt11PatternChar(
+  char ch
 )
 {
-  char temp[64];
-  unsigned int i, j = 0;
+  switch (ch) {
+    case '*':
+      return RT11_PAT_STAR;
 
+    case '%':
+      return RT11_PAT_ANY;
+  }
   /*
-   * Convert the filename into a regular expression suitable for compilation.
+   * The parser only accepts alphanumeric characters which are always in
+   * the RAD50 character set.
    */
-  temp[j++] = '^';
-
-  for (i = 0; i < sizeof(spec->fname); i++) {
-    if (spec->fname[i] == ' ')
-      break;
-
-    switch (spec->fname[i]) {
-      case '*':
-        temp[j++] = '.';
-        temp[j++] = '*';
-        break;
-
-      case '%':
-        temp[j++] = '.';
-        break;
+  return strchr(rad50, toupper(ch)) - rad50;
+}
 
-      default:
-        temp[j++] = toupper(spec->fname[i]);
-        break;
-    }
-  }
+/*++
+ *      r t 1 1 B u i l d P a t t e r n
+ *
+ *  Compile a file specification, which may contain wildcard characters, into
+ *  a pattern which can be matched directly against RAD50 directory entries.
+ *
+ * Inputs:
+ *
+ *      spec            - pointer to the file specification block
+ *      pat             - pointer to the pattern to be filled in
+ *
+ * Outputs:
+ *
+ *      The pattern will be filled in
+ *
+ * Returns:
+ *
+ *      None
+ *
+ --*/
+static void rt11BuildPattern(
+  struct rt11FileSpec *spec,
+  struct rt11Pattern *pat
+)
+{
+  unsigned int i;
 
-  temp[j++] = '\\';
-  temp[j++] = '.';
+  pat->flags = spec->flags;
+  pat->name[0] = spec->name[0];
+  pat->name[1] = spec->name[1];
+  pat->type = spec->type;
 
-  for (i = 0; i < sizeof(spec->ftype); i++) {
-    if (spec->ftype[i] == ' ')
-      break;
+  for (i = 0; (i < sizeof(spec->fname)) && (spec->fname[i] != ' '); i++)
+    pat->npat[i] = rt11PatternChar(spec->fname[i]);
+  pat->nlen = i;
 
-    switch (spec->ftype[i]) {
-      case '*':
-        temp[j++] = '.';
-        temp[j++] = '*';
-        break;
+  for (i = 0; (i < sizeof(spec->ftype)) && (spec->ftype[i] != ' '); i++)
+    pat->tpat[i] = rt11PatternChar(spec->ftype[i]);
+  pat->tlen = i;
+}
 
-      case '%':
-        temp[j++] = '.';
-        break;
+/*++
+ *      r t 1 1 G l o b
+ *
+ *  Match a sequence of RAD50 character codes against a wildcard pattern.
+ *  Trailing spaces (code 0) in the sequence are not significant.
+ *
+ * Inputs:
+ *
+ *      pat             - pointer to the pattern
+ *      plen            - length of the pattern
+ *      value           - RAD50 words to be matched
+ *      count           - # of RAD50 words
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      1 if the pattern matches, 0 otherwise
+ *
+ --*/
+static int rt11Glob(
+  uint8_t *pat,
+  int plen,
+  uint16_t *value,
+  int count
+)
+{
+  uint8_t str[6];
+  int i, slen = 0, p = 0, s = 0, star = -1, mark = 0;
 
-      default:
-        temp[j++] = toupper(spec->ftype[i]);
-        break;
-    }
+  for (i = 0; i < count; i++) {
+    str[slen++] = value[i] / (050 * 050);
+    str[slen++] = (value[i] / 050) % 050;
+    str[slen++] = value[i] % 050;
+  }
+  while ((slen != 0) && (str[slen - 1] == 0))
+    slen--;
+
+  while (s < slen) {
+    if ((p < plen) && ((pat[p] == RT11_PAT_ANY) || (pat[p] == str[s]))) {
+      p++;
+      s++;
+    } else if ((p < plen) && (pat[p] == RT11_PAT_STAR)) {
+      star = p++;
+      mark = s;
+    } else if (star != -1) {
+      /*
+       * Let the last '*' absorb one more character and try again.
+       */
+      p = star + 1;
+      s = ++mark;
+    } else return 0;
   }
 
-  temp[j++] = '$';
-  temp[j++] = '\0';
-
-  /*
-   * Compile the regular expression.
-   */
-  if (regcomp(preg, temp, 0) == 0)
-    return 1;
+  while ((p < plen) && (pat[p] == RT11_PAT_STAR))
+    p++;
 
-  return 0;
+  return p == plen;
 }
-
+
 /*++
- *      r t 1 1 M a t c h R e g e x
+ *      r t 1 1 M a t c h P a t t e r n
  *
- *  Match a pre-compiled regular expression against a filename and type.
+ *  Match a compiled file specification against a filename and type.
+ *  Components without wildcards are compared as RAD50 words.
  *
  * Inputs:
  *
- *      preg            - pointer to pre-compiler regular expression
+ *      pat             - pointer to the compiled pattern
  *      fname1          - first 3 characters of filename (RAD50)
  *      fname2          - next 3 characters of filename (RAD50)
  *      ftype           - 3 characters of file type (RAD50)
  *
  * Outputs:
  *
- *      ...
+ *      None
  *
  * Returns:
  *
- *      1 if regular expression matches, 0 otherwise
+ *      1 if the pattern matches, 0 otherwise
  *
  --*/
-int rt11MatchRegex(
-  regex_t *preg,
+static int rt11MatchPattern(
+  struct rt11Pattern *pat,
   uint16_t fname1,
   uint16_t fname2,
   uint16_t ftype
 )
 {
-  char temp[16];
-  int i = 5;
+  if ((pat->flags & RT11_WC_NAME) != 0) {
+    uint16_t name[2];
+
+    name[0] = fname1;
+    name[1] = fname2;
+    if (rt11Glob(pat->npat, pat->nlen, name, 2) == 0)
+      return 0;
+  } else {
+    if ((fname1 != pat->name[0]) || (fname2 != pat->name[1]))
+      return 0;
+  }
+
+  if ((pat->flags & RT11_WC_TYPE) != 0)
+    return rt11Glob(pat->tpat, pat->tlen, &ftype, 1);
+
+  return ftype == pat->type;
+}
+
+/*++
+ *      r t 1 1 I n d e x H a s h
+ *
+ *  Compute the directory index hash bucket for a filename and type.
+ *
+ * Inputs:
+ *
+ *      name            - pointer to the filename (RAD50)
+ *      type            - file type (RAD50)
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      Hash bucket #
+ *
+ --*/
+static unsigned int rt11IndexHash(
+  uint16_t *name,
+  uint16_t type
+)
+{
+  uint32_t hash = (name[0] * 40503U) ^ (name[1] * 2654435761U) ^ type;
+
+  return (hash ^ (hash >> 16)) & (RT11_IX_HASHSZ - 1);
+}
+
+/*++
+ *      r t 1 1 I n d e x S e g m e n t
+ *
+ *  Refresh the directory index for a directory segment. The directory
+ *  segment is currently in the mount point specific buffer.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *      unit            - partition number
+ *      segment         - logical directory segment # (1 - 31)
+ *
+ * Outputs:
+ *
+ *      The directory index will be modified
+ *
+ * Returns:
+ *
+ *      None
+ *
+ --*/
+static void rt11IndexSegment(
+  struct mountedFS *mount,
+  uint8_t unit,
+  uint16_t segment
+)
+{
+  struct RT11data *data = &mount->rt11data;
+  struct rt11Index *index = data->index[unit];
+  struct rt11IndexSegment *seg;
+  uint16_t entrysz, position, off = RT11_DH_SIZE, i;
+
+  if ((index == NULL) || (segment == 0) || (segment > RT11_DS_MAX))
+    return;
+
+  seg = &index->segment[segment - 1];
 
   /*
-   * Build a filename + type string with no embedded spaces.
+   * Remove the previous contents of the segment from the hash chains.
    */
-  r50Asc(fname1, &temp[0]);
-  r50Asc(fname2, &temp[3]);
+  for (i = 0; i < seg->count; i++) {
+    struct rt11IndexEntry *entry = &seg->entry[i];
 
-  while ((i >= 0) && (temp[i] == ' '))
-    i--;
+    if ((entry->status & RT11_E_MPTY) == 0) {
+      uint16_t id = RT11_IX_ID(segment, i);
+      uint16_t *link = &index->hash[rt11IndexHash(entry->name, entry->type)];
 
-  temp[++i] = '.';
+      while (*link != 0) {
+        if (*link == id) {
+          *link = entry->hnext;
+          break;
+        }
+        link = &index->segment[RT11_IX_SEG(*link) - 1]
+                 .entry[RT11_IX_ENT(*link)].hnext;
+      }
+    }
+  }
 
-  r50Asc(ftype, &temp[++i]);
+  seg->count = 0;
+  seg->next = le16toh(data->buf[RT11_DH_NEXT]);
 
-  i += 2;
-  while (temp[i] == ' ')
-    i--;
+  entrysz = RT11_DI_SIZE + (le16toh(data->buf[RT11_DH_EXTRA]) >> 1);
+  position = le16toh(data->buf[RT11_DH_START]);
 
-  temp[i + 1] = '\0';
+  while (!RT11EOS(le16toh(data->buf[off + RT11_DI_STATUS])) &&
+         ((RT11_DS_SIZE - off) >= entrysz) &&
+         (seg->count < RT11_IX_ENTRIES)) {
+    struct rt11IndexEntry *entry = &seg->entry[seg->count];
+
+    entry->status = le16toh(data->buf[off + RT11_DI_STATUS]);
+    entry->name[0] = le16toh(data->buf[off + RT11_DI_FNAME1]);
+    entry->name[1] = le16toh(data->buf[off + RT11_DI_FNAME2]);
+    entry->type = le16toh(data->buf[off + RT11_DI_FTYPE]);
+    entry->length = le16toh(data->buf[off + RT11_DI_LENGTH]);
+    entry->creation = le16toh(data->buf[off + RT11_DI_CREATE]);
+    entry->start = position;
+    entry->offset = off;
+    entry->hnext = 0;
+
+    if ((entry->status & RT11_E_MPTY) == 0) {
+      unsigned int bucket = rt11IndexHash(entry->name, entry->type);
+
+      entry->hnext = index->hash[bucket];
+      index->hash[bucket] = RT11_IX_ID(segment, seg->count);
+    }
 
-  if (regexec(preg, &temp[0], 0, NULL, 0) == 0)
-    return 1;
+    position += entry->length;
+    off += entrysz;
+    seg->count++;
+  }
+}
 
-  return 0;
+/*++
+ *      r t 1 1 I n d e x F r e e
+ *
+ *  Release the directory indexes for all partitions.
+ *
+ * Inputs:
+ *
+ *      mount           - pointer to a mounted file system descriptor
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      None
+ *
+ --*/
+static void rt11IndexFree(
+  struct mountedFS *mount
+)
+{
+  struct RT11data *data = &mount->rt11data;
+  int i;
+
+  for (i = 0; i < 256; i++)
+    if (data->index[i] != NULL) {
+      free(data->index[i]);
+      data->index[i] = NULL;
+    }
 }
-
+
 /*++
  *      M a p L o g T o P h y s
  *
@@ -372,6 +572,37 @@ unsigned int MapLogToPhys(
   sector = (i + (6 * track)) % RT11_RX0xNSECT;
   return sector + (track * RT11_RX0xNSECT);
 }
+
+/*++
+ *      r t 1 1 R X m a p
+ *
+ *  Return the logical to physical sector map for an RX01/RX02 drive,
+ *  building it on first use.
+ *
+ * Inputs:
+ *
+ *      None
+ *
+ * Outputs:
+ *
+ *      None
+ *
+ * Returns:
+ *
+ *      Pointer to the sector map (RT11_RX0xLSECT entries)
+ *
+ --*/
+static uint16_t *rt11RXmap(void)
+{
+  unsigned int i;
+
+  if (!rxMapValid) {
+    for (i = 0; i < RT11_RX0xLSECT; i++)
+      rxMap[i] = MapLogToPhys(i);
+    rxMapValid = 1;
+  }
+  return rxMap;
+}
 
 /*++
  *      r t 1 1 R e a d B l o c k
@@ -428,15 +659,25 @@ int rt11ReadBlock(
       unsigned int count = RT11_BLOCKSIZE / data->sectorsz;
       unsigned int sectno = block * count;
 
-      do {
-        unsigned int sector = MapLogToPhys(sectno);
+      if (mount->image != NULL) {
+        uint8_t *sectors = FSioImageSectors(mount, sectno, count, 0);
 
-        status = FSioReadSector(mount, sector, data->sectorsz, buffer);
+        if ((status = (sectors != NULL)) != 0)
+          memcpy(buffer, sectors, RT11_BLOCKSIZE);
+      } else {
+        uint16_t *map = rt11RXmap();
 
-        count--;
-        buffer += data->sectorsz;
-        sectno++;
-      } while ((count != 0) && (status != 0));
+        do {
+          unsigned int sector;
+
+          sector = sectno < RT11_RX0xLSECT ? map[sectno] : MapLogToPhys(sectno);
+          status = FSioReadSector(mount, sector, data->sectorsz, buffer);
+
+          count--;
+          buffer += data->sectorsz;
+          sectno++;
+        } while ((count != 0) && (status != 0));
+      }
     } else status = FSioReadBlock(mount, (unit << 16) | block, buffer);
 
     if (status == 0)
@@ -501,15 +742,25 @@ int rt11WriteBlock(
       unsigned int count = RT11_BLOCKSIZE / data->sectorsz;
       unsigned int sectno = block * count;
 
-      do {
-        unsigned int sector = MapLogToPhys(sectno);
+      if (mount->image != NULL) {
+        uint8_t *sectors = FSioImageSectors(mount, sectno, count, 1);
 
-        status = FSioWriteSector(mount, sector, data->sectorsz, buffer);
+        if ((status = (sectors != NULL)) != 0)
+          memcpy(sectors, buffer, RT11_BLOCKSIZE);
+      } else {
+        uint16_t *map = rt11RXmap();
 
-        count--;
-        buffer += data->sectorsz;
-        sectno++;
-      } while ((count != 0) && (status != 0));
+        do {
+          unsigned int sector;
+
+          sector = sectno < RT11_RX0xLSECT ? map[sectno] : MapLogToPhys(sectno);
+          status = FSioWriteSector(mount, sector, data->sectorsz, buffer);
+
+          count--;
+          buffer += data->sectorsz;
+          sectno++;
+        } while ((count != 0) && (status != 0));
+      }
     } else status = FSioWriteBlock(mount, (unit << 16) | block, buffer);
 
     if (status == 0)
@@ -560,6 +811,7 @@ int rt11ReadDirSegment(
  *      r t 1 1 W r i t e D i r S e g m e n t
  *
  *  Write a directory segment (2 disk blocks) from the mount specific buffer.
+ *  The directory index is refreshed to match the new segment contents.
  *
  * Inputs:
  *
@@ -586,8 +838,10 @@ int rt11WriteDirSegment(
   unsigned int block = data->first[unit] + ((segment - 1) * 2);
 
   if (rt11WriteBlock(mount, unit, block, &data->buf[0]) != 0)
-    if (rt11WriteBlock(mount, unit, block + 1, &data->buf[256]) != 0)
+    if (rt11WriteBlock(mount, unit, block + 1, &data->buf[256]) != 0) {
+      rt11IndexSegment(mount, unit, segment);
       return 1;
+    }
 
   return 0;
 }
@@ -1188,7 +1442,7 @@ int rt11CreateFile(
  *
  * Outputs:
  *
- *      The mount point specific buffer will be modified
+ *      None, the lookup is satisfied from the directory index
  *
  * Returns:
  *
@@ -1203,64 +1457,46 @@ int rt11LookupFile(
 )
 {
   struct RT11data *data = &mount->rt11data;
+  struct rt11Index *index = data->index[unit];
 
-  if (RT11_PARTITIONVALID(data, unit)) {
-    uint16_t entrysz, position, dsseg = 1;
-
-    do {
-      uint16_t off = RT11_DH_SIZE;
-
-      if (rt11ReadDirSegment(mount, unit, dsseg) == 0)
-        return 0;
-
-      entrysz = RT11_DI_SIZE + (le16toh(data->buf[RT11_DH_EXTRA]) >> 1);
-      position = le16toh(data->buf[RT11_DH_START]);
+  if (RT11_PARTITIONVALID(data, unit) && (index != NULL)) {
+    uint16_t id = index->hash[rt11IndexHash(spec->name, spec->type)];
 
-      /*
-       * Loop until we see and end-of-segment marker or there is no room for
-       * another directory entry.
-       */
-      while (!RT11EOS(le16toh(data->buf[off + RT11_DI_STATUS])) &&
-             ((RT11_DS_SIZE - off) >= entrysz)) {
-        uint16_t status = le16toh(data->buf[off + RT11_DI_STATUS]);
-        
-        if ((status & RT11_E_MPTY) == 0) {
-          if ((le16toh(data->buf[off + RT11_DI_FNAME1]) == spec->name[0]) &&
-              (le16toh(data->buf[off + RT11_DI_FNAME2]) == spec->name[1]) &&
-              (le16toh(data->buf[off + RT11_DI_FTYPE]) == spec->type)) {
+    while (id != 0) {
+      uint16_t segment = RT11_IX_SEG(id);
+      struct rt11IndexEntry *entry =
+        &index->segment[segment - 1].entry[RT11_IX_ENT(id)];
 
-            /*
-             * Save directory entry and it's location in the open file
-             * descriptor.
-             */
-            file->status = data->buf[off + RT11_DI_STATUS];
-            file->name[0] = data->buf[off + RT11_DI_FNAME1];
-            file->name[1] = data->buf[off + RT11_DI_FNAME2];
-            file->type = data->buf[off + RT11_DI_FTYPE];
-            file->length = data->buf[off + RT11_DI_LENGTH];
-            file->creation = data->buf[off + RT11_DI_CREATE];
+      if ((entry->name[0] == spec->name[0]) &&
+          (entry->name[1] == spec->name[1]) &&
+          (entry->type == spec->type)) {
+        /*
+         * Save directory entry and it's location in the open file
+         * descriptor.
+         */
+        file->status = htole16(entry->status);
+        file->name[0] = htole16(entry->name[0]);
+        file->name[1] = htole16(entry->name[1]);
+        file->type = htole16(entry->type);
+        file->length = htole16(entry->length);
+        file->creation = htole16(entry->creation);
 
-            file->segment = dsseg;
-            file->offset = off;
+        file->segment = segment;
+        file->offset = entry->offset;
 
-            file->mount = mount;
-            file->unit = unit;
+        file->mount = mount;
+        file->unit = unit;
 
-            file->start = position;
+        file->start = entry->start;
 
-            return 1;
-          }
-        }
-        position += le16toh(data->buf[off + RT11_DI_LENGTH]);
-
-        off += entrysz;
+        return 1;
       }
-      dsseg = le16toh(data->buf[RT11_DH_NEXT]);
-    } while (dsseg != 0);
+      id = entry->hnext;
+    }
   }
   return 0;
 }
-
+
 /*++
  *      r t 1 1 U p d a t e F i l e
  *
@@ -1561,20 +1797,16 @@ static int validate(
      */
     while (!RT11EOS(le16toh(data->buf[off + RT11_DI_STATUS])) &&
            ((RT11_DS_SIZE - off) >= entrysz)) {
-      uint16_t status = le16toh(data->buf[off + RT11_DI_STATUS]);
-
-      position += le16toh(data->buf[off + RT11_DI_LENGTH]);
-
-      if ((status & RT11_E_MPTY) != 0)
-        break;
+      uint16_t length = le16toh(data->buf[off + RT11_DI_LENGTH]);
 
       /*
        * Within each directory segment the base address should never
        * decrease.
        */
-      if (((position + le16toh(data->buf[off + RT11_DI_LENGTH])) & 0xFFFF) < position)
+      if (((position + length) & 0xFFFF) < position)
         return RT11_NOPART;
 
+      position += length;
       off += entrysz;
     }
     if (position > highest)
@@ -1775,6 +2007,7 @@ static int rt11Mount(
     if (data->sectorsz == 0)
       fprintf(stderr,
               "mount: Ignoring unknown disk type \"%s\"\n", SWGETVAL('t'));
+    else FSioImageLoad(mount, rt11RXmap(), RT11_RX0xLSECT, data->sectorsz);
   }
 
   memset(&data->valid, 0, sizeof(data->valid));
@@ -1824,11 +2057,24 @@ static int rt11Mount(
           uint16_t entrysz, freeblks = 0, dsseg = 1;
           uint16_t highest = 0;
 
+          if ((data->index[i] = calloc(1, sizeof(struct rt11Index))) == NULL) {
+            fprintf(stderr, "mount: out of memory\n");
+            rt11IndexFree(mount);
+            return 0;
+          }
+
           do {
             uint16_t off = RT11_DH_SIZE;
 
-            if (rt11ReadDirSegment(mount, i, dsseg) == 0)
+            if (rt11ReadDirSegment(mount, i, dsseg) == 0) {
+              rt11IndexFree(mount);
               return 0;
+            }
+
+            /*
+             * Build the directory index as we go.
+             */
+            rt11IndexSegment(mount, i, dsseg);
 
             if (highest == 0)
               highest = le16toh(data->buf[RT11_DH_HIGHEST]);
@@ -1854,8 +2100,10 @@ static int rt11Mount(
             cnt = le16toh(data->buf[RT11_DH_COUNT]);
             extra = le16toh(data->buf[RT11_DH_EXTRA]);
 
-            if (rt11ReadBlock(mount, i, RT11_HOME, NULL) == 0)
+            if (rt11ReadBlock(mount, i, RT11_HOME, NULL) == 0) {
+              rt11IndexFree(mount);
               return 0;
+            }
 
             /*
              * Special handling of volumes created by non-RT-11 systenms
@@ -1918,9 +2166,10 @@ static int rt11Mount(
  *
  --*/
 static void rt11Umount(
-  struct mountedFS *UNUSED(mount)
+  struct mountedFS *mount
 )
 {
+  rt11IndexFree(mount);
 }
 
 /*++
@@ -2157,72 +2406,53 @@ static void rt11Dir(
 )
 {
   struct RT11data *data = &mount->rt11data;
+  struct rt11Index *index = data->index[unit];
   struct rt11FileSpec spec;
+  struct rt11Pattern pat;
 
   if (rt11ParseFilespec(fname, &spec, RT11_M_NONAME) == 0) {
     fprintf(stderr, "dir: syntax error in file spec \"%s\"\n", fname);
     return;
   }
 
-  if (RT11_PARTITIONVALID(data, unit)) {
-    uint16_t entrysz, dsseg = 1;
-    regex_t reg;
+  if (RT11_PARTITIONVALID(data, unit) && (index != NULL)) {
+    uint16_t dsseg = 1, count = 0;
 
-    if ((spec.flags & (RT11_WC_NAME | RT11_WC_TYPE)) != 0)
-      if (rt11BuildRegex(&spec, &reg) == 0) {
-        fprintf(stderr, "dir: regcomp() failed\n");
-        return;
-      }
+    rt11BuildPattern(&spec, &pat);
 
+    /*
+     * Walk the directory segments in logical order. The segment count
+     * protects against a corrupt (circular) segment chain.
+     */
     do {
-      uint16_t off = RT11_DH_SIZE;
+      struct rt11IndexSegment *seg = &index->segment[dsseg - 1];
+      uint16_t i;
 
-      if (rt11ReadDirSegment(mount, unit, dsseg) == 0) {
-        if ((spec.flags & (RT11_WC_NAME | RT11_WC_TYPE)) != 0)
-          regfree(&reg);
-        return;
-      }
+      for (i = 0; i < seg->count; i++) {
+        struct rt11IndexEntry *entry = &seg->entry[i];
 
-      entrysz = RT11_DI_SIZE + (le16toh(data->buf[RT11_DH_EXTRA]) >> 1);
+        if ((entry->status & (RT11_E_TENT | RT11_E_MPTY)) == 0) {
+          if (rt11MatchPattern(&pat,
+                               entry->name[0], entry->name[1], entry->type)) {
+            uint16_t dir[RT11_DI_SIZE];
 
-      /*
-       * Loop until we see and end-of-segment marker or there is no room for
-       * another directory entry.
-       */
-      while (!RT11EOS(le16toh(data->buf[off + RT11_DI_STATUS])) &&
-             ((RT11_DS_SIZE - off) >= entrysz)) {
-        uint16_t status = le16toh(data->buf[off + RT11_DI_STATUS]);
-        
-        if ((status & (RT11_E_TENT | RT11_E_MPTY)) == 0) {
-          uint16_t fname1 = le16toh(data->buf[off + RT11_DI_FNAME1]);
-          uint16_t fname2 = le16toh(data->buf[off + RT11_DI_FNAME2]);
-          uint16_t ftype = le16toh(data->buf[off + RT11_DI_FTYPE]);
-
-          if ((spec.flags & (RT11_WC_NAME | RT11_WC_TYPE)) == 0) {
-            if ((fname1 != spec.name[0]) ||
-                (fname2 != spec.name[1]) ||
-                (ftype != spec.type))
-              goto nomatch;
-          } else {
-            if (rt11MatchRegex(&reg, fname1, fname2, ftype) == 0)
-              goto nomatch;
-          }
+            dir[RT11_DI_STATUS] = htole16(entry->status);
+            dir[RT11_DI_FNAME1] = htole16(entry->name[0]);
+            dir[RT11_DI_FNAME2] = htole16(entry->name[1]);
+            dir[RT11_DI_FTYPE] = htole16(entry->type);
+            dir[RT11_DI_LENGTH] = htole16(entry->length);
+            dir[RT11_DI_JOB_CHN] = 0;
+            dir[RT11_DI_CREATE] = htole16(entry->creation);
 
-          rt11DisplayDir(&data->buf[off], SWISSET('f'));
+            rt11DisplayDir(dir, SWISSET('f'));
+          }
         }
-
-      nomatch:
-        off += entrysz;
       }
-
-      dsseg = le16toh(data->buf[RT11_DH_NEXT]);
-    } while (dsseg != 0);
-
-    if ((spec.flags & (RT11_WC_NAME | RT11_WC_TYPE)) != 0)
-      regfree(&reg);
+      dsseg = seg->next;
+    } while ((dsseg != 0) && (dsseg <= RT11_DS_MAX) && (++count < RT11_DS_MAX));
   }
 }
-
+
 /*++
  *      r t 1 1 O p e n F i l e R
  *
@@ -2375,6 +2605,47 @@ static off_t rt11FileSize(
   return le16toh(file->length) * RT11_BLOCKSIZE;
 }
 
+/*++
+ *      r t 1 1 F i l e E x t e n t
+ *
+ *  Return the location of an open file within the container. RT-11 files
+ *  are always contiguous, so this is possible unless the device is sector
+ *  interleaved (RX01/RX02).
+ *
+ * Inputs:
+ *
+ *      filep           - pointer to open file descriptor
+ *      block           - pointer to return the starting block #
+ *      size            - pointer to return the size of the file in bytes
+ *
+ * Outputs:
+ *
+ *      The starting block # and file size are returned if possible
+ *
+ * Returns:
+ *
+ *      1 if the file is a single extent in the container, 0 otherwise
+ *
+ --*/
+static int rt11FileExtent(
+  void *filep,
+  off_t *block,
+  off_t *size
+)
+{
+  struct rt11OpenFile *file = filep;
+  struct RT11data *data = &file->mount->rt11data;
+  unsigned int start = le16toh(file->start), length = le16toh(file->length);
+
+  if ((data->sectorsz != 0) || (length == 0) ||
+      ((start + length - 1) > data->maxblk[file->unit]))
+    return 0;
+
+  *block = (file->unit << 16) | start;
+  *size = (off_t)length * RT11_BLOCKSIZE;
+  return 1;
+}
+
 /*++
  *      r t 1 1 D e l e t e F i l e
  *
@@ -2579,6 +2850,7 @@ struct FSdef rt11FS = {
   rt11ReadFile,
   rt11WriteFile,
   rt11DeleteFile,
+  rt11FileExtent,
   NULL,                                 /* No tape support functions */
   NULL,
   NULL,
@@ -195,6 +195,8 @@
 #define RT11_RL01SZ     10240           /* Blocks on an RL01 drive */
 #define RT11_RL02SZ     20480           /* Blocks on an RL02 drive */
 #define RT11_RX0xSZ     2002            /* Sectors on an RX01/RX02 */
+#define RT11_RX0xLSECT  (RT11_RX0xSZ - RT11_RX0xNSECT)
+                                        /* Logical sectors (no track 0) */
 
 #define RT11_HB_BBLOCK  0000            /* Bad block replacement tbl */
 #define RT11_HB_RESTORE 0102            /* INIT/RESTORE data area */
@@ -287,6 +289,66 @@ struct rt11OpenFile {
   uint16_t              start;          /* Starting block # */
 };
 
+/*
+ * Compiled wild card file specification. The name and type patterns are
+ * held as RAD50 character codes (0 - 39) with '*' and '%' represented by
+ * codes outside that range, so they can be matched against directory
+ * entries without converting the entries to ASCII.
+ */
+struct rt11Pattern {
+  uint8_t               flags;          /* Wild card indicators */
+  uint16_t              name[2];        /* File name (RAD50) */
+  uint16_t              type;           /* File type (RAD50) */
+  uint8_t               nlen;           /* Length of name pattern */
+  uint8_t               tlen;           /* Length of type pattern */
+  uint8_t               npat[6];        /* Name pattern */
+  uint8_t               tpat[3];        /* Type pattern */
+};
+#define RT11_PAT_STAR   0100            /* Match 0 or more characters */
+#define RT11_PAT_ANY    0101            /* Match a single character */
+
+/*
+ * In-memory index of the directory of a partition. Each directory segment
+ * has a copy of its entries, in directory order, along with the starting
+ * block # and segment offset of each entry. Non-empty entries are also
+ * hashed on their RAD50 name and type. A segment is re-indexed each time
+ * it is written back to disk so the index always matches the directory.
+ */
+#define RT11_IX_ENTRIES ((RT11_DS_DISPACE / RT11_DI_SIZE) + 1)
+                                        /* Max entries/segment */
+#define RT11_IX_HASHSZ  1024            /* Hash table size (power of 2) */
+
+struct rt11IndexEntry {
+  uint16_t              status;         /* File status */
+  uint16_t              name[2];        /* File name */
+  uint16_t              type;           /* File type */
+  uint16_t              length;         /* File length */
+  uint16_t              creation;       /* Creation date */
+  uint16_t              start;          /* Starting block # */
+  uint16_t              offset;         /* Directory offset */
+  uint16_t              hnext;          /* Next entry on hash chain */
+};
+
+struct rt11IndexSegment {
+  uint16_t              next;           /* Next logical segment # */
+  uint16_t              count;          /* # of entries in segment */
+  struct rt11IndexEntry entry[RT11_IX_ENTRIES];
+};
+
+struct rt11Index {
+  uint16_t              hash[RT11_IX_HASHSZ];
+                                        /* Hash chain heads */
+  struct rt11IndexSegment segment[RT11_DS_MAX];
+};
+
+/*
+ * Hash chain links are entry ids; segment index * RT11_IX_ENTRIES + entry
+ * index + 1. A value of 0 terminates the chain.
+ */
+#define RT11_IX_ID(s, e)        ((((s) - 1) * RT11_IX_ENTRIES) + (e) + 1)
+#define RT11_IX_SEG(id)         ((((id) - 1) / RT11_IX_ENTRIES) + 1)
+#define RT11_IX_ENT(id)         (((id) - 1) % RT11_IX_ENTRIES)
+
 /*
  * RT-11 specific data area.
  */
@@ -298,6 +360,7 @@ struct RT11data {
   uint16_t              valid[16];      /* Valid partitions */
   uint16_t              maxblk[256];    /* Max block address */
   uint16_t              first[256];     /* First directory block */
+  struct rt11Index      *index[256];    /* Directory index */
   uint16_t              buf[512];       /* Disk buffer - enough for a */
                                         /*   directory segment */
 };
@@ -706,7 +706,7 @@ int check_branch(
 /* write_globals writes out the GSD prior to the second assembly pass */
 
 void write_globals(
-    FILE *obj)
+    OBJ_FILE *obj)
 {
     GSD             gsd;
     SYMBOL         *sym;
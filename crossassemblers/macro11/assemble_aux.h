@@ -82,7 +82,7 @@ unsigned        get_register(
     EX_TREE *expr);
 
 void            write_globals(
-    FILE *obj);
+    OBJ_FILE *obj);
 void            migrate_implicit(
     void);
 
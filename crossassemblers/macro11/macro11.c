@@ -53,6 +53,12 @@ DAMAGE.
 #include "object.h"
 #include "symbols.h"
 
+#if defined(unix) || defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
 #define stricmp strcasecmp
 
 
@@ -123,6 +129,7 @@ static void print_help(
     printf("          [-ysl <num>] [-yus] \n");
     printf("          [-m <file>] [-p <directory>] [-x]\n");
     printf("          <inputfile> [<inputfile> ...]\n");
+    printf("  macro11 [<options>] [-j <num>] -- <module group> [-- <module group> ...]\n");
     printf("\n");
     printf("Arguments:\n");
     printf("<inputfile>  MACRO11 source file(s) to assemble\n");
@@ -131,6 +138,8 @@ static void print_help(
     printf("-d  disable <option> (see below)\n");
     printf("-e  enable <option> (see below)\n");
     printf("-h  print this help\n");
+    printf("-j  number of module groups to assemble at once\n");
+    printf("    (default: the number of processors).\n");
     printf("-l  gives the listing file name (.LST)\n");
     printf("    -l - enables listing to stdout.\n");
     printf("-m  load RT-11 compatible macro library from which\n");
@@ -153,6 +162,12 @@ static void print_help(
     printf("-yus Syntax extension: allow underscore \"_\" in symbols.\n");
     printf("-yl1 Extension: list the first pass too, not only the second.\n");
     printf("\n");
+    printf("Module groups:\n");
+    printf("Each module group after a -- is assembled on its own, as if by a\n");
+    printf("separate macro11 command with those arguments, in parallel with\n");
+    printf("the others.  Options given before the first -- apply to all of\n");
+    printf("the groups; -o, -l and the source files go in the groups.\n");
+    printf("\n");
     printf("Options for -e and -d are:\n");
     printf("AMA (off) - absolute addressing (versus PC-relative)\n");
     printf("            See .ENABL AMA, .DSABL AMA\n");
@@ -170,27 +185,27 @@ void usage(char *message) {
     exit(EXIT_FAILURE);
 }
 
-int main(
-    int argc,
-    char *argv[])
-{
-    char           *fnames[32];
-    int             nr_files = 0;
-    FILE           *obj = NULL;
-    TEXT_RLD        tr;
-    char           *objname = NULL;
-    char           *lstname = NULL;
-    int             arg;
-    int             i;
-    STACK           stack;
-    int             errcount;
+/* What to assemble, as given on the command line */
 
-    if (argc <= 1) {
-        print_help();
-        exit(EXIT_FAILURE);
-    }
+static char    *fnames[32];
+static int      nr_files = 0;
+static char    *objname = NULL;
+static char    *lstname = NULL;
+static int      nr_jobs = 0;            /* -j: assemblies at once */
+static int      symbols_added = 0;      /* Permanent symbols are in */
+
+/* parse_args processes the command line from argv[arg] up to its end
+   or to a "--" which separates module groups.  group is set while the
+   arguments of one module group are being processed.  Returns the
+   index of the "--", or argc. */
 
-    for (arg = 1; arg < argc; arg++)
+static int parse_args(
+    int argc,
+    char *argv[],
+    int arg,
+    int group)
+{
+    for (; arg < argc && strcmp(argv[arg], "--") != 0; arg++)
         if (*argv[arg] == '-') {
             char           *cp;
 
@@ -287,9 +302,20 @@ int main(
                 }
                 for (m = 0; m < nr_mlbs; m++)
                     mlb_extract(mlbs[m]);
-                return EXIT_SUCCESS;
+                exit(EXIT_SUCCESS);
+            } else if (!stricmp(cp, "j")) {
+                /* Number of module groups to assemble at once */
+                char           *endp;
+
+                if (arg >= argc-1 || (nr_jobs = strtol(argv[arg+1], &endp, 10), *endp) || nr_jobs < 1) {
+                    usage("-j must be followed by the number of assemblies to run at once\n");
+                }
+                arg++;
             } else if (!stricmp(cp, "ysl")) {
                 /* set symbol_len */
+                if (group) {
+                    usage("-ysl must be given before the first --\n");
+                }
                 if (arg >= argc-1) {
                     usage("-s must be followed by a number\n");
                 } else {
@@ -316,16 +342,64 @@ int main(
                 exit(EXIT_FAILURE);
             }
         } else {
+            if (nr_files >= (int) (sizeof(fnames) / sizeof(fnames[0]))) {
+                usage("Too many input files\n");
+            }
             fnames[nr_files++] = argv[arg];
         }
 
-    if (objname) {
-        obj = fopen(objname, "wb");
-        if (obj == NULL)
+    return arg;
+}
+
+/* save_object writes out an object file which was kept in memory.
+   Returns 0 if it could not be written. */
+
+static int save_object(
+    OBJ_FILE *obj,
+    char *name)
+{
+    size_t          length;
+    char           *data = obj_memory(obj, &length);
+    FILE           *fp = fopen(name, "wb");
+    int             ok;
+
+    if (fp == NULL)
+        return 0;
+    ok = fwrite(data, 1, length, fp) == length;
+    if (fclose(fp) != 0)
+        ok = 0;
+    return ok;
+}
+
+/* assemble_files runs both passes over the input files and writes
+   the object and listing files.  If in_memory is set the object is
+   collected in memory and only written out once the assembly is
+   complete, so an assembly which is abandoned part way (as a module
+   group may be, while others carry on) leaves no empty or partial
+   object file behind. */
+
+static int assemble_files(
+    int in_memory)
+{
+    OBJ_FILE       *obj = NULL;
+    TEXT_RLD        tr;
+    int             i;
+    STACK           stack;
+    int             errcount;
+
+    if (objname && in_memory) {
+        obj = obj_open_memory();
+    } else if (objname) {
+        obj = obj_open(objname);
+        if (obj == NULL) {
+            fprintf(stderr, "Unable to create object file %s\n", objname);
             return EXIT_FAILURE;
+        }
     }
 
-    add_symbols(&blank_section);
+    if (!symbols_added)
+        add_symbols(&blank_section);
+    symbols_added = 1;
 
     text_init(&tr, NULL, 0);
 
@@ -374,9 +448,11 @@ int main(
     migrate_implicit();                /* Migrate the implicit globals */
     write_globals(obj);                /* Write the global symbol dictionary */
 
-#if 0
-    sym_hist(&symbol_st, "symbol_st"); /* Draw a symbol table histogram */
-#endif
+    if (enabl_debug > 1 && lstfile) {
+        sym_hist(&system_st, "system_st");      /* Show how well the hash */
+        sym_hist(&symbol_st, "symbol_st");      /* is doing */
+        sym_hist(&macro_st, "macro_st");
+    }
 
 
     text_init(&tr, obj, 0);
@@ -422,10 +498,18 @@ int main(
     for (i = 0; i < nr_mlbs; i++)
         mlb_close(mlbs[i]);
 
+    free_file_caches();
+
     write_endmod(obj);
 
-    if (obj != NULL)
-        fclose(obj);
+    if (obj != NULL && in_memory && !save_object(obj, objname)) {
+        report(NULL, "Error writing object file %s\n", objname);
+        errcount++;
+    }
+    if (!obj_close(obj)) {
+        report(NULL, "Error writing object file %s\n", objname);
+        errcount++;
+    }
 
     if (errcount > 0)
         fprintf(stderr, "%d Errors\n", errcount);
@@ -439,3 +523,124 @@ int main(
 
     return errcount > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
+
+#if defined(unix) || defined(__unix__) || defined(__APPLE__)
+
+/* wait_group waits for one module group to finish.  Returns nonzero
+   if it failed. */
+
+static int wait_group(
+    void)
+{
+    int             status;
+
+    if (wait(&status) < 0)
+        return 1;
+    return !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS;
+}
+
+/* assemble_groups assembles each module group given after a "--" in
+   a process of its own, up to nr_jobs of them at once.  The options
+   before the first "--" have already been processed, the permanent
+   symbols entered and the macro libraries read, so all of that is
+   shared with every assembly rather than done again by each one. */
+
+static int assemble_groups(
+    int argc,
+    char *argv[],
+    int arg)
+{
+    int             running = 0;
+    int             failed = 0;
+    int             jobs = nr_jobs;
+
+    if (jobs == 0) {
+        long            ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+        jobs = ncpu > 0 ? (int) ncpu : 1;
+    }
+
+    while (arg < argc) {
+        int             start = arg + 1;
+        int             end;
+        pid_t           pid;
+
+        for (end = start; end < argc && strcmp(argv[end], "--") != 0; end++) ;
+        arg = end;
+        if (end == start)
+            continue;                  /* Empty group */
+
+        if (running >= jobs) {
+            failed |= wait_group();
+            running--;
+        }
+
+        fflush(stdout);
+        fflush(stderr);
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            failed = 1;
+            break;
+        }
+        if (pid == 0) {
+            parse_args(end, argv, start, 1);
+            exit(assemble_files(1));
+        }
+        running++;
+    }
+
+    while (running > 0) {
+        failed |= wait_group();
+        running--;
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#else
+
+static int assemble_groups(
+    int argc,
+    char *argv[],
+    int arg)
+{
+    (void) argc;
+    (void) argv;
+    (void) arg;
+    usage("Module groups (--) are not supported on this system\n");
+    return EXIT_FAILURE;
+}
+
+#endif
+
+int main(
+    int argc,
+    char *argv[])
+{
+    int             arg;
+    int             i;
+
+    if (argc <= 1) {
+        print_help();
+        exit(EXIT_FAILURE);
+    }
+
+    arg = parse_args(argc, argv, 1, 0);
+    if (arg >= argc)
+        return assemble_files(0);
+
+    /* Module groups: what came before the first "--" is common to all
+       of them. */
+    if (nr_files > 0 || objname != NULL || lstname != NULL) {
+        usage("Give -o, -l and source files after a --, in a module group\n");
+    }
+
+    add_symbols(&blank_section);
+    symbols_added = 1;
+
+    for (i = 0; i < nr_mlbs; i++)
+        mlb_preload(mlbs[i]);
+
+    return assemble_groups(argc, argv, arg);
+}
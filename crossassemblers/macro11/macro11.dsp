@@ -109,6 +109,10 @@ SOURCE=.\mlb.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\mlb2.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\object.c
 # End Source File
 # Begin Source File
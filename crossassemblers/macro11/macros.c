@@ -256,8 +256,10 @@ MACRO          *defmacro(
 
         if (mac->text != NULL)         /* Discard old macro body */
             buffer_free(mac->text);
+        free_subst(mac->subst);
 
         mac->text = gb;
+        mac->subst = compile_subst(gb, mac->args);
     }
 
     return mac;
@@ -317,20 +319,46 @@ static ARG     *find_arg(
     return NULL;
 }
 
-/* subst_args - given a BUFFER and a list of args, generate a new
-   BUFFER with argument replacement having taken place. */
+/* arg_index - the position of the first argument with the given name
+   in an argument list, or -1 */
 
-BUFFER         *subst_args(
+static int arg_index(
+    ARG *arg,
+    char *name)
+{
+    int             index;
+
+    for (index = 0; arg != NULL; arg = arg->next, index++)
+        if (strcmp(arg->label, name) == 0)
+            return index;
+
+    return -1;
+}
+
+/* compile_subst - look through a macro body once for the places where
+   the arguments are to be substituted, so that each expansion only has
+   to splice the argument values into the text. */
+
+SUBST          *compile_subst(
     BUFFER *text,
     ARG *args)
 {
     char           *in;
     char           *begin;
-    BUFFER         *gb;
     char           *label;
     ARG            *arg;
-
-    gb = new_buffer();
+    SUBST          *subst;
+    int             maxsegs;
+    int             index;
+
+    subst = memcheck(malloc(sizeof(SUBST)));
+    subst->text = buffer_clone(text);  /* A reference, not a copy */
+    subst->nargs = 0;
+    for (arg = args; arg != NULL; arg = arg->next)
+        subst->nargs++;
+    subst->nsegs = 0;
+    maxsegs = 8;
+    subst->segs = memcheck(malloc(maxsegs * sizeof(SUBST_SEG)));
 
     /* Blindly look for argument symbols in the input. */
     /* Don't worry about quotes or comments. */
@@ -341,7 +369,7 @@ BUFFER         *subst_args(
         if (issym((unsigned char)*in)) {
             label = get_symbol(in, &next, NULL);
             if (label) {
-                if ((arg = find_arg(args, label))) {
+                if ((index = arg_index(args, label)) >= 0) {
                     /* An apostrophe may appear before or after the symbol. */
                     /* In either case, remove it from the expansion. */
 
@@ -350,12 +378,17 @@ BUFFER         *subst_args(
                     if (*next == '\'')
                         next++;
 
-                    /* Copy prior characters */
-                    buffer_appendn(gb, begin, (int) (in - begin));
-                    /* Copy replacement string */
-                    buffer_append_line(gb, arg->value);
-                    in = begin = next;
-                    --in;              /* prepare for subsequent increment */
+                    if (subst->nsegs + 1 >= maxsegs) {
+                        maxsegs *= 2;
+                        subst->segs = memcheck(realloc(subst->segs, maxsegs * sizeof(SUBST_SEG)));
+                    }
+
+                    /* Prior characters, then the replacement string */
+                    subst->segs[subst->nsegs].offset = (int) (begin - text->buffer);
+                    subst->segs[subst->nsegs].length = (int) (in - begin);
+                    subst->segs[subst->nsegs].arg = index;
+                    subst->nsegs++;
+                    begin = next;
                 }
                 free(label);
                 in = next;
@@ -365,10 +398,78 @@ BUFFER         *subst_args(
             in++;
     }
 
-    /* Append the rest of the text */
-    buffer_appendn(gb, begin, (int) (in - begin));
+    /* The rest of the text */
+    subst->segs[subst->nsegs].offset = (int) (begin - text->buffer);
+    subst->segs[subst->nsegs].length = (int) (in - begin);
+    subst->segs[subst->nsegs].arg = -1;
+    subst->nsegs++;
+
+    return subst;
+}
+
+/* expand_subst - generate a new BUFFER from a compiled body, given
+   the values of its arguments in the order of the formal argument
+   list.  As with buffer_append_line, a value stops after a newline. */
+
+BUFFER         *expand_subst(
+    SUBST *subst,
+    char **values)
+{
+    BUFFER         *gb;
+    SUBST_SEG      *seg;
+    int            *lengths;
+    int             length;
+    int             i;
+    char           *out;
+
+    lengths = memcheck(malloc((subst->nargs + 1) * sizeof(int)));
+    for (i = 0; i < subst->nargs; i++) {
+        char           *nl;
+
+        if (values[i] == NULL)
+            lengths[i] = 0;
+        else if ((nl = strchr(values[i], '\n')) != NULL)
+            lengths[i] = (int) (nl - values[i] + 1);
+        else
+            lengths[i] = (int) strlen(values[i]);
+    }
+
+    length = 0;
+    for (seg = subst->segs; seg < subst->segs + subst->nsegs; seg++) {
+        length += seg->length;
+        if (seg->arg >= 0)
+            length += lengths[seg->arg];
+    }
+
+    /* Size the buffer once, then splice the pieces together */
+    gb = new_buffer();
+    buffer_resize(gb, length + 1);
+    out = gb->buffer;
+    for (seg = subst->segs; seg < subst->segs + subst->nsegs; seg++) {
+        memcpy(out, subst->text->buffer + seg->offset, seg->length);
+        out += seg->length;
+        if (seg->arg >= 0) {
+            memcpy(out, values[seg->arg], lengths[seg->arg]);
+            out += lengths[seg->arg];
+        }
+    }
+    *out = 0;
+    gb->length = length;
+
+    free(lengths);
+    return gb;
+}
 
-    return gb;                         /* Done. */
+/* free_subst - release a compiled body */
+
+void free_subst(
+    SUBST *subst)
+{
+    if (subst) {
+        buffer_free(subst->text);
+        free(subst->segs);
+        free(subst);
+    }
 }
 
 /* eval_str - the language allows an argument expression to be given
@@ -544,7 +645,16 @@ STREAM         *expandmacro(
         last_locsym = locsym;
     }
 
-    buf = subst_args(mac->text, args);
+    /* Values in the order of the formal arguments */  {
+        char          **values = memcheck(malloc((mac->subst->nargs + 1) * sizeof(char *)));
+        int             i;
+
+        for (i = 0, macarg = mac->args; macarg != NULL; macarg = macarg->next, i++)
+            values[i] = find_arg(args, macarg->label)->value;
+
+        buf = expand_subst(mac->subst, values);
+        free(values);
+    }
 
     str = new_macro_stream(refstr, buf, mac, nargs);
 
@@ -587,6 +697,7 @@ MACRO          *new_macro(
     mac->sym.value = 0;
     mac->args = NULL;
     mac->text = NULL;
+    mac->subst = NULL;
 
     return mac;
 }
@@ -596,8 +707,9 @@ void free_macro(
     MACRO *mac)
 {
     if (mac->text) {
-        free(mac->text);
+        buffer_free(mac->text);
     }
+    free_subst(mac->subst);
     free_args(mac->args);
     free_sym(&mac->sym);
 }
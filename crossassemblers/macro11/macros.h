@@ -16,6 +16,23 @@ typedef struct arg {
     char           *value;      /* Default or active substitution */
 } ARG;
 
+/* A SUBST is a macro, .IRP or .IRPC body with the places where
+   arguments are substituted found in advance.  The body is a list of
+   pieces of literal text, each followed by the value of an argument. */
+
+typedef struct subst_seg {
+    int             offset;     /* Offset of literal text in the body */
+    int             length;     /* Length of literal text */
+    int             arg;        /* Index of argument which follows, or -1 */
+} SUBST_SEG;
+
+typedef struct subst {
+    BUFFER         *text;       /* The body text, shared with its owner */
+    int             nargs;      /* Number of formal arguments */
+    int             nsegs;      /* Number of segments */
+    SUBST_SEG      *segs;       /* The segments */
+} SUBST;
+
 /* A MACRO is a superstructure surrounding a SYMBOL. */
 
 typedef struct macro {
@@ -23,6 +40,7 @@ typedef struct macro {
                                    name */
     ARG            *args;       /* The argument list */
     BUFFER         *text;       /* The macro text */
+    SUBST          *subst;      /* The text, compiled for substitution */
 } MACRO;
 
 typedef struct macro_stream {
@@ -63,9 +81,14 @@ char           *getstring_macarg(
     STREAM *refstr,
     char *cp,
     char **endp);
-BUFFER         *subst_args(
+SUBST          *compile_subst(
     BUFFER *text,
     ARG *args);
+BUFFER         *expand_subst(
+    SUBST *subst,
+    char **values);
+void            free_subst(
+    SUBST *subst);
 
 
 
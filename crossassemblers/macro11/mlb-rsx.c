@@ -295,6 +295,7 @@ MLB            *mlb_open(
 
             mlb->directory[j].label = memcheck(strdup(radname));
             mlb->directory[j].position = BYTEPOS(ent);
+            mlb->directory[j].text = NULL;
 //            fprintf(stderr, "entry %d: \"%s\" bytepos=%d\n", j, mlb->directory[j].label, mlb->directory[j].position);
             mlb->directory[j].length = -1;
         }
@@ -314,9 +315,11 @@ void mlb_close(
         int             i;
 
         if (mlb->directory) {
-            for (i = 0; i < mlb->nentries; i++)
+            for (i = 0; i < mlb->nentries; i++) {
                 if (mlb->directory[i].label)
                     free(mlb->directory[i].label);
+                buffer_free(mlb->directory[i].text);
+            }
             free(mlb->directory);
         }
         if (mlb->fp)
@@ -351,6 +354,11 @@ BUFFER         *mlb_entry(
         return NULL;
     }
 
+    if (ent->text != NULL)
+        return buffer_clone(ent->text);     /* Already read */
+    if (mlb->fp == NULL)
+        return NULL;                   /* Preloaded, and not there */
+
     fseek(mlb->fp, ent->position, SEEK_SET);
 //    fprintf(stderr, "mlb_entry: %s at position %ld\n", name, (long)ent->position);
 
@@ -450,6 +458,7 @@ BUFFER         *mlb_entry(
     /* Now resize that buffer to the length actually read. */
     buffer_resize(buf, (int) (bp - buf->buffer));
 
+    ent->text = buffer_clone(buf);     /* Keep it for next time */
     return buf;
 }
 
@@ -188,6 +188,7 @@ MLB            *mlb_open(
 
             mlb->directory[j].label = memcheck(strdup(radname));
             mlb->directory[j].position = BYTEPOS(ent);
+            mlb->directory[j].text = NULL;
             if (j < i - 1) {
                 mlb->directory[j].length = BYTEPOS(ent + entsize) - BYTEPOS(ent);
             } else {
@@ -222,9 +223,11 @@ void mlb_close(
         int             i;
 
         if (mlb->directory) {
-            for (i = 0; i < mlb->nentries; i++)
+            for (i = 0; i < mlb->nentries; i++) {
                 if (mlb->directory[i].label)
                     free(mlb->directory[i].label);
+                buffer_free(mlb->directory[i].text);
+            }
             free(mlb->directory);
         }
         if (mlb->fp)
@@ -256,6 +259,11 @@ BUFFER         *mlb_entry(
     if (i >= mlb->nentries)
         return NULL;
 
+    if (ent->text != NULL)
+        return buffer_clone(ent->text);     /* Already read */
+    if (mlb->fp == NULL)
+        return NULL;                   /* Preloaded, and not there */
+
     /* Allocate a buffer to hold the text */
     buf = new_buffer();
     buffer_resize(buf, ent->length + 1);        /* Make it large enough */
@@ -275,6 +283,7 @@ BUFFER         *mlb_entry(
     /* Now resize that buffer to the length actually read. */
     buffer_resize(buf, (int) (bp - buf->buffer));
 
+    ent->text = buffer_clone(buf);     /* Keep it for next time */
     return buf;
 }
 
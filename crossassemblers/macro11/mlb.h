@@ -44,6 +44,7 @@ typedef struct mlbent {
     char           *label;
     unsigned long   position;
     int             length;
+    BUFFER         *text;       /* Entry contents, once they've been read */
 } MLBENT;
 
 typedef struct mlb {
@@ -63,5 +64,7 @@ extern void     mlb_close(
     MLB *mlb);
 extern void     mlb_extract(
     MLB *mlb);
+extern void     mlb_preload(
+    MLB *mlb);
 
 #endif /* MLB_H */
@@ -0,0 +1,28 @@
+/* Macro library routines that don't depend on the library format.
+   They use only mlb_entry and the directory in MLB, so they work the
+   same with the RSX-11 (mlb-rsx.c) and RT-11 (mlb.c) readers. */
+
+#include <stdio.h>
+
+#include "stream2.h"
+
+#include "mlb.h"
+
+/* mlb_preload reads every entry of a macro library into memory and
+   closes the file.  The entries can then be shared by assemblies
+   running in separate processes, which would otherwise fight over
+   the position of the one open file. */
+
+void mlb_preload(
+    MLB *mlb)
+{
+    int             i;
+
+    for (i = 0; i < mlb->nentries; i++)
+        buffer_free(mlb_entry(mlb, mlb->directory[i].label));
+
+    if (mlb->fp) {
+        fclose(mlb->fp);
+        mlb->fp = NULL;
+    }
+}
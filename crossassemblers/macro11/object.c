@@ -46,6 +46,81 @@ DAMAGE.
 
 #include "rad50.h"
 #include "object.h"
+#include "util.h"
+
+/* obj_flush - write out the records held so far */
+
+static int obj_flush(
+    OBJ_FILE *obj)
+{
+    if (obj->fp != NULL && obj->length > 0) {
+        if (!obj->error && fwrite(obj->buf, 1, obj->length, obj->fp) != obj->length)
+            obj->error = 1;
+        obj->length = 0;
+    }
+    return !obj->error;
+}
+
+/* obj_open - create an object file */
+
+OBJ_FILE       *obj_open(
+    char *name)
+{
+    OBJ_FILE       *obj;
+    FILE           *fp = fopen(name, "wb");
+
+    if (fp == NULL)
+        return NULL;
+
+    obj = obj_open_memory();
+    obj->fp = fp;
+    return obj;
+}
+
+/* obj_open_memory - create an object "file" which is kept in memory */
+
+OBJ_FILE       *obj_open_memory(
+    void)
+{
+    OBJ_FILE       *obj = memcheck(malloc(sizeof(OBJ_FILE)));
+
+    obj->fp = NULL;
+    obj->size = OBJ_FLUSH + 1024;
+    obj->buf = memcheck(malloc(obj->size));
+    obj->length = 0;
+    obj->error = 0;
+    return obj;
+}
+
+/* obj_memory - the records written to an in-memory object file */
+
+char           *obj_memory(
+    OBJ_FILE *obj,
+    size_t *length)
+{
+    *length = obj->length;
+    return obj->buf;
+}
+
+/* obj_close - write out what's left and close the object file.
+   Returns 0 if anything could not be written. */
+
+int obj_close(
+    OBJ_FILE *obj)
+{
+    int             ok;
+
+    if (obj == NULL)
+        return 1;
+
+    ok = obj_flush(obj);
+    if (obj->fp != NULL && fclose(obj->fp) != 0)
+        ok = 0;
+
+    free(obj->buf);
+    free(obj);
+    return ok;
+}
 
 /*
   writerec writes "formatted binary records."
@@ -56,15 +131,19 @@ DAMAGE.
   The RSX version is similar but subtly different:
   There are no "any number of 0 bytes", nor the "1,0 pair" following it.
   There is no checksum byte, but odd lengths are padded with a 0-byte.
+
+  The record is put together in the OBJ_FILE's buffer, summing the
+  checksum as it goes, and the buffer is written out when it fills.
 */
 
 static int writerec(
-    FILE *fp,
+    OBJ_FILE *obj,
     char *data,
     int len)
 {
     int             chksum;     /* Checksum is negative sum of all
                                    bytes including header and length */
+    unsigned char  *out;
     int             i;
 #if RT11
     unsigned        hdrlen = len + 4;
@@ -72,56 +151,59 @@ static int writerec(
     unsigned        hdrlen = len;
 #endif
 
-    if (fp == NULL)
+    if (obj == NULL)
         return 1;                      /* Silently ignore this attempt to write. */
 
+    if (obj->length + len + 5 > obj->size) {
+        if (obj->fp != NULL)
+            obj_flush(obj);
+        if (obj->length + len + 5 > obj->size) {
+            obj->size = (obj->length + len + 5) * 2;
+            obj->buf = memcheck(realloc(obj->buf, obj->size));
+        }
+    }
+
+    out = (unsigned char *) obj->buf + obj->length;
     chksum = 0;
 #if RT11
-    if (fputc(FBR_LEAD1, fp) == EOF)   /* All recs begin with 1,0 */
-        return 0;
+    *out++ = FBR_LEAD1;                /* All recs begin with 1,0 */
     chksum -= FBR_LEAD1;
-    if (fputc(FBR_LEAD2, fp) == EOF)
-        return 0;
+    *out++ = FBR_LEAD2;
     chksum -= FBR_LEAD2;
 #endif /* RT11 */
 
-    i = hdrlen & 0xff;                 /* length, lsb */
-    chksum -= i;
-    if (fputc(i, fp) == EOF)
-        return 0;
-
-    i = (hdrlen >> 8) & 0xff;          /* length, msb */
-    chksum -= i;
-    if (fputc(i, fp) == EOF)
-        return 0;
-
-    i = fwrite(data, 1, len, fp);
-    if (i < len)
-        return 0;
+    *out = hdrlen & 0xff;              /* length, lsb */
+    chksum -= *out++;
+    *out = (hdrlen >> 8) & 0xff;       /* length, msb */
+    chksum -= *out++;
 
-    while (len > 0) {                  /* All the data bytes */
-        chksum -= *data++ & 0xff;
-        len--;
+    for (i = 0; i < len; i++) {        /* All the data bytes */
+        *out = data[i];
+        chksum -= *out++;
     }
 
-    chksum &= 0xff;
-
 #if RT11
-    fputc(chksum, fp);                 /* Followed by the checksum byte */
+    *out++ = chksum & 0xff;            /* Followed by the checksum byte */
 #else /* RT11 */
+    (void) chksum;
     if (hdrlen & 1) {
-        fputc(0, fp);                  /* Padding to even boundary */
+        *out++ = 0;                    /* Padding to even boundary */
     }
 #endif /* RT11 */
 
-    return 1;                          /* Worked okay. */
+    obj->length = (char *) out - obj->buf;
+
+    if (obj->fp != NULL && obj->length >= OBJ_FLUSH)
+        obj_flush(obj);
+
+    return !obj->error;                /* Worked okay. */
 }
 
 /* gsd_init - prepare a GSD prior to writing GSD records */
 
 void gsd_init(
     GSD * gsd,
-    FILE *fp)
+    OBJ_FILE *fp)
 {
     gsd->fp = fp;
     gsd->buf[0] = OBJ_GSD;             /* GSD records start with 1,0 */
@@ -283,7 +365,7 @@ int gsd_end(
 
 void text_init(
     TEXT_RLD *tr,
-    FILE *fp,
+    OBJ_FILE *fp,
     unsigned addr)
 {
     tr->fp = fp;
@@ -1002,7 +1084,7 @@ int text_complex_commit_displaced(
 /* Write end-of-object-module to file. */
 
 int write_endmod(
-    FILE *fp)
+    OBJ_FILE *fp)
 {
     char            endmod[2] = {
         OBJ_ENDMOD, 0
@@ -121,15 +121,39 @@ DAMAGE.
                                           number" and two bytes offset */
 #define CPLX_CONST 020                 /* Followed by two bytes constant value */
 
+/* An OBJ_FILE collects formatted binary records in memory and writes
+   them out in large pieces.  Without a file it is an in-memory sink:
+   the records just accumulate and can be fetched with obj_memory. */
+
+#define OBJ_FLUSH 65536                /* Write out when this much is held */
+
+typedef struct obj_file {
+    FILE           *fp;         /* The object file, or NULL if in memory */
+    char           *buf;        /* Records not yet written */
+    size_t          length;     /* Bytes in buf */
+    size_t          size;       /* Size of buf */
+    int             error;      /* An output error has happened */
+} OBJ_FILE;
+
+OBJ_FILE       *obj_open(
+    char *name);
+OBJ_FILE       *obj_open_memory(
+    void);
+char           *obj_memory(
+    OBJ_FILE *obj,
+    size_t *length);
+int             obj_close(
+    OBJ_FILE *obj);
+
 typedef struct gsd {
-    FILE           *fp;         /* The file assigned for output */
+    OBJ_FILE       *fp;         /* The file assigned for output */
     char            buf[122];   /* space for 15 GSD entries */
     int             offset;     /* Current buffer for GSD entries */
 } GSD;
 
 void            gsd_init(
     GSD * gsd,
-    FILE *fp);
+    OBJ_FILE *fp);
 int             gsd_flush(
     GSD * gsd);
 int             gsd_mod(
@@ -168,7 +192,7 @@ int             gsd_end(
     GSD * gsd);
 
 typedef struct text_rld {
-    FILE           *fp;         /* The object file, or NULL */
+    OBJ_FILE       *fp;         /* The object file, or NULL */
     char            text[128];  /* text buffer */
     unsigned        txt_addr;   /* The base text address */
     int             txt_offset; /* Current text offset */
@@ -178,7 +202,7 @@ typedef struct text_rld {
 
 void            text_init(
     TEXT_RLD *tr,
-    FILE *fp,
+    OBJ_FILE *fp,
     unsigned addr);
 int             text_flush(
     TEXT_RLD *tr);
@@ -305,6 +329,6 @@ int             text_complex_commit_displaced(
     unsigned word);
 
 int             write_endmod(
-    FILE *fp);
+    OBJ_FILE *fp);
 
 #endif /* OBJECT_J */
@@ -123,9 +123,26 @@ typedef struct irp_stream {
                                    format) */
     int             offset;     /* Current offset into "items" */
     BUFFER         *body;       /* Original body */
+    SUBST          *subst;      /* Body compiled for substitution */
     int             savecond;   /* Saved conditional level */
 } IRP_STREAM;
 
+/* compile_irp - compile an .IRP or .IRPC body once for its single
+   substitution label */
+
+static SUBST   *compile_irp(
+    BUFFER *body,
+    char *label)
+{
+    ARG             arg;
+
+    arg.next = NULL;
+    arg.locsym = 0;
+    arg.label = label;
+    arg.value = NULL;
+    return compile_subst(body, &arg);
+}
+
 /* irp_stream_gets expands the IRP as the stream is read. */
 /* Each time an iteration is exhausted, the next iteration is
    generated. */
@@ -136,7 +153,7 @@ char           *irp_stream_gets(
     IRP_STREAM     *istr = (IRP_STREAM *) str;
     char           *cp;
     BUFFER         *buf;
-    ARG            *arg;
+    char           *value;
 
     for (;;) {
         if ((cp = buffer_stream_gets(str)) != NULL)
@@ -147,18 +164,13 @@ char           *irp_stream_gets(
         if (!*cp)
             return NULL;               /* No more items.  EOF. */
 
-        arg = new_arg();
-        arg->next = NULL;
-        arg->locsym = 0;
-        arg->label = istr->label;
-        arg->value = getstring_macarg(str, cp, &cp);
+        value = getstring_macarg(str, cp, &cp);
         cp = skipdelim(cp);
         istr->offset = (int) (cp - istr->items);
 
-        buf = subst_args(istr->body, arg);
+        buf = expand_subst(istr->subst, &value);
 
-        free(arg->value);
-        free(arg);
+        free(value);
         buffer_stream_set_buffer(&istr->bstr, buf);
         buffer_free(buf);
     }
@@ -174,6 +186,7 @@ void irp_stream_delete(
     pop_cond(istr->savecond);          /* complete unterminated
                                           conditionals */
 
+    free_subst(istr->subst);
     buffer_free(istr->body);
     free(istr->items);
     free(istr->label);
@@ -234,6 +247,7 @@ STREAM         *expand_irp(
     str->bstr.stream.vtbl = &irp_stream_vtbl;
 
     str->body = gb;
+    str->subst = compile_irp(gb, label);
     str->items = items;
     str->offset = 0;
     str->label = label;
@@ -252,6 +266,7 @@ typedef struct irpc_stream {
                                    format) */
     int             offset;     /* Current offset in "items" */
     BUFFER         *body;       /* Original body */
+    SUBST          *subst;      /* Body compiled for substitution */
     int             savecond;   /* conditional stack at invocation */
 } IRPC_STREAM;
 
@@ -264,7 +279,8 @@ char           *irpc_stream_gets(
     IRPC_STREAM    *istr = (IRPC_STREAM *) str;
     char           *cp;
     BUFFER         *buf;
-    ARG            *arg;
+    char            value[2];
+    char           *valp = value;
 
     for (;;) {
         if ((cp = buffer_stream_gets(str)) != NULL)
@@ -275,19 +291,11 @@ char           *irpc_stream_gets(
         if (!*cp)
             return NULL;               /* No more items.  EOF. */
 
-        arg = new_arg();
-        arg->next = NULL;
-        arg->locsym = 0;
-        arg->label = istr->label;
-        arg->value = memcheck(malloc(2));
-        arg->value[0] = *cp++;
-        arg->value[1] = 0;
+        value[0] = *cp++;
+        value[1] = 0;
         istr->offset = (int) (cp - istr->items);
 
-        buf = subst_args(istr->body, arg);
-
-        free(arg->value);
-        free(arg);
+        buf = expand_subst(istr->subst, &valp);
         buffer_stream_set_buffer(&istr->bstr, buf);
         buffer_free(buf);
     }
@@ -302,6 +310,7 @@ void irpc_stream_delete(
 
     pop_cond(istr->savecond);          /* complete unterminated
                                           conditionals */
+    free_subst(istr->subst);
     buffer_free(istr->body);
     free(istr->items);
     free(istr->label);
@@ -361,6 +370,7 @@ STREAM         *expand_irpc(
 
     str->bstr.stream.vtbl = &irpc_stream_vtbl;
     str->body = gb;
+    str->subst = compile_irp(gb, label);
     str->items = items;
     str->offset = 0;
     str->label = label;
@@ -270,40 +270,123 @@ STREAM         *new_buffer_stream(
 
 /* *** FILE_STREAM implementation */
 
-/* Implement STREAM::gets for a file stream */
+static FILE_CACHE *file_caches = NULL;  /* Files read so far */
 
-static char    *file_gets(
-    STREAM *str)
-{
-    int             i,
-                    c;
-    FILE_STREAM    *fstr = (FILE_STREAM *) str;
+/* file_load reads a whole file and splits it into lines the way they
+   are handed to the assembler: a line ends at '\n' or '\f' (or end of
+   file, so there is always a last line, perhaps empty); zeros and
+   carriage returns are dropped; lines are cut short at
+   STREAM_BUFFER_SIZE - 2 characters. */
 
-    if (fstr->fp == NULL)
-        return NULL;
+static FILE_CACHE *file_load(
+    char *filename)
+{
+    FILE           *fp;
+    FILE_CACHE     *cache;
+    char           *raw = NULL;
+    size_t          rawlen = 0,
+                    rawsize = 0,
+                    got,
+                    i;
+    int             nlines,
+                    len;
+    char           *out;
 
-    if (feof(fstr->fp))
+    fp = fopen(filename, "r");
+    if (fp == NULL)
         return NULL;
 
-    /* Read single characters, end of line when '\n' or '\f' hit */
-
-    i = 0;
-    while (c = fgetc(fstr->fp), c != '\n' && c != '\f' && c != EOF) {
+    do {
+        if (rawlen + 65536 > rawsize) {
+            rawsize = rawsize * 2 + 65536;
+            raw = memcheck(realloc(raw, rawsize));
+        }
+        got = fread(raw + rawlen, 1, rawsize - rawlen, fp);
+        rawlen += got;
+    } while (got > 0);
+
+    fclose(fp);
+
+    nlines = 1;
+    for (i = 0; i < rawlen; i++)
+        if (raw[i] == '\n' || raw[i] == '\f')
+            nlines++;
+
+    cache = memcheck(malloc(sizeof(FILE_CACHE)));
+    cache->name = memcheck(strdup(filename));
+    cache->text = memcheck(malloc(rawlen + 2 * nlines));
+    cache->offset = memcheck(malloc(nlines * sizeof(int)));
+    cache->counted = memcheck(malloc(nlines));
+    cache->nlines = nlines;
+
+    out = cache->text;
+    nlines = 0;
+    len = 0;
+    cache->offset[0] = 0;
+    for (i = 0; i <= rawlen; i++) {
+        int             c = (i < rawlen) ? (unsigned char) raw[i] : EOF;
+
+        if (c == '\n' || c == '\f' || c == EOF) {
+            *out++ = '\n';            /* Silently transform formfeeds
+                                          into newlines */
+            *out++ = 0;
+            cache->counted[nlines++] = (c == '\n');
+            if (nlines < cache->nlines)
+                cache->offset[nlines] = (int) (out - cache->text);
+            len = 0;
+            continue;
+        }
         if (c == 0)
             continue;                  /* Don't buffer zeros */
         if (c == '\r')
             continue;                  /* Don't buffer carriage returns either */
-        if (i < STREAM_BUFFER_SIZE - 2)
-            fstr->buffer[i++] = c;
+        if (len < STREAM_BUFFER_SIZE - 2) {
+            *out++ = c;
+            len++;
+        }
     }
 
-    fstr->buffer[i++] = '\n';          /* Silently transform formfeeds
-                                          into newlines */
-    fstr->buffer[i] = 0;
+    free(raw);
+
+    cache->next = file_caches;
+    file_caches = cache;
+    return cache;
+}
+
+/* file_cached finds a file's lines, reading it if this is the first
+   time it has been asked for */
+
+static FILE_CACHE *file_cached(
+    char *filename)
+{
+    FILE_CACHE     *cache;
 
-    if (c == '\n')
+    for (cache = file_caches; cache != NULL; cache = cache->next)
+        if (strcmp(cache->name, filename) == 0)
+            return cache;
+
+    return file_load(filename);
+}
+
+/* Implement STREAM::gets for a file stream */
+
+static char    *file_gets(
+    STREAM *str)
+{
+    FILE_STREAM    *fstr = (FILE_STREAM *) str;
+    int             line = fstr->next;
+
+    if (line >= fstr->cache->nlines)
+        return NULL;
+
+    fstr->next++;
+    if (fstr->cache->counted[line])
         fstr->stream.line++;           /* Count a line */
 
+    /* The caller may change the line (upcase it, for one), so it gets
+       a copy and the cached text stays as it was read. */
+
+    strcpy(fstr->buffer, fstr->cache->text + fstr->cache->offset[line]);
     return fstr->buffer;
 }
 
@@ -314,9 +397,8 @@ void file_destroy(
 {
     FILE_STREAM    *fstr = (FILE_STREAM *) str;
 
-    fclose(fstr->fp);
     free(fstr->buffer);
-    stream_delete(str);
+    stream_delete(str);                /* The lines stay cached */
 }
 
 /* Implement STREAM::rewind for a file stream */
@@ -326,7 +408,7 @@ void file_rewind(
 {
     FILE_STREAM    *fstr = (FILE_STREAM *) str;
 
-    rewind(fstr->fp);
+    fstr->next = 0;
     str->line = 0;
 }
 
@@ -339,24 +421,42 @@ static STREAM_VTBL file_stream_vtbl = {
 STREAM         *new_file_stream(
     char *filename)
 {
-    FILE           *fp;
+    FILE_CACHE     *cache;
     FILE_STREAM    *str;
 
-    fp = fopen(filename, "r");
-    if (fp == NULL)
+    cache = file_cached(filename);
+    if (cache == NULL)
         return NULL;
 
     str = memcheck(malloc(sizeof(FILE_STREAM)));
 
     str->stream.vtbl = &file_stream_vtbl;
     str->stream.name = memcheck(strdup(filename));
+    str->cache = cache;
+    str->next = 0;
     str->buffer = memcheck(malloc(STREAM_BUFFER_SIZE));
-    str->fp = fp;
     str->stream.line = 0;
 
     return &str->stream;
 }
 
+/* free_file_caches discards all cached file contents */
+
+void free_file_caches(
+    void)
+{
+    while (file_caches != NULL) {
+        FILE_CACHE     *next = file_caches->next;
+
+        free(file_caches->name);
+        free(file_caches->text);
+        free(file_caches->offset);
+        free(file_caches->counted);
+        free(file_caches);
+        file_caches = next;
+    }
+}
+
 /* STACK functions */
 
 /* stack_init prepares a stack */
@@ -58,9 +58,24 @@ typedef struct stream {
     struct stream  *next;       /* Next stream in stack */
 } STREAM;
 
+/* A source file is read only once, however many times it is opened
+   (each pass, and each .INCLUDE of it).  Its lines are kept in
+   memory, already in the form the assembler is given them. */
+
+typedef struct file_cache {
+    struct file_cache *next;    /* Next cached file */
+    char           *name;       /* File name as opened */
+    char           *text;       /* The lines, each ending "\n\0" */
+    int             nlines;     /* Number of lines */
+    int            *offset;     /* Offset of each line in "text" */
+    char           *counted;    /* Whether each line ended in a newline
+                                   (and so counts in the line number) */
+} FILE_CACHE;
+
 typedef struct file_stream {
     STREAM          stream;     /* Base class */
-    FILE           *fp;         /* File pointer */
+    FILE_CACHE     *cache;      /* The file's lines */
+    int             next;       /* Index of the next line */
     char           *buffer;     /* Line buffer */
 } FILE_STREAM;
 
@@ -123,6 +138,8 @@ void            buffer_stream_rewind(
 
 STREAM         *new_file_stream(
     char *filename);
+void            free_file_caches(
+    void);
 
 void            stack_init(
     STACK *stack);
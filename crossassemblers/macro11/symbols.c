@@ -33,22 +33,103 @@ SYMBOL_TABLE    implicit_st;    /* The symbols which may be implicit globals */
 
 void list_section(SECTION *sec);
 
-/* hash_name hashes a name into a value from 0-HASH_SIZE */
+/* hash_name hashes a name (32 bit FNV-1a).  Tables use the low bits. */
 
-int hash_name(
+unsigned hash_name(
     char *label)
 {
-    unsigned        accum = 0;
+    unsigned        accum = 2166136261u;
 
-    while (*label)
-        accum = (accum << 1) ^ *label++;
-
-    accum %= HASH_SIZE;
+    while (*label) {
+        accum ^= (unsigned char) *label++;
+        accum *= 16777619u;
+    }
 
     return accum;
 }
 
 
+/* Symbols, and their names, which live for the whole assembly are
+   carved out of large blocks rather than malloc'ed one by one. */
+
+#define ARENA_BLOCK 65536
+
+typedef union arena_align {
+    void           *p;
+    long            l;
+    double          d;
+} ARENA_ALIGN;
+
+static char    *arena_next = NULL;      /* Free space in current block */
+static size_t   arena_left = 0;
+
+static void    *arena_alloc(
+    size_t size)
+{
+    void           *p;
+
+    size = (size + sizeof(ARENA_ALIGN) - 1) / sizeof(ARENA_ALIGN) * sizeof(ARENA_ALIGN);
+    if (size > arena_left) {
+        size_t          block = size > ARENA_BLOCK ? size : ARENA_BLOCK;
+
+        arena_next = memcheck(malloc(block));
+        arena_left = block;
+    }
+    p = arena_next;
+    arena_next += size;
+    arena_left -= size;
+    return p;
+}
+
+/* intern_label returns the one arena copy of a symbol name, so that a
+   name which appears in several tables is only stored once. */
+
+static char   **intern_slot = NULL;    /* Open-addressed set of names */
+static unsigned intern_size = 0;
+static unsigned intern_count = 0;
+
+static char    *intern_label(
+    char *label)
+{
+    unsigned        mask,
+                    i;
+    char           *copy;
+
+    if ((intern_count + 1) * 4 > intern_size * 3) {
+        unsigned        newsize = intern_size ? intern_size * 2 : HASH_MIN * 4;
+        char          **newslot = memcheck(calloc(newsize, sizeof(char *)));
+        unsigned        j;
+
+        for (j = 0; j < intern_size; j++) {
+            if (intern_slot[j] != NULL) {
+                for (i = hash_name(intern_slot[j]) & (newsize - 1); newslot[i] != NULL; i = (i + 1) & (newsize - 1)) ;
+                newslot[i] = intern_slot[j];
+            }
+        }
+        free(intern_slot);
+        intern_slot = newslot;
+        intern_size = newsize;
+    }
+
+    mask = intern_size - 1;
+    for (i = hash_name(label) & mask; intern_slot[i] != NULL; i = (i + 1) & mask)
+        if (strcmp(intern_slot[i], label) == 0)
+            return intern_slot[i];
+
+    copy = arena_alloc(strlen(label) + 1);
+    strcpy(copy, label);
+    intern_slot[i] = copy;
+    intern_count++;
+    return copy;
+}
+
+/* A removed symbol leaves this marker in its slot so that searches
+   for symbols which collided with it carry on past. */
+
+static SYMBOL   removed_sym;
+
+#define SLOT_REMOVED (&removed_sym)
+
 
 /* Diagnostic: symflags returns a char* which gives flags I can use to
    show the context of a symbol. */
@@ -71,21 +152,26 @@ char           *symflags(
 
 
 
-/* Allocate a new symbol.  Does not add it to any symbol table. */
+/* Allocate a new symbol.  Does not add it to any symbol table.  It
+   comes from the arena, so it must never be given to free_sym. */
 
 static SYMBOL  *new_sym(
     char *label)
 {
-    SYMBOL         *sym = memcheck(malloc(sizeof(SYMBOL)));
+    SYMBOL         *sym = arena_alloc(sizeof(SYMBOL));
 
-    sym->label = memcheck(strdup(label));
+    sym->label = intern_label(label);
     sym->section = NULL;
     sym->value = 0;
     sym->flags = 0;
+    sym->next = NULL;
+    sym->prev = NULL;
+    sym->shadow = NULL;
     return sym;
 }
 
-/* Free a symbol. Does not remove it from any symbol table.  */
+/* Free a symbol. Does not remove it from any symbol table.  Only for
+   symbols malloc'ed by their owner (e.g. macros), not from new_sym. */
 
 void free_sym(
     SYMBOL *sym)
@@ -97,23 +183,102 @@ void free_sym(
     free(sym);
 }
 
-/* remove_sym removes a symbol from it's symbol table. */
+/* find_slot returns the slot holding a label, or else the empty slot
+   where it would go. */
+
+static unsigned find_slot(
+    SYMBOL_TABLE *table,
+    char *label,
+    unsigned hash)
+{
+    unsigned        mask = table->size - 1;
+    unsigned        i;
+    SYMBOL         *sym;
+
+    table->lookups++;
+    for (i = hash & mask; (sym = table->slot[i]) != NULL; i = (i + 1) & mask) {
+        table->probes++;
+        if (sym != SLOT_REMOVED && table->hash[i] == hash && strcmp(sym->label, label) == 0)
+            break;
+    }
+
+    return i;
+}
+
+/* grow_table makes room for one more symbol, rehashing into a larger
+   table (and dropping removed slots) when it gets three quarters full */
+
+static void grow_table(
+    SYMBOL_TABLE *table)
+{
+    SYMBOL        **oldslot = table->slot;
+    unsigned       *oldhash = table->hash;
+    unsigned        oldsize = table->size;
+    unsigned        newsize = HASH_MIN;
+    unsigned        i;
+
+    if ((table->used + 1) * 4 <= table->size * 3)
+        return;
+
+    while (newsize < (table->count + 1) * 2)
+        newsize *= 2;
+
+    table->slot = memcheck(calloc(newsize, sizeof(SYMBOL *)));
+    table->hash = memcheck(malloc(newsize * sizeof(unsigned)));
+    table->size = newsize;
+    table->used = table->count;
+
+    for (i = 0; i < oldsize; i++) {
+        if (oldslot[i] != NULL && oldslot[i] != SLOT_REMOVED) {
+            unsigned        j;
+
+            for (j = oldhash[i] & (newsize - 1); table->slot[j] != NULL; j = (j + 1) & (newsize - 1)) ;
+            table->slot[j] = oldslot[i];
+            table->hash[j] = oldhash[i];
+        }
+    }
+
+    free(oldslot);
+    free(oldhash);
+}
+
+/* remove_sym removes a symbol from it's symbol table.  If it had
+   hidden an older symbol of the same name, that one is found again. */
 
 void remove_sym(
     SYMBOL *sym,
     SYMBOL_TABLE *table)
 {
-    SYMBOL        **prevp,
-                   *symp;
-    int             hash;
+    SYMBOL        **shadowp;
+    unsigned        i;
 
-    hash = hash_name(sym->label);
-    prevp = &table->hash[hash];
-    while (symp = *prevp, symp != NULL && symp != sym)
-        prevp = &symp->next;
+    if (table->size == 0)
+        return;
 
-    if (symp)
-        *prevp = sym->next;
+    i = find_slot(table, sym->label, hash_name(sym->label));
+    if (table->slot[i] == NULL)
+        return;                        /* Not in this table */
+
+    for (shadowp = &table->slot[i]; *shadowp != NULL && *shadowp != sym; shadowp = &(*shadowp)->shadow) ;
+    if (*shadowp == NULL)
+        return;
+
+    *shadowp = sym->shadow;
+    if (table->slot[i] == NULL) {
+        table->slot[i] = SLOT_REMOVED;
+        table->count--;
+    }
+
+    if (sym->prev)
+        sym->prev->next = sym->next;
+    else
+        table->first = sym->next;
+    if (sym->next)
+        sym->next->prev = sym->prev;
+    else
+        table->last = sym->prev;
+
+    sym->next = sym->prev = sym->shadow = NULL;
 }
 
 /* lookup_sym finds a symbol in a table */
@@ -122,15 +287,12 @@ SYMBOL         *lookup_sym(
     char *label,
     SYMBOL_TABLE *table)
 {
-    unsigned        hash;
     SYMBOL         *sym;
 
-    hash = hash_name(label);
-
-    sym = table->hash[hash];
-    while (sym && strcmp(sym->label, label) != 0)
-        sym = sym->next;
+    if (table->size == 0)
+        return NULL;
 
+    sym = table->slot[find_slot(table, label, hash_name(label))];
     return sym;
 }
 
@@ -141,41 +303,54 @@ SYMBOL         *next_sym(
     SYMBOL_TABLE *table,
     SYMBOL_ITER *iter)
 {
+    (void) table;
+
     if (iter->current)
         iter->current = iter->current->next;
 
-    while (iter->current == NULL) {
-        if (iter->subscript >= HASH_SIZE)
-            return NULL;               /* No more symbols. */
-        iter->current = table->hash[iter->subscript];
-        iter->subscript++;
-    }
-
-    return iter->current;              /* Got a symbol. */
+    return iter->current;
 }
 
-/* first_sym - returns the first symbol from a symbol table. Symbols
-   are stored in random order. */
+/* first_sym - returns the first symbol from a symbol table.  Symbols
+   come out in the order they were added. */
 
 SYMBOL         *first_sym(
     SYMBOL_TABLE *table,
     SYMBOL_ITER *iter)
 {
-    iter->subscript = 0;
-    iter->current = NULL;
-    return next_sym(table, iter);
+    iter->current = table->first;
+    return iter->current;
 }
 
-/* add_table - add a symbol to a symbol table. */
+/* add_table - add a symbol to a symbol table.  If there is already a
+   symbol by that name, the new one is the one which will be found
+   until it is removed. */
 
 void add_table(
     SYMBOL *sym,
     SYMBOL_TABLE *table)
 {
-    int             hash = hash_name(sym->label);
+    unsigned        hash = hash_name(sym->label);
+    unsigned        i;
 
-    sym->next = table->hash[hash];
-    table->hash[hash] = sym;
+    grow_table(table);
+
+    i = find_slot(table, sym->label, hash);
+    if (table->slot[i] == NULL) {
+        table->used++;
+        table->count++;
+    }
+    sym->shadow = table->slot[i];
+    table->slot[i] = sym;
+    table->hash[i] = hash;
+
+    sym->next = NULL;
+    sym->prev = table->last;
+    if (table->last)
+        table->last->next = sym;
+    else
+        table->first = sym;
+    table->last = sym;
 }
 
 /* add_sym - used throughout to add or update symbols in a symbol
@@ -467,24 +642,37 @@ void add_symbols(
     add_sym(current_section->label, 0, 0, current_section, &section_st);
 }
 
-/* sym_hist is a diagnostic function that prints a histogram of the
-   hash table useage of a symbol table.  I used this to try to tune
-   the hash function for better spread.  It's not used now. */
+/* sym_hist is a diagnostic function that prints how well a symbol
+   table's hash is spreading its symbols: the size and load of the
+   table, a histogram of the distance of each symbol from its home
+   slot, and the average number of slots looked at per lookup. */
 
 void sym_hist(
     SYMBOL_TABLE *st,
     char *name)
 {
-    int             i;
-    SYMBOL         *sym;
-
-    fprintf(lstfile, "Histogram for symbol table %s\n", name);
-    for (i = 0; i < 1023; i++) {
-        fprintf(lstfile, "%4d: ", i);
-        for (sym = st->hash[i]; sym != NULL; sym = sym->next)
-            fputc('#', lstfile);
-        fputc('\n', lstfile);
+    unsigned        hist[9];
+    unsigned        i,
+                    longest = 0;
+
+    memset(hist, 0, sizeof(hist));
+    for (i = 0; i < st->size; i++) {
+        if (st->slot[i] != NULL && st->slot[i] != SLOT_REMOVED) {
+            unsigned        dist = (i - st->hash[i]) & (st->size - 1);
+
+            if (dist > longest)
+                longest = dist;
+            hist[dist < 8 ? dist : 8]++;
+        }
     }
+
+    fprintf(lstfile, "Hash statistics for symbol table %s\n", name);
+    fprintf(lstfile, "  %u symbols in %u slots (%u used), %lu lookups, %.2f probes per lookup\n",
+            st->count, st->size, st->used, st->lookups,
+            st->lookups ? (double) st->probes / st->lookups : 0.0);
+    for (i = 0; i < 9; i++)
+        fprintf(lstfile, "  %s%u from home: %u\n", i < 8 ? "" : ">=", i, hist[i]);
+    fprintf(lstfile, "  longest: %u\n", longest);
 }
 
 static int symbol_compar(
@@ -42,7 +42,11 @@ typedef struct symbol {
                                  * normal symbol table */
 
     SECTION        *section;    /* Section in which this symbol is defined */
-    struct symbol  *next;       /* Next symbol with the same hash value */
+    struct symbol  *next;       /* Next symbol in its table, in the order
+                                   they were added */
+    struct symbol  *prev;       /* Previous symbol in that order */
+    struct symbol  *shadow;     /* Older symbol of the same name, found
+                                   again once this one is removed */
 } SYMBOL;
 
 
@@ -290,16 +294,28 @@ enum operand_codes { OC_MASK = 0xff00,
 
 /* symbol tables */
 
-#define HASH_SIZE 1023
+/* A symbol table is an open-addressed hash table (linear probing)
+   which grows as symbols are added.  An all-zero SYMBOL_TABLE is a
+   valid empty table.  The symbols are also kept on a list in the
+   order they were added, which is the order they are iterated in. */
+
+#define HASH_MIN 64             /* Smallest table allocated */
 
 typedef struct symbol_table {
-    SYMBOL         *hash[HASH_SIZE];
+    SYMBOL        **slot;       /* The hash table proper */
+    unsigned       *hash;       /* Full hash value of each slot's label */
+    unsigned        size;       /* Number of slots, a power of 2 */
+    unsigned        count;      /* Number of symbols in the table */
+    unsigned        used;       /* Slots used, including removed symbols */
+    SYMBOL         *first;      /* Symbols, in the order added */
+    SYMBOL         *last;
+    unsigned long   lookups;    /* Statistics: number of lookups */
+    unsigned long   probes;     /* Statistics: slots examined */
 } SYMBOL_TABLE;
 
 
 /* SYMBOL_ITER is used for iterating thru a symbol table. */
 typedef struct symbol_iter {
-    int             subscript;  /* Current hash subscript */
     SYMBOL         *current;    /* Current symbol */
 } SYMBOL_ITER;
 
@@ -324,7 +340,7 @@ extern SYMBOL_TABLE implicit_st;        /* The symbols which may be implicit glo
 
 #endif
 
-int             hash_name(
+unsigned        hash_name(
     char *label);
 
 SYMBOL         *add_sym(
@@ -357,6 +373,10 @@ void            add_table(
     SYMBOL *sym,
     SYMBOL_TABLE *table);
 
+void            sym_hist(
+    SYMBOL_TABLE *st,
+    char *name);
+
 
 void            add_symbols(
     SECTION *current_section);
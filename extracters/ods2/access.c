@@ -24,10 +24,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <memory.h>
 #include "ssdef.h"
 #include "access.h"
 #include "phyio.h"
+#include "sidecar.h"
 
 
 #define DEBUGx on
@@ -131,6 +133,7 @@ unsigned accesshead(struct VCB *vcb,struct fiddef *fid,
 
 
 unsigned getwindow(struct FCB *fcb,unsigned vbn,unsigned *phyrvn,unsigned *phyblk,unsigned *phylen);
+void readahead_free(void);
 
 /* This routine has bugs and does NOT work properly yet!!!!
    It may be something simple but I haven't had time to look...
@@ -313,6 +316,10 @@ struct CACHE *fcbmanager(struct CACHE *cacheobj)
                     deaccesshead(fcb->headvioc,fcb->head,fcb->modmask);
                     fcb->headvioc = NULL;
                 }
+                if (fcb->dirindex != NULL) {
+                    free(fcb->dirindex);
+                    fcb->dirindex = NULL;
+                }
             }
         }
     } else {
@@ -348,6 +355,9 @@ unsigned accessfile(struct VCB * vcb,struct fiddef * fid,struct FCB **fcbadd,
         fcb->wcb = NULL;
         fcb->headvioc = NULL;
         fcb->vioc = NULL;
+        fcb->seqvbn = ~0u;      /* No get yet: matches no vbn, nor does +1 */
+        fcb->readahead = 0;
+        fcb->dirindex = NULL;
         fcb->cache.objmanager = fcbmanager;
     }
     if (wrtflg) {
@@ -438,10 +448,14 @@ unsigned dismount(struct VCB * vcb)
                 vcbdev->idxfcb->headvioc = NULL;
                 sts = cacheuntouch(&vcbdev->idxfcb->cache,0,0);
                 cachedeltree(&vcb->fcb->cache);
+                sidecar_close(vcbdev->dev);
+                if (vcbdev->dev->vcb == vcb) vcbdev->dev->vcb = NULL;
+                device_done(vcbdev->dev);
             }
             vcbdev++;
         }
         while (vcb->dircache) cachedelete((struct CACHE *) vcb->dircache);
+        readahead_free();
 #ifdef DEBUG
         printf("Post close\n");
         cachedump();
@@ -457,7 +471,7 @@ unsigned dismount(struct VCB * vcb)
 
 unsigned mount(unsigned flags,unsigned devices,char *devnam[],char *label[],struct VCB **retvcb)
 {
-    register unsigned device,sts;
+    register unsigned device,sts = SS$_NOSUCHVOL;
     struct VCB *vcb;
     struct VCBDEV *vcbdev;
     if (sizeof(struct HOME) != 512 || sizeof(struct HEAD) != 512) return SS$_NOTINSTALL;
@@ -497,6 +511,7 @@ unsigned mount(unsigned flags,unsigned devices,char *devnam[],char *label[],stru
                                 sts = SS$_DATACHECK;
                             if (idxboot.fh2$w_checksum != checksum((unsigned short *) &idxboot)) sts = SS$_DATACHECK;
                         }
+                        if ((sts & 1) && (flags & 2)) sts = sidecar_open(vcbdev->dev,&vcbdev->home);
                         vcbdev->idxfcb = NULL;
                         if (sts & 1) {
                             vcb->devices = device + 1;
@@ -515,7 +530,14 @@ unsigned mount(unsigned flags,unsigned devices,char *devnam[],char *label[],stru
                     }
                 }
             }
-            if ((sts & 1) == 0) vcbdev->dev = NULL;
+            if ((sts & 1) == 0) {
+                if (vcbdev->dev != NULL) {
+                    sidecar_discard(vcbdev->dev);
+                    if (vcbdev->dev->vcb == vcb) vcbdev->dev->vcb = NULL;
+                    device_done(vcbdev->dev);
+                }
+                vcbdev->dev = NULL;
+            }
         }
         if (device == 0 && vcbdev->dev == NULL) {
             free(vcb);
@@ -692,6 +714,60 @@ unsigned getwindow(struct FCB * fcb,unsigned vbn,unsigned *phyrvn,unsigned *phyb
 }
 
 
+/* Blocks of the index file and of directories go through the
+   sidecar index when the volume has one */
+
+#define SIDECAR_FILE(fcb) (((fcb)->head->fh2$l_filechar & FH2$M_DIRECTORY) || \
+        ((fcb)->head->fh2$w_fid.fid$w_num == 1 && (fcb)->head->fh2$w_fid.fid$b_nmx == 0))
+
+
+/* accessread: read a run of file blocks into memory - blocks
+   beyond the high water mark are returned as zeroes. This goes
+   straight to the device, one read per extent, so it must not be
+   used on blocks which may be modified in the cache... */
+
+unsigned accessread(struct FCB *fcb,unsigned vbn,unsigned length,char *address)
+{
+    do {
+        if (fcb->highwater > 0 && vbn >= fcb->highwater) {
+            memset(address,0,length * 512);
+            length = 0;
+        } else {
+            register unsigned sts;
+            unsigned rvn,mapblk,maplen;
+            register struct VCBDEV *vcbdev;
+            sts = getwindow(fcb,vbn,&rvn,&mapblk,&maplen);
+            if (sts & 1) {
+                if (maplen > length) maplen = length;
+                if (fcb->highwater > 0 && vbn + maplen > fcb->highwater) {
+                    maplen = fcb->head->fh2$l_highwater - vbn;
+                }
+                if (rvn > fcb->vcb->devices) {
+                    sts = SS$_NOSUCHFILE;
+                } else {
+                    if (rvn < 2) {
+                        vcbdev = fcb->vcb->vcbdev;
+                    } else {
+                        vcbdev = &fcb->vcb->vcbdev[rvn - 1];
+                    }
+                    if (vcbdev->dev == NULL) return SS$_NOSUCHFILE;
+                    if (vcbdev->dev->sidecar != NULL && SIDECAR_FILE(fcb)) {
+                        sts = sidecar_read(vcbdev->dev,mapblk,maplen,address);
+                    } else {
+                        sts = phyio_read(vcbdev->dev->handle,mapblk,maplen * 512,address);
+                    }
+                }
+            }
+            if ((sts & 1) == 0) return sts;
+            length -= maplen;
+            vbn += maplen;
+            address += maplen * 512;
+        }
+    } while (length > 0);
+    return SS$_NORMAL;
+}
+
+
 /* Object manager for VIOC objects:- if the object has been
    modified then we need to flush it to disk before we let
    the cache routines do anything to it...
@@ -702,9 +778,9 @@ struct CACHE *viocmanager(struct CACHE * cacheobj)
 {
     register struct VIOC *vioc = (struct VIOC *) cacheobj;
     if (vioc->cache.status & CACHE_MODIFIED) {
-        register int length = VIOC_CHUNKSIZE;
+        register int length = vioc->blocks;
         register struct FCB *fcb = vioc->fcb;
-        register unsigned base = vioc->cache.keyval;
+        register unsigned base = vioc->base;
         register char *address = (char *) vioc->data;
         printf("\nviocmanager writing vbn %d\n",base);
         cachetouch(&fcb->cache);
@@ -729,6 +805,7 @@ struct CACHE *viocmanager(struct CACHE * cacheobj)
                     }
                     if (vcbdev->dev == NULL) return NULL;
                     sts = phyio_write(vcbdev->dev->handle,mapblk,maplen * 512,address);
+                    if (sts & 1) sidecar_write(vcbdev->dev,mapblk,maplen,address);
                 }
             }
             if ((sts & 1) == 0) {
@@ -750,7 +827,7 @@ struct CACHE *viocmanager(struct CACHE * cacheobj)
 unsigned deaccesschunk(struct VIOC *vioc,unsigned modmask,int reuse)
 {
 #ifdef DEBUG
-    printf("Deaccess chunk %8x\n",vioc->cache.keyval);
+    printf("Deaccess chunk %8x\n",vioc->base);
 #endif
     if ((vioc->wrtmask | modmask) == vioc->wrtmask) {
         vioc->modmask |= modmask;
@@ -762,9 +839,114 @@ unsigned deaccesschunk(struct VIOC *vioc,unsigned modmask,int reuse)
 }
 
 
+/* viocmp: compare a vbn with the range of a chunk... as a by product
+   note the nearest chunks either side so that if a new chunk is
+   required we know how much room there is for it */
 
+struct VIOCGAP {
+    unsigned lo;                /* First vbn after lower chunks */
+    unsigned hi;                /* First vbn of higher chunks */
+};
+
+int viocmp(unsigned keylen,void *key,void *node)
+{
+    register struct VIOC *vioc = (struct VIOC *) node;
+    register struct VIOCGAP *gap = (struct VIOCGAP *) key;
+    if (keylen < vioc->base) {
+        if (vioc->base < gap->hi) gap->hi = vioc->base;
+        return -1;
+    } else {
+        register unsigned end = vioc->base + vioc->blocks;
+        if (keylen < end) return 0;
+        if (end > gap->lo) gap->lo = end;
+        return 1;
+    }
+}
 
-/* accesschunk: return pointer to a 'chunk' of a file ... */
+
+/* viocmake: make a chunk for blocks base to base + blocks - 1
+   (which must not already be in the cache) */
+
+struct VIOC *viocmake(struct FCB *fcb,unsigned base,unsigned blocks)
+{
+    register struct VIOC *vioc;
+    struct VIOCGAP gap;
+    unsigned create = offsetof(struct VIOC,data) + blocks * 512;
+    gap.lo = 0;                 /* viocmp updates these; not used here */
+    gap.hi = 0;
+    vioc = cachesearch((void *) &fcb->vioc,0,base,&gap,viocmp,&create);
+    if (vioc != NULL && create != 0) {
+        cacheuntouch(&vioc->cache,1,0);
+        return NULL;
+    }
+    if (vioc != NULL) {
+        vioc->cache.status |= 0x400;    /* For debugging! */
+        vioc->fcb = fcb;
+        vioc->base = base;
+        vioc->blocks = blocks;
+        vioc->wrtmask = 0;
+        vioc->modmask = 0;
+    }
+    return vioc;
+}
+
+
+/* Buffer for reading ahead of sequential access */
+
+char *readahead_buffer = NULL;
+unsigned readahead_size = 0;
+
+unsigned vioc_readahead = VIOC_READAHEAD;
+
+
+/* readahead_free: give back the read-ahead buffer when a volume
+   is dismounted - it is allocated again when next needed */
+
+void readahead_free(void)
+{
+    free(readahead_buffer);
+    readahead_buffer = NULL;
+    readahead_size = 0;
+}
+
+
+/* viocreadahead: read chunk data together with the blocks that
+   follow it, creating chunks for those as well...  Returns zero if
+   the read could not be done, leaving the caller to fill the chunk */
+
+unsigned viocreadahead(struct FCB *fcb,struct VIOC *vioc,unsigned length)
+{
+    register unsigned base,blocks;
+    if (length > readahead_size) {
+        register char *buffer = realloc(readahead_buffer,length * 512);
+        if (buffer == NULL) return 0;
+        readahead_buffer = buffer;
+        readahead_size = length;
+    }
+    if ((accessread(fcb,vioc->base,length,readahead_buffer) & 1) == 0) return 0;
+    memcpy(vioc->data,readahead_buffer,vioc->blocks * 512);
+    base = vioc->base + vioc->blocks;
+    while (base < vioc->base + length) {
+        register struct VIOC *ravioc;
+        blocks = vioc->base + length - base;
+        if (blocks > VIOC_CHUNKMAX) blocks = VIOC_CHUNKMAX;
+        ravioc = viocmake(fcb,base,blocks);
+        if (ravioc == NULL) break;
+        memcpy(ravioc->data,readahead_buffer + (base - vioc->base) * 512,
+               blocks * 512);
+        cacheuntouch(&ravioc->cache,1,0);
+        base += blocks;
+    }
+    return 1;
+}
+
+
+/* accesschunk: return pointer to a 'chunk' of a file ...
+   Chunks are normally VIOC_CHUNKSIZE blocks, but contiguous files
+   and files being read sequentially get VIOC_CHUNKMAX block chunks,
+   and sequential reads also read ahead by vioc_readahead blocks -
+   but no further than the end of the extent holding the chunk, so
+   that the read-ahead is a single device read. */
 
 unsigned accesschunk(struct FCB *fcb,unsigned vbn,struct VIOC **retvioc,
                      char **retbuff,unsigned *retblocks,unsigned wrtblks,
@@ -774,66 +956,50 @@ unsigned accesschunk(struct FCB *fcb,unsigned vbn,struct VIOC **retvioc,
         First find cache entry...
     */
     register struct VIOC *vioc;
-    unsigned create = sizeof(struct VIOC);
-    register unsigned base = (vbn - 1) / VIOC_CHUNKSIZE * VIOC_CHUNKSIZE + 1;
+    register unsigned base;
+    unsigned create = 0;
+    struct VIOCGAP gap;
 #ifdef DEBUG
-    printf("Access chunk %8x %d (%x)\n",base,vbn,fcb->cache.keyval);
+    printf("Access chunk %d (%x)\n",vbn,fcb->cache.keyval);
 #endif
     if (wrtblks && ((fcb->cache.status & CACHE_WRITE) == 0)) return SS$_WRITLCK;
     if (vbn < 1 || vbn > fcb->hiblock) return SS$_ENDOFFILE;
-    vioc = cachesearch((void *) &fcb->vioc,base,0,NULL,NULL,&create);
-    if (vioc == NULL) return SS$_INSFMEM;
+    gap.lo = 1;
+    gap.hi = fcb->hiblock + 1;
+    vioc = cachesearch((void *) &fcb->vioc,0,vbn,&gap,viocmp,&create);
     /*
-        If not found make one...
+        If not found make one to fit the gap...
     */
-    if (create == 0) {
+    if (vioc == NULL) {
+        register unsigned sts,blocks = VIOC_CHUNKSIZE;
         register unsigned length;
-        register char *address;
-        register unsigned mapbase = base;
-        vioc->cache.status |= 0x400;    /* For debugging! */
-        vioc->fcb = fcb;
-        vioc->wrtmask = 0;
-        vioc->modmask = 0;
-        length = fcb->hiblock - mapbase + 1;
-        if (length > VIOC_CHUNKSIZE) length = VIOC_CHUNKSIZE;
-        address = (char *) vioc->data;
-        do {
-            if (fcb->highwater > 0 && mapbase >= fcb->highwater) {
-                memset(address,0,length * 512);
+        base = (vbn - 1) / VIOC_CHUNKSIZE * VIOC_CHUNKSIZE + 1;
+        if (base < gap.lo) base = gap.lo;
+        if (fcb->readahead || (fcb->head->fh2$l_filechar & FH2$M_CONTIG))
+            blocks = VIOC_CHUNKMAX;
+        if (blocks > gap.hi - base) blocks = gap.hi - base;
+        vioc = viocmake(fcb,base,blocks);
+        if (vioc == NULL) return SS$_INSFMEM;
+        length = fcb->readahead;
+        if (length > gap.hi - base) length = gap.hi - base;
+        if (length > blocks) {
+            unsigned rvn,mapblk,maplen;
+            if ((getwindow(fcb,base,&rvn,&mapblk,&maplen) & 1) == 0) {
                 length = 0;
             } else {
-                register unsigned sts;
-                unsigned rvn,mapblk,maplen;
-                register struct VCBDEV *vcbdev;
-                sts = getwindow(fcb,mapbase,&rvn,&mapblk,&maplen);
-                if (sts & 1) {
-                    if (maplen > length) maplen = length;
-                    if (fcb->highwater > 0 && mapbase + maplen > fcb->highwater) {
-                        maplen = fcb->head->fh2$l_highwater - mapbase;
-                    }
-                    if (rvn > fcb->vcb->devices) {
-                        sts = SS$_NOSUCHFILE;
-                    } else {
-                        if (rvn < 2) {
-                            vcbdev = fcb->vcb->vcbdev;
-                        } else {
-                            vcbdev = &fcb->vcb->vcbdev[rvn - 1];
-                        }
-                        if (vcbdev->dev == NULL) return SS$_NOSUCHFILE;
-                        sts = phyio_read(vcbdev->dev->handle,mapblk,maplen * 512,address);
-                    }
-                }
-                if ((sts & 1) == 0) {
-                    cacheuntouch(&vioc->cache,0,0);
-                    cachefree(&vioc->cache);
-                    return sts;
-                }
-                length -= maplen;
-                mapbase += maplen;
-                address += maplen * 512;
+                if (length > maplen) length = maplen;
             }
-        } while (length > 0);
+        }
+        if (length <= blocks || viocreadahead(fcb,vioc,length) == 0) {
+            sts = accessread(fcb,base,blocks,(char *) vioc->data);
+            if ((sts & 1) == 0) {
+                cacheuntouch(&vioc->cache,0,0);
+                cachefree(&vioc->cache);
+                return sts;
+            }
+        }
     }
+    base = vioc->base;
     if (wrtblks) {
         vioc->cache.status |= CACHE_WRITE;
         vioc->cache.objmanager = viocmanager;
@@ -845,12 +1011,12 @@ unsigned accesschunk(struct FCB *fcb,unsigned vbn,struct VIOC **retvioc,
     *retbuff = vioc->data[vbn - base];
     if (wrtblks || retblocks != NULL || retmodmask != NULL) {
         register unsigned modmask = 0;
-        register unsigned blocks = base + VIOC_CHUNKSIZE - vbn;
+        register unsigned blocks = base + vioc->blocks - vbn;
         if (blocks > fcb->hiblock - vbn) blocks = fcb->hiblock - vbn + 1;
             if (wrtblks) if (blocks > wrtblks) blocks = wrtblks;
         if (retblocks != NULL) *retblocks = blocks;
         if (wrtblks) {
-            modmask = 1 << (vbn - base);
+            modmask = 1u << (vbn - base);
             if (blocks > 1) {
                 while (--blocks > 0) modmask |= modmask << 1;
             }
@@ -24,7 +24,7 @@
 
 typedef unsigned char u_byte;
 typedef unsigned short u_word;
-typedef unsigned int u_long;
+typedef unsigned int u_lword;  /* Not u_long: Unix headers define that */
 
 
 struct UIC {
@@ -59,17 +59,17 @@ struct RECATTR {
 
 
 struct HOME {
-    u_long hm2$l_homelbn;
-    u_long hm2$l_alhomelbn;
-    u_long hm2$l_altidxlbn;
+    u_lword hm2$l_homelbn;
+    u_lword hm2$l_alhomelbn;
+    u_lword hm2$l_altidxlbn;
     u_word hm2$w_struclev;
     u_word hm2$w_cluster;
     u_word hm2$w_homevbn;
     u_word hm2$w_alhomevbn;
     u_word hm2$w_altidxvbn;
     u_word hm2$w_ibmapvbn;
-    u_long hm2$l_ibmaplbn;
-    u_long hm2$l_maxfiles;
+    u_lword hm2$l_ibmaplbn;
+    u_lword hm2$l_maxfiles;
     u_word hm2$w_ibmapsize;
     u_word hm2$w_resfiles;
     u_word hm2$w_devtype;
@@ -77,7 +77,7 @@ struct HOME {
     u_word hm2$w_setcount;
     u_word hm2$w_volchar;
     struct UIC hm2$w_volowner;
-    u_long hm2$l_reserved1;
+    u_lword hm2$l_reserved1;
     u_word hm2$w_protect;
     u_word hm2$w_fileprot;
     u_word hm2$w_reserved2;
@@ -92,7 +92,7 @@ struct HOME {
     u_byte hm2$r_min_class[20];
     u_byte hm2$r_max_class[20];
     u_byte hm2$t_reserved3[320];
-    u_long hm2$l_serialnum;
+    u_lword hm2$l_serialnum;
     char hm2$t_strucname[12];
     char hm2$t_volname[12];
     char hm2$t_ownername[12];
@@ -123,7 +123,7 @@ struct HEAD {
     struct fiddef fh2$w_fid;
     struct fiddef fh2$w_ext_fid;
     struct RECATTR fh2$w_recattr;
-    u_long fh2$l_filechar;
+    u_lword fh2$l_filechar;
     u_word fh2$w_reserved1;
     u_byte fh2$b_map_inuse;
     u_byte fh2$b_acc_mode;
@@ -133,7 +133,7 @@ struct HEAD {
     u_byte fh2$b_journal;
     u_byte fh2$b_ru_active;
     u_word fh2$w_reserved2;
-    u_long fh2$l_highwater;
+    u_lword fh2$l_highwater;
     u_byte fh2$b_reserved3[8];
     u_byte fh2$r_class_prot[20];
     u_byte fh2$r_restofit[402];
@@ -159,14 +159,18 @@ struct WCB {
 };                              /* Window control block */
 
 
-#define VIOC_CHUNKSIZE 4
+#define VIOC_CHUNKSIZE 4        /* Usual chunk size */
+#define VIOC_CHUNKMAX 32        /* Largest chunk (bits in block masks) */
+#define VIOC_READAHEAD 128      /* Default blocks read ahead */
 
 struct VIOC {
     struct CACHE cache;
     struct FCB *fcb;            /* File this chunk is for */
+    unsigned base;              /* First block of chunk */
+    unsigned blocks;            /* Blocks in chunk */
     unsigned wrtmask;           /* Bit mask for writable blocks */
     unsigned modmask;           /* Bit mask for modified blocks */
-    char data[VIOC_CHUNKSIZE][512];     /* Chunk data */
+    char data[VIOC_CHUNKMAX][512];      /* Chunk data (blocks allocated) */
 };                              /* Chunk of a file */
 
 
@@ -180,6 +184,9 @@ struct FCB {
     unsigned modmask;           /* headvioc chunk modmask */
     unsigned hiblock;           /* Highest block mapped */
     unsigned highwater;         /* First high water block */
+    unsigned seqvbn;            /* Last vbn read by sequential get */
+    unsigned readahead;         /* Blocks to read ahead (if sequential) */
+    struct DIRINDEX *dirindex;  /* Directory block index (directories) */
     unsigned char rvn;          /* Initial file relative volume */
 };                              /* File control block */
 
@@ -216,12 +223,14 @@ struct DEV {
     unsigned status;            /* Device physical status */
     unsigned sectors;           /* Device physical sectors */
     unsigned sectorsize;        /* Device physical sectorsize */
+    struct SIDECAR *sidecar;    /* Metadata index (if mounted /INDEX) */
     int devlen;                 /* Length of device name */
     char devnam[1];             /* Device name */
 };                              /* Device information */
 
 
 unsigned device_lookup(unsigned devlen,char *devnam,int create,struct DEV **retdev);
+unsigned device_done(struct DEV *dev);
 
 unsigned dismount(struct VCB *vcb);
 unsigned mount(unsigned flags,unsigned devices,char *devnam[],char *label[],struct VCB **vcb);
@@ -231,6 +240,9 @@ unsigned deaccessfile(struct FCB *fcb);
 unsigned accessfile(struct VCB *vcb,struct fiddef *fid,
                     struct FCB **fcb,unsigned wrtflg);
 
+extern unsigned vioc_readahead;
+
+unsigned accessread(struct FCB *fcb,unsigned vbn,unsigned length,char *address);
 unsigned deaccesschunk(struct VIOC *vioc,unsigned modmask,int reuse);
 unsigned accesschunk(struct FCB *fcb,unsigned vbn,struct VIOC **retvioc,
                      char **retbuff,unsigned *retblocks,unsigned wrtblks,
@@ -11,10 +11,15 @@
 */
 
 /*  Caching seems to have a big impact on performance!!!
-    This version based on number of objects - probably
-    should change it to use space occupied by objects.
-    Currently use vanilla binary trees - could either
-    use hashing or balanced trees for better performance.  */
+    This version limits the cache by the space occupied by
+    unaccessed objects rather than by their number. The limit
+    defaults to CACHELIM bytes and may be changed with
+    cachesetlimit() (the -c option of the mainline).
+    Cache trees are kept balanced (AVL) as file ids and vbns
+    tend to be inserted in order, which turned the original
+    vanilla binary trees into long lists on big volumes.
+    Hashing was not used as some trees (windows) rely on an
+    ordered search to locate the nearest previous entry.  */
 
 /*  The theory is that all cachable objects share a common
     cache pool. Any object with a reference count of zero
@@ -39,44 +44,251 @@
 
 #define DEBUG on
 
-/* Set limits for number of unaccessed cache entries... */
+/* Set limits for space used by unaccessed cache entries... */
 
-#define CACHELIM  64
-#define CACHEGOAL 25
+#define CACHELIM  (1024 * 1024) /* Default limit in bytes */
+#define CACHEGOAL 75            /* Percentage of limit left after purge */
 
 int cachesearches = 0;
+int cachehits = 0;
 int cachecreated = 0;
 int cachedeleted = 0;
+int cacheevicted = 0;
 int cachepeak = 0;
 int cachecount = 0;
 int cachefreecount = 0;
+unsigned long cachebytes = 0;
+unsigned long cachepeakbytes = 0;
+unsigned long cachefreebytes = 0;
+unsigned long cachelimit = CACHELIM;
 
-struct CACHE cachelist = {NULL,NULL,NULL,&cachelist,&cachelist,NULL,0,0,1};
+struct CACHE cachelist = {NULL,NULL,NULL,NULL,&cachelist,&cachelist,NULL,0,0,1,0,0};
+
+void cachepurge(void);
+
+
+/*  Cache objects are carved out of slabs with a free list for each
+    size class, so that objects (file chunks in particular) can come
+    and go without a trip through malloc and free each time. Slabs are
+    kept for reuse. Objects too big for a slab are malloc'ed. */
+
+#define SLABSIZE (64 * 1024)
+#define SLABGRAIN 64            /* Object sizes are rounded up to this */
+#define SLABCLASSES (SLABSIZE / SLABGRAIN / 2)
+
+struct CACHE *slabfree[SLABCLASSES + 1];
+int slabcount = 0;
+
+
+/* cachealloc - allocate memory for a cache object */
+
+static struct CACHE *cachealloc(unsigned length,unsigned *size)
+{
+    register unsigned sizeclass = (length + SLABGRAIN - 1) / SLABGRAIN;
+    register struct CACHE *cacheobj;
+    if (sizeclass > SLABCLASSES) {
+        *size = length;
+        return (struct CACHE *) malloc(length);
+    }
+    *size = sizeclass * SLABGRAIN;
+    if (slabfree[sizeclass] == NULL) {
+        register char *slab = (char *) malloc(SLABSIZE);
+        register unsigned count = SLABSIZE / *size;
+        if (slab == NULL) return NULL;
+        slabcount++;
+        while (count-- > 0) {
+            cacheobj = (struct CACHE *) (slab + count * *size);
+            cacheobj->nxtcache = slabfree[sizeclass];
+            slabfree[sizeclass] = cacheobj;
+        }
+    }
+    cacheobj = slabfree[sizeclass];
+    slabfree[sizeclass] = cacheobj->nxtcache;
+    return cacheobj;
+}
+
+
+/* cacherelease - return memory of a cache object */
+
+static void cacherelease(struct CACHE *cacheobj)
+{
+    register unsigned sizeclass = (cacheobj->size + SLABGRAIN - 1) / SLABGRAIN;
+    if (sizeclass > SLABCLASSES) {
+        free(cacheobj);
+    } else {
+        cacheobj->nxtcache = slabfree[sizeclass];
+        slabfree[sizeclass] = cacheobj;
+    }
+}
 
 
 /* cacheshow - to print cache statistics */
 
 void cacheshow(void)
 {
-    printf("CACHESHOW Searches: %d Created: %d Peak: %d Count: %d Free: %d\n",
-           cachesearches,cachecreated,cachepeak,cachecount,cachefreecount);
+    printf("CACHESHOW Searches: %d Hits: %d (%.1f%%) Created: %d Evicted: %d\n",
+           cachesearches,cachehits,
+           cachesearches ? cachehits * 100.0 / cachesearches : 0.0,
+           cachecreated,cacheevicted);
+    printf("CACHESHOW Peak: %d Count: %d Free: %d\n",
+           cachepeak,cachecount,cachefreecount);
+    printf("CACHESHOW Bytes: %lu Peak: %lu Free: %lu Limit: %lu Slabs: %d\n",
+           cachebytes,cachepeakbytes,cachefreebytes,cachelimit,slabcount);
+}
+
+
+/* cachesetlimit - set space allowed for unaccessed objects */
+
+void cachesetlimit(unsigned long limit)
+{
+    cachelimit = limit;
+    if (cachefreebytes > cachelimit) cachepurge();
 }
 
 
 void cachedump(void)
 {
     register struct CACHE *cacheobj = cachelist.lstcache;
-    printf("%8.8s %8.8s %8.8s %8.8s %8.8s %8.8s %8.8s cachelist\n","Object",
-           "Parent","Left","Right","Value","Status","Count");
+    printf("%8.8s %8.8s %8.8s %8.8s %8.8s %8.8s %8.8s %8.8s cachelist\n","Object",
+           "Parent","Left","Right","Value","Status","Count","Size");
     while (cacheobj != &cachelist) {
-        printf("%8p %8p %8p %8p %8x %8x %8d\n",
+        printf("%8p %8p %8p %8p %8x %8x %8d %8u\n",
                cacheobj,cacheobj->parent,cacheobj->left,cacheobj->right,
-               cacheobj->keyval,cacheobj->status,cacheobj->refcount);
+               cacheobj->keyval,cacheobj->status,cacheobj->refcount,
+               cacheobj->size);
         cacheobj = cacheobj->lstcache;
     }
 }
 
 
+/* cacheheight - height of a cache subtree */
+
+static int cacheheight(struct CACHE *cacheobj)
+{
+    return cacheobj == NULL ? 0 : cacheobj->height;
+}
+
+
+/* cachefixheight - recompute height of an object from its children */
+
+static void cachefixheight(struct CACHE *cacheobj)
+{
+    register int lheight = cacheheight(cacheobj->left);
+    register int rheight = cacheheight(cacheobj->right);
+    cacheobj->height = (lheight > rheight ? lheight : rheight) + 1;
+}
+
+
+/* cachelink - hang an object (or NULL) off a tree link */
+
+static void cachelink(struct CACHE **parent,struct CACHE *up,
+                      struct CACHE *cacheobj)
+{
+    *parent = cacheobj;
+    if (cacheobj != NULL) {
+        cacheobj->parent = parent;
+        cacheobj->up = up;
+    }
+}
+
+
+/* cacherotleft/cacherotright - rotate a subtree to rebalance it */
+
+static void cacherotleft(struct CACHE *cacheobj)
+{
+    register struct CACHE *pivot = cacheobj->right;
+    struct CACHE **parent = cacheobj->parent;
+    struct CACHE *up = cacheobj->up;
+    cachelink(&cacheobj->right,cacheobj,pivot->left);
+    cachelink(&pivot->left,pivot,cacheobj);
+    cachelink(parent,up,pivot);
+    cachefixheight(cacheobj);
+    cachefixheight(pivot);
+}
+
+static void cacherotright(struct CACHE *cacheobj)
+{
+    register struct CACHE *pivot = cacheobj->left;
+    struct CACHE **parent = cacheobj->parent;
+    struct CACHE *up = cacheobj->up;
+    cachelink(&cacheobj->left,cacheobj,pivot->right);
+    cachelink(&pivot->right,pivot,cacheobj);
+    cachelink(parent,up,pivot);
+    cachefixheight(cacheobj);
+    cachefixheight(pivot);
+}
+
+
+/* cachebalance - restore AVL balance from an object up to the root */
+
+static void cachebalance(struct CACHE *cacheobj)
+{
+    while (cacheobj != NULL) {
+        register struct CACHE *up = cacheobj->up;
+        register int balance = cacheheight(cacheobj->left) -
+            cacheheight(cacheobj->right);
+        if (balance > 1) {
+            if (cacheheight(cacheobj->left->left) <
+                cacheheight(cacheobj->left->right))
+                cacherotleft(cacheobj->left);
+            cacherotright(cacheobj);
+        } else {
+            if (balance < -1) {
+                if (cacheheight(cacheobj->right->right) <
+                    cacheheight(cacheobj->right->left))
+                    cacherotright(cacheobj->right);
+                cacherotleft(cacheobj);
+            } else {
+                cachefixheight(cacheobj);
+            }
+        }
+        cacheobj = up;
+    }
+}
+
+
+/* cacheunlink - remove an object from its tree */
+
+static void cacheunlink(struct CACHE *cacheobj)
+{
+    register struct CACHE *start;
+    if (cacheobj->left == NULL || cacheobj->right == NULL) {
+        start = cacheobj->up;
+        cachelink(cacheobj->parent,cacheobj->up,
+                  cacheobj->left != NULL ? cacheobj->left : cacheobj->right);
+    } else {
+        register struct CACHE *succ = cacheobj->right;
+        while (succ->left != NULL) succ = succ->left;
+        if (succ->up == cacheobj) {
+            start = succ;
+        } else {
+            start = succ->up;
+            cachelink(succ->parent,succ->up,succ->right);
+            cachelink(&succ->right,succ,cacheobj->right);
+        }
+        cachelink(&succ->left,succ,cacheobj->left);
+        cachelink(cacheobj->parent,cacheobj->up,succ);
+        succ->height = cacheobj->height;
+    }
+    cachebalance(start);
+}
+
+
+/* cachenext - next object of a tree in order */
+
+static struct CACHE *cachenext(struct CACHE *cacheobj)
+{
+    if (cacheobj->right != NULL) {
+        cacheobj = cacheobj->right;
+        while (cacheobj->left != NULL) cacheobj = cacheobj->left;
+        return cacheobj;
+    }
+    while (cacheobj->up != NULL && cacheobj == cacheobj->up->right)
+        cacheobj = cacheobj->up;
+    return cacheobj->up;
+}
+
+
 /* cacheprint - debugging tool to print out a cache subtree... */
 
 void cacheprint(struct CACHE *cacheobj,int level)
@@ -136,49 +348,15 @@ struct CACHE *cachefree(struct CACHE *cacheobj)
             printf("cachelist No manager to write modified cache\n");
         cacheobj->lstcache->nxtcache = cacheobj->nxtcache;
         cacheobj->nxtcache->lstcache = cacheobj->lstcache;
-        if (cacheobj->parent != NULL) { /* Check if in tree... */
-            if (cacheobj->left == NULL) {
-                if (cacheobj->right == NULL) {
-                    *(cacheobj->parent) = NULL;
-                } else {
-                    cacheobj->right->parent = cacheobj->parent;
-                    *(cacheobj->parent) = cacheobj->right;
-                }
-            } else {
-                if (cacheobj->right == NULL) {
-                    cacheobj->left->parent = cacheobj->parent;
-                    *(cacheobj->parent) = cacheobj->left;
-                } else {
-                    register struct CACHE *leftpath = cacheobj->left;
-                    register struct CACHE *rightpath = cacheobj->right;
-                    while (1) {
-                        if (leftpath->right == NULL) {
-                            leftpath->right = cacheobj->right;
-                            cacheobj->right->parent = &leftpath->right;
-                            cacheobj->left->parent = cacheobj->parent;
-                            *(cacheobj->parent) = cacheobj->left;
-                            break;
-                        } else {
-                            if (rightpath->left == NULL) {
-                                rightpath->left = cacheobj->left;
-                                cacheobj->left->parent = &rightpath->left;
-                                cacheobj->right->parent = cacheobj->parent;
-                                *(cacheobj->parent) = cacheobj->right;
-                                break;
-                            } else {
-                                leftpath = leftpath->right;
-                                rightpath = rightpath->left;
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        if (cacheobj->parent != NULL) cacheunlink(cacheobj);   /* Check if in tree... */
         if (--cachecount < 0) printf("cachelist, cache current too small\n");
         cachefreecount--;
         cachedeleted--;
+        cachebytes -= cacheobj->size;
+        cachefreebytes -= cacheobj->size;
 #ifdef DEBUG
         cacheobj->parent = NULL;
+        cacheobj->up = NULL;
         cacheobj->left = NULL;
         cacheobj->right = NULL;
         cacheobj->nxtcache = NULL;
@@ -187,19 +365,21 @@ struct CACHE *cachefree(struct CACHE *cacheobj)
         cacheobj->keyval = 0;
         cacheobj->status = 0;
         cacheobj->refcount = 0;
+        cacheobj->height = 0;
 #endif
-        free(cacheobj);
+        cacherelease(cacheobj);
         return cacheobj;
     }
 }
 
 
-/* cachepurge - trim size of free list */
+/* cachepurge - trim space used by free list */
 
-void cachepurge()
+void cachepurge(void)
 {
     register struct CACHE *cacheobj = cachelist.lstcache;
-    while (cachefreecount > CACHEGOAL && cacheobj != &cachelist) {
+    register unsigned long goal = cachelimit / 100 * CACHEGOAL;
+    while (cachefreebytes > goal && cacheobj != &cachelist) {
         register struct CACHE *lastobj = cacheobj->lstcache;
 #ifdef DEBUG
         if (cacheobj->lstcache->nxtcache != cacheobj ||
@@ -210,7 +390,9 @@ void cachepurge()
         }
 #endif
         if (cacheobj->refcount == 0) {
-            if (cachefree(cacheobj) != lastobj) cacheobj = lastobj;
+            register struct CACHE *freeobj = cachefree(cacheobj);
+            if (freeobj != NULL) cacheevicted++;
+            if (freeobj != lastobj) cacheobj = lastobj;
         } else {
             cacheobj = lastobj;
         }
@@ -252,14 +434,24 @@ struct CACHE *cachedelete(struct CACHE *cacheobj)
 
 
 
-/* cachedeltree: delete cache subtree */
+/* cachedeltree: delete cache subtree...
+   The tree is rebalanced as objects are deleted so walk it in
+   order from its first to its last object rather than recursively. */
 
 void cachedeltree(struct CACHE *cacheobj)
 {
     if (cacheobj != NULL) {
-        if (cacheobj->left != NULL) cachedeltree(cacheobj->left);
-        if (cacheobj->right != NULL) cachedeltree(cacheobj->right);
-        if (cacheobj->refcount == 0) cachedelete(cacheobj);
+        register struct CACHE *lastobj = cacheobj;
+        while (lastobj->right != NULL) lastobj = lastobj->right;
+        while (cacheobj->left != NULL) cacheobj = cacheobj->left;
+        while (1) {
+            register struct CACHE *nextobj = NULL;
+            register int last = (cacheobj == lastobj);
+            if (!last) nextobj = cachenext(cacheobj);
+            if (cacheobj->refcount == 0) cachedelete(cacheobj);
+            if (last) break;
+            cacheobj = nextobj;
+        }
     }
 }
 
@@ -295,7 +487,9 @@ unsigned cacheuntouch(struct CACHE *cacheobj,unsigned reuse,unsigned modflg)
                 cachelist.lstcache = cacheobj;
             }
             cacheobj->status &= ~CACHE_WRITE;
-            if (++cachefreecount > CACHELIM && freeactive == 0) cachepurge();
+            cachefreecount++;
+            cachefreebytes += cacheobj->size;
+            if (cachefreebytes > cachelimit && freeactive == 0) cachepurge();
         }
     }
     return 1;
@@ -316,6 +510,7 @@ void cachetouch(struct CACHE *cacheobj)
         }
 #endif
         cachefreecount--;
+        cachefreebytes -= cacheobj->size;
     }
     /* Move object to head of list... */
     if (cacheobj != cachelist.nxtcache) {
@@ -351,6 +546,7 @@ void *cachesearch(void **root,unsigned keyval,unsigned keylen,void *key,
             if (cmpfunc != NULL)
                 cmp = (*cmpfunc) (keylen,key,(void *) cacheobj);
             if (cmp == 0) {
+                cachehits++;
                 cachetouch(cacheobj);
                 return cacheobj;
             } else {
@@ -369,15 +565,19 @@ void *cachesearch(void **root,unsigned keyval,unsigned keylen,void *key,
         }
     }
     if (*createsize > sizeof(struct CACHE)) {
-        cacheobj = (struct CACHE *) malloc(*createsize);
+        unsigned size;
+        cacheobj = cachealloc(*createsize,&size);
         if (cacheobj != NULL) {
             cacheobj->parent = parent;
+            cacheobj->up = parentobj;
             cacheobj->left = NULL;
             cacheobj->right = NULL;
             cacheobj->objmanager = NULL;
             cacheobj->keyval = keyval;
             cacheobj->status = 0;
             cacheobj->refcount = 1;
+            cacheobj->height = 1;
+            cacheobj->size = size;
             *parent = cacheobj;
             *createsize = 0;
             cachecreated++;
@@ -386,25 +586,10 @@ void *cachesearch(void **root,unsigned keyval,unsigned keylen,void *key,
             cacheobj->nxtcache = cachelist.nxtcache;
             cachelist.nxtcache->lstcache = cacheobj;
             cachelist.nxtcache = cacheobj;
-            if (parentobj != NULL) {
-                /* Attempt to mix up the tree a little... */
-                if (parentobj->left == NULL) {
-                    *parentobj->parent = cacheobj;
-                    cacheobj->parent = parentobj->parent;
-                    parentobj->parent = &cacheobj->left;
-                    cacheobj->left = parentobj;
-                    parentobj->right = NULL;
-                } else {
-                    if (parentobj->right == NULL) {
-                        *parentobj->parent = cacheobj;
-                        cacheobj->parent = parentobj->parent;
-                        parentobj->parent = &cacheobj->right;
-                        cacheobj->right = parentobj;
-                        parentobj->left = NULL;
-                    }
-                }
-            }
+            cachebalance(parentobj);
             if (cachecount++ >= cachepeak) cachepeak = cachecount;
+            cachebytes += cacheobj->size;
+            if (cachebytes > cachepeakbytes) cachepeakbytes = cachebytes;
         }
     }
     return cacheobj;
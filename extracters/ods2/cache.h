@@ -16,7 +16,8 @@
 #define CACHE_MODIFIED 2
 
 struct CACHE {
-    struct CACHE **parent;
+    struct CACHE **parent;      /* Link pointing to this object */
+    struct CACHE *up;           /* Parent object in tree (NULL at root) */
     struct CACHE *left;
     struct CACHE *right;
     struct CACHE *nxtcache;
@@ -25,9 +26,12 @@ struct CACHE {
     unsigned keyval;
     unsigned status;
     int refcount;
+    int height;                 /* Height of subtree (AVL balance) */
+    unsigned size;              /* Bytes allocated to object */
 };
 
 void cacheshow(void);
+void cachesetlimit(unsigned long limit);
 void cachedump(void);
 void cacheprint(struct CACHE *cacheobj,int level);
 void cacheflush(void);
@@ -13,7 +13,10 @@
 /* Should have mechanism to return actual device name... */
 
 /*  This module is simple enough - it just keeps track of
-    device names and initialization... */
+    device names and initialization... A lookup which creates a
+    device holds a reference to it until device_done is called;
+    other lookups do not. When the last reference goes the device
+    is dropped and its physical I/O handle released. */
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -68,6 +71,8 @@ unsigned device_lookup(unsigned devlen,char *devnam,
             memcpy(dev->devnam,devnam,devsiz);
             memcpy(dev->devnam + devsiz,":",2);
             dev->devlen = devsiz;
+            dev->vcb = NULL;
+            dev->sidecar = NULL;
             sts = phyio_init(devsiz + 1,dev->devnam,&dev->handle,&info);
             if (sts & 1) {
                 dev->status = info.status;
@@ -76,10 +81,29 @@ unsigned device_lookup(unsigned devlen,char *devnam,
             } else {
                 cacheuntouch((struct CACHE *) dev,0,0);
                 cachefree((struct CACHE *) dev);
+                *retdev = NULL;
             }
         } else {
+            if (!create) cacheuntouch((struct CACHE *) dev,0,0);
             sts = 1;
         }
     }
     return sts;
 }
+
+
+/* device_done - give up a reference from device_lookup(create),
+   dropping the device when it was the last one */
+
+unsigned device_done(struct DEV *dev)
+{
+    register unsigned sts = 1;
+    if (dev->cache.refcount == 1) {
+        sts = phyio_done(dev->handle);
+        cacheuntouch((struct CACHE *) dev,0,0);
+        cachefree((struct CACHE *) dev);
+    } else {
+        cacheuntouch((struct CACHE *) dev,0,0);
+    }
+    return sts;
+}
@@ -34,14 +34,15 @@ int directsearches = 0;
 int directdels = 0;
 int directchecks = 0;
 int directmatches = 0;
+int directhits = 0;
 
 
 /* directshow - to print directory statistics */
 
 void directshow(void)
 {
-    printf("DIRECTSHOW Lookups: %d Searches: %d Deletes: %d Checks: %d Matches: %d\n",
-           directlookups,directsearches,directdels,directchecks,directmatches);
+    printf("DIRECTSHOW Lookups: %d Searches: %d Deletes: %d Checks: %d Matches: %d Index hits: %d\n",
+           directlookups,directsearches,directdels,directchecks,directmatches,directhits);
 }
 
 
@@ -199,6 +200,123 @@ int namematch(char *spec,int speclen,char *entry,int entrylen)
 }
 
 
+/* The first name in each directory block is remembered in a
+   per-directory index as blocks are looked at, so that finding the
+   block to start a scan from is mostly a bisection in memory. The
+   index is thrown away whenever the directory is changed... */
+
+#define DIRNAME_MAX 80
+
+struct DIRINDEX {
+    unsigned blocks;            /* Directory blocks indexed */
+    struct DIRBLK {
+        short namelen;          /* First name length (-1 unknown, -2 none) */
+        char name[DIRNAME_MAX]; /* First name in block */
+    } blk[1];
+};
+
+
+/* dirforget - discard the block index of a directory */
+
+void dirforget(struct FCB *fcb)
+{
+    if (fcb->dirindex != NULL) {
+        free(fcb->dirindex);
+        fcb->dirindex = NULL;
+    }
+}
+
+
+/* dirblock - return the index entry for a block, reading the
+   block if we don't know its first name yet */
+
+struct DIRBLK *dirblock(struct FCB *fcb,unsigned blk,unsigned *sts)
+{
+    register struct DIRBLK *db = &fcb->dirindex->blk[blk - 1];
+    if (db->namelen == -1) {
+        struct VIOC *vioc;
+        unsigned modmask;
+        char *buffer;
+        register struct dir$rec *dr;
+        directsearches++;
+        *sts = accesschunk(fcb,blk,&vioc,&buffer,NULL,0,&modmask);
+        if ((*sts & 1) == 0) return NULL;
+        dr = (struct dir$rec *) buffer;
+        if (dr->dir$size > 510 || dr->dir$namecount > DIRNAME_MAX) {
+            db->namelen = -2;
+        } else {
+            db->namelen = dr->dir$namecount;
+            memcpy(db->name,dr->dir$name,db->namelen);
+        }
+        *sts = deaccesschunk(vioc,0,1);
+        if ((*sts & 1) == 0) return NULL;
+    } else {
+        directhits++;
+    }
+    return db;
+}
+
+
+/* dirbefore - see if the first name in a block sorts before a key */
+
+int dirbefore(struct DIRBLK *db,char *key,int keylen)
+{
+    register int i,len = db->namelen;
+    if (len < 0) return 0;
+    if (keylen < len) len = keylen;
+    for (i = 0; i < len; i++) {
+        register int cmp = toupper(db->name[i]) - toupper(key[i]);
+        if (cmp != 0) return cmp < 0;
+    }
+    return db->namelen < keylen;
+}
+
+
+/* dirstart - find the block to start a scan for a name (or name
+   prefix) from: the last block whose first name is before it. A
+   hint block (from a wildcard context) is tried first... */
+
+unsigned dirstart(struct FCB *fcb,unsigned eofblk,unsigned hint,
+                  char *key,int keylen,unsigned *sts)
+{
+    register unsigned lo = 1,hi = eofblk;
+    register struct DIRBLK *db;
+    *sts = SS$_NORMAL;
+    if (eofblk < 2 || keylen < 1) return 1;
+    if (fcb->dirindex == NULL || fcb->dirindex->blocks != eofblk) {
+        register unsigned blk;
+        dirforget(fcb);
+        fcb->dirindex = (struct DIRINDEX *) malloc(sizeof(struct DIRINDEX) +
+                                                   (eofblk - 1) * sizeof(struct DIRBLK));
+        if (fcb->dirindex == NULL) return 1;
+        fcb->dirindex->blocks = eofblk;
+        for (blk = 0; blk < eofblk; blk++) fcb->dirindex->blk[blk].namelen = -1;
+    }
+    if (hint > 1 && hint <= eofblk) {
+        if ((db = dirblock(fcb,hint,sts)) == NULL) return 0;
+        if (dirbefore(db,key,keylen)) {
+            lo = hint;
+            if (hint < eofblk) {
+                if ((db = dirblock(fcb,hint + 1,sts)) == NULL) return 0;
+                if (!dirbefore(db,key,keylen)) hi = hint;
+            }
+        } else {
+            hi = hint - 1;
+        }
+    }
+    while (lo < hi) {
+        register unsigned mid = (lo + hi + 1) / 2;
+        if ((db = dirblock(fcb,mid,sts)) == NULL) return 0;
+        if (dirbefore(db,key,keylen)) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+
 unsigned freesize(char *buffer)
 {
     struct dir$rec *dr = (struct dir$rec *) buffer;
@@ -221,6 +339,7 @@ unsigned insent(struct FCB *fcb,struct VIOC *vioc,unsigned curblk,
                 char *buffer,unsigned eofblk)
 {
     printf("Insert directory entry\n");
+    dirforget(fcb);
     if (freesize(buffer) >= sizeof(struct dir$ent)) {
         char *ne = (char *) de + sizeof(struct dir$ent);
         memcpy(de,ne,512 - (ne - buffer));
@@ -238,6 +357,7 @@ unsigned delent(struct FCB *fcb,struct VIOC *vioc,unsigned curblk,
     unsigned sts = 1;
     unsigned ent;
     directdels++;
+    dirforget(fcb);
     ent = (dr->dir$size - sizeof(struct dir$rec)
            - dr->dir$namecount + 3) / sizeof(struct dir$ent);
     printf("DELENT ent = %d  %d %d\n",ent,curblk,eofblk);
@@ -346,70 +466,17 @@ unsigned searchent(struct FCB * fcb,
     if ((sts & 1) == 0) return sts;
 
 
-    /* Identify starting block...*/
+    /* Identify starting block from the literal part of the name...*/
 
     if (*searchspec == '*' || *searchspec == '%') {
         curblk = 1;
     } else {
-        register unsigned loblk = 1,hiblk = eofblk;
-        if (curblk < 1 || curblk > eofblk) curblk = (eofblk + 1) / 2;
-        while (loblk < hiblk) {
-            register int cmp;
-            register unsigned newblk;
-            register struct dir$rec *dr;
-            directsearches++;
-            sts = accesschunk(fcb,curblk,&vioc,&buffer,NULL,action ? 1 : 0,&modmask);
-            if ((sts & 1) == 0) return sts;
-            dr = (struct dir$rec *) buffer;
-            if (dr->dir$size > 510) {
-                cmp = MAT_GT;
-            } else {
-                cmp = namematch(searchspec,searchlen,dr->dir$name,dr->dir$namecount);
-                if (cmp == MAT_EQ) {
-                    if (wildcard || version < 1 || version > 32767) {
-                        cmp = MAT_NE;   /* no match - want to find start */
-                    } else {
-                        register struct dir$ent *de =
-                            (struct dir$ent *) (dr->dir$name + ((dr->dir$namecount + 1) & ~1));
-                        if (de->dir$version < version) {
-                            cmp = MAT_GT;       /* too far... */
-                        } else {
-                            if (de->dir$version > version) {
-                                cmp = MAT_LT;   /* further ahead... */
-                            }
-                        }
-                    }
-                }
-            }
-#ifdef DEBUG
-            printf("Direct %6.6s %d %6.6s %d (%d<%d<%d)-> %d\n",
-                   searchspec,searchlen,dr->dir$name,dr->dir$namecount,
-                   loblk,curblk,hiblk,cmp);
-#endif
-            switch (cmp) {
-                case MAT_LT:
-                    if (curblk == fib->fib$l_wcc) {
-                        newblk = hiblk = loblk = curblk;
-                    } else {
-                        loblk = curblk;
-                        newblk = (loblk + hiblk + 1) / 2;
-                    }
-                    break;
-                case MAT_GT:
-                case MAT_NE:
-                    newblk = (loblk + curblk) / 2;
-                    hiblk = curblk - 1;
-                    break;
-                default:
-                    newblk = hiblk = loblk = curblk;
-            }
-            if (newblk != curblk) {
-                sts = deaccesschunk(vioc,0,1);
-                if ((sts & 1) == 0) return sts;
-                vioc = NULL;
-                curblk = newblk;
-            }
-        }
+        register int keylen = 0;
+        unsigned startsts;
+        while (keylen < searchlen && searchspec[keylen] != '*' &&
+               searchspec[keylen] != '%') keylen++;
+        curblk = dirstart(fcb,eofblk,curblk,searchspec,keylen,&startsts);
+        if (((sts = startsts) & 1) == 0) return sts;
     }
 
 
@@ -18,18 +18,20 @@
                 ODS2.C          The mainline program
                 PHYVMS.C        Routine to perform physical I/O
                 RMS.C           Routines to handle RMS structures
+                SIDECAR.C       Routines for the persistent metadata index
                 VMSTIME.C       Routines to handle VMS times
 
         On non-VMS platforms PHYVMS.C should be replaced as follows:-
 
                 OS/2            PHYOS2.C
                 Windows 95/NT   PHYNT.C
+                Unix            PHYUNIX.C
 
         For example under OS/2 the program is compiled using the GCC
         compiler with the single command:-
 
                 gcc -fdollars-in-identifiers ods2.c,rms.c,direct.c,
-                      access.c,device.c,cache.c,phyos2.c,vmstime.c
+                      access.c,device.c,cache.c,phyos2.c,sidecar.c,vmstime.c
 */
 
 /*  This version will compile and run using normal VMS I/O by
@@ -53,6 +55,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 #include "descrip.h"
 #include "ssdef.h"
 
@@ -63,6 +71,7 @@ unsigned sys$setddir();
 #else
 #include "rms.h"
 #include "access.h"
+#include "sidecar.h"
 #endif
 
 
@@ -252,25 +261,149 @@ unsigned dir(int argc,char *argv[],int qualc,char *qualv[])
 /* copy: a file copy routine */
 
 #define MAXREC 32767
+#define COPYBUFSIZE (1024 * 1024)       /* Buffer for binary copies */
+
+char *copyquals[] = {"all","binary",NULL};
+
+/* copyname: make an output file name from the output spec by
+   filling in wildcards from the input name */
+
+void copyname(char *name,char *spec,struct NAM *nam)
+{
+    char *out = name,*inp = spec;
+    int dot = 0;
+    while (*inp != '\0') {
+        if (*inp == '*') {
+            inp++;
+            if (dot) {
+                memcpy(out,nam->nam$l_type + 1,nam->nam$b_type - 1);
+                out += nam->nam$b_type - 1;
+            } else {
+                unsigned length = nam->nam$b_name;
+                if (*inp == '\0') length += nam->nam$b_type;
+                memcpy(out,nam->nam$l_name,length);
+                out += length;
+            }
+        } else {
+            if (*inp == '.') {
+                dot = 1;
+            } else {
+                if (strchr(":]\\/",*inp)) dot = 0;
+            }
+            *out++ = *inp++;
+        }
+    }
+    *out++ = '\0';
+}
+
+
+/* copymkdir: create a host directory if it isn't there already */
+
+int copymkdir(char *name)
+{
+#ifdef _WIN32
+    if (_mkdir(name) == 0 || errno == EEXIST) return 1;
+#else
+    if (mkdir(name,0777) == 0 || errno == EEXIST) return 1;
+#endif
+    printf("%%COPY-F-MKDIR, Could not create directory %s\n",name);
+    perror("-COPY-F-ERR ");
+    return 0;
+}
+
+
+/* copytree: make an output file name for COPY/ALL - each file goes
+   into a host directory tree below the output spec which mirrors
+   its VMS directory, creating the directories as we go. Directory
+   files just become directories so for them zero is returned... */
+
+int copytree(char *name,char *spec,struct NAM *nam)
+{
+    char *out = name,*inp = nam->nam$l_dir + 1;
+    int length = nam->nam$b_dir - 2;
+    if (strlen(spec) >= NAM$C_MAXRSS) return 0;
+    strcpy(out,spec);
+    out += strlen(out);
+    if (out > name && strchr(":\\/",out[-1]) == NULL) {
+        *out = '\0';
+        if (!copymkdir(name)) return 0;
+        *out++ = '/';
+    }
+    while (length-- >= 0) {
+        if (length < 0 || *inp == '.') {
+            *out = '\0';
+            if (!copymkdir(name)) return 0;
+            *out++ = '/';
+            inp++;
+        } else {
+            *out++ = *inp++;
+        }
+    }
+    if (nam->nam$b_type == 4 && memcmp(nam->nam$l_type,".DIR",4) == 0) {
+        memcpy(out,nam->nam$l_name,nam->nam$b_name);
+        out[nam->nam$b_name] = '\0';
+        copymkdir(name);
+        return 0;
+    }
+    memcpy(out,nam->nam$l_name,nam->nam$b_name + nam->nam$b_type);
+    out[nam->nam$b_name + nam->nam$b_type] = '\0';
+    return 1;
+}
+
+
+/* copy /ALL copies a whole directory tree: if the input directory
+   isn't already a ... wildcard it is made into one. /BINARY copies
+   the blocks of each file up to its end of file mark without any
+   record processing, using large reads straight from the file
+   extents... */
 
 unsigned copy(int argc,char *argv[],int qualc,char *qualv[])
 {
-    int sts;
+    int sts,options;
     struct NAM nam = cc$rms_nam;
     struct FAB fab = cc$rms_fab;
     char res[NAM$C_MAXRSS + 1],rsa[NAM$C_MAXRSS + 1];
+    char spec[NAM$C_MAXRSS + 4];
+    char *buffer = NULL;
     int filecount = 0;
+    options = checkquals(copyquals,qualc,qualv);
     nam.nam$l_esa = res;
     nam.nam$b_ess = NAM$C_MAXRSS;
     fab.fab$l_nam = &nam;
     fab.fab$l_fna = argv[1];
+    if (options & 1) {
+        char *dir = strchr(argv[1],']');
+        if (dir == NULL) {
+            fab.fab$l_dna = "[*...]*.*;0";
+        } else {
+            fab.fab$l_dna = "*.*;0";
+            if (dir - argv[1] < 3 || memcmp(dir - 3,"...",3) != 0) {
+                if (strlen(argv[1]) > NAM$C_MAXRSS) return SS$_BADPARAM;
+                memcpy(spec,argv[1],dir - argv[1]);
+                strcpy(spec + (dir - argv[1]),"...");
+                strcat(spec,dir);
+                fab.fab$l_fna = spec;
+            }
+        }
+        fab.fab$b_dns = strlen(fab.fab$l_dna);
+    }
     fab.fab$b_fns = strlen(fab.fab$l_fna);
+    if (options & 2) {
+        buffer = malloc(COPYBUFSIZE);
+        if (buffer == NULL) return SS$_INSFMEM;
+    }
     sts = sys$parse(&fab);
     if (sts & 1) {
         nam.nam$l_rsa = rsa;
         nam.nam$b_rss = NAM$C_MAXRSS;
         fab.fab$l_fop = FAB$M_NAM;
         while ((sts = sys$search(&fab)) & 1) {
+            char name[2 * NAM$C_MAXRSS + 2];
+            if (options & 1) {
+                if (!copytree(name,argv[2],&nam)) continue;
+            } else {
+                copyname(name,argv[2],&nam);
+            }
             sts = sys$open(&fab);
             if ((sts & 1) == 0) {
                 printf("%%COPY-F-OPENFAIL, Open error: %d\n",sts);
@@ -280,52 +413,40 @@ unsigned copy(int argc,char *argv[],int qualc,char *qualv[])
                 rab.rab$l_fab = &fab;
                 if ((sts = sys$connect(&rab)) & 1) {
                     FILE *tof;
-                    char name[NAM$C_MAXRSS + 1];
                     unsigned records = 0;
-                    {
-                        char *out = name,*inp = argv[2];
-                        int dot = 0;
-                        while (*inp != '\0') {
-                            if (*inp == '*') {
-                                inp++;
-                                if (dot) {
-                                    memcpy(out,nam.nam$l_type + 1,nam.nam$b_type - 1);
-                                    out += nam.nam$b_type - 1;
-                                } else {
-                                    unsigned length = nam.nam$b_name;
-                                    if (*inp == '\0') length += nam.nam$b_type;
-                                    memcpy(out,nam.nam$l_name,length);
-                                    out += length;
-                                }
-                            } else {
-                                if (*inp == '.') {
-                                    dot = 1;
-                                } else {
-                                    if (strchr(":]\\/",*inp)) dot = 0;
-                                }
-                                *out++ = *inp++;
-                            }
-                        }
-                        *out++ = '\0';
-                    }
-                    tof = fopen(name,"w");
+                    unsigned long bytes = 0;
+                    tof = fopen(name,(options & 2) ? "wb" : "w");
                     if (tof == NULL) {
                         printf("%%COPY-F-OPENOUT, Could not open %s\n",name);
                         perror("-COPY-F-ERR ");
                     } else {
                         char rec[MAXREC + 2];
                         filecount++;
-                        rab.rab$l_ubf = rec;
-                        rab.rab$w_usz = MAXREC;
-                        while ((sts = sys$get(&rab)) & 1) {
-                            unsigned rsz = rab.rab$w_rsz;
-                            if (fab.fab$b_rat & PRINT_ATTR) rec[rsz++] = '\n';
-                            if (fwrite(rec,rsz,1,tof) == 1) {
-                                records++;
-                            } else {
-                                printf("%%COPY-F- fwrite error!!\n");
-                                perror("-COPY-F-ERR ");
-                                break;
+                        if (options & 2) {
+                            rab.rab$l_ubf = buffer;
+                            rab.rab$w_usz = COPYBUFSIZE;
+                            while ((sts = sys$read(&rab)) & 1) {
+                                if (fwrite(buffer,rab.rab$w_rsz,1,tof) == 1) {
+                                    bytes += rab.rab$w_rsz;
+                                } else {
+                                    printf("%%COPY-F- fwrite error!!\n");
+                                    perror("-COPY-F-ERR ");
+                                    break;
+                                }
+                            }
+                        } else {
+                            rab.rab$l_ubf = rec;
+                            rab.rab$w_usz = MAXREC;
+                            while ((sts = sys$get(&rab)) & 1) {
+                                unsigned rsz = rab.rab$w_rsz;
+                                if (fab.fab$b_rat & PRINT_ATTR) rec[rsz++] = '\n';
+                                if (fwrite(rec,rsz,1,tof) == 1) {
+                                    records++;
+                                } else {
+                                    printf("%%COPY-F- fwrite error!!\n");
+                                    perror("-COPY-F-ERR ");
+                                    break;
+                                }
                             }
                         }
                         if (fclose(tof)) {
@@ -336,8 +457,13 @@ unsigned copy(int argc,char *argv[],int qualc,char *qualv[])
                     sys$disconnect(&rab);
                     if (sts == RMS$_EOF) {
                         rsa[nam.nam$b_rsl] = '\0';
-                        printf("%%COPY-S-COPIED, %s copied to %s (%d record%s)\n",
-                               rsa,name,records,(records == 1 ? "" : "s"));
+                        if (options & 2) {
+                            printf("%%COPY-S-COPIED, %s copied to %s (%lu byte%s)\n",
+                                   rsa,name,bytes,(bytes == 1 ? "" : "s"));
+                        } else {
+                            printf("%%COPY-S-COPIED, %s copied to %s (%d record%s)\n",
+                                   rsa,name,records,(records == 1 ? "" : "s"));
+                        }
                         sts = 1;
                     }
                 }
@@ -346,6 +472,7 @@ unsigned copy(int argc,char *argv[],int qualc,char *qualv[])
         }
         if (sts == RMS$_NMF) sts = 1;
     }
+    if (buffer != NULL) free(buffer);
     if (sts & 1) {
         if (filecount > 0) printf("%%COPY-S-NEWFILES, %d file%s created\n",
                                   filecount,(filecount == 1 ? "" : "s"));
@@ -441,28 +568,139 @@ unsigned typ(int argc,char *argv[],int qualc,char *qualv[])
 
 
 
-/* search: a simple file search routine */
+/* search: a simple file search routine - the search argument is
+   a list of strings separated by commas, any of which may match,
+   ignoring case. Each file is first scanned a buffer of blocks at a
+   time without looking at records at all, and only a file where a
+   string turns up is then read by record to find the matching ones.
+   /COUNT reports the number of matching records in each file and
+   /FILES-ONLY just the names of the files containing a match... */
+
+#define SEARCHMAX 16            /* Most strings to look for */
+#define SEARCHBUF (64 * 1024)   /* Block scan buffer size */
+
+char *searquals[] = {"count","files-only",NULL};
+
+struct SEARCHPAT {
+    int count;                  /* Number of strings */
+    int minlen;                 /* Length of shortest string */
+    int maxlen;                 /* Length of longest string */
+    unsigned char *str[SEARCHMAX];      /* Strings in lower case */
+    int len[SEARCHMAX];         /* String lengths */
+    unsigned shift[256];        /* Horspool shift for each character */
+    unsigned char fold[256];    /* Lower case of each character */
+};
+
+
+/* searchcompile: split the search argument into strings and build
+   a Horspool shift table over the shortest string length */
+
+int searchcompile(register struct SEARCHPAT *pat,char *strings)
+{
+    register int i,j;
+    char *str = strings;
+    for (i = 0; i < 256; i++) pat->fold[i] = tolower(i);
+    pat->count = pat->minlen = pat->maxlen = 0;
+    while (str != NULL) {
+        char *next = strchr(str,',');
+        if (next != NULL) *next++ = '\0';
+        if (*str != '\0') {
+            register int len = strlen(str);
+            if (pat->count >= SEARCHMAX) return 0;
+            for (j = 0; j < len; j++) str[j] = pat->fold[(unsigned char) str[j]];
+            pat->str[pat->count] = (unsigned char *) str;
+            pat->len[pat->count++] = len;
+            if (pat->minlen == 0 || len < pat->minlen) pat->minlen = len;
+            if (len > pat->maxlen) pat->maxlen = len;
+        }
+        str = next;
+    }
+    if (pat->count < 1) return 0;
+    for (i = 0; i < 256; i++) pat->shift[i] = pat->minlen;
+    for (i = 0; i < pat->count; i++) {
+        for (j = 0; j < pat->minlen - 1; j++) {
+            register unsigned ch = pat->str[i][j];
+            if (pat->shift[ch] > (unsigned) (pat->minlen - 1 - j)) {
+                pat->shift[ch] = pat->shift[toupper(ch)] = pat->minlen - 1 - j;
+            }
+        }
+    }
+    return 1;
+}
+
+
+/* searchscan: look for any of the strings in a buffer - the window
+   of the shortest string length is moved along by the shift for
+   its last character until a string matches at its start */
+
+int searchscan(register struct SEARCHPAT *pat,unsigned char *buffer,unsigned length)
+{
+    register unsigned char *end = buffer + length;
+    register unsigned char *win = buffer + pat->minlen - 1;
+    register unsigned char *fold = pat->fold;
+    while (win < end) {
+        register unsigned char *start = win - (pat->minlen - 1);
+        register int i;
+        for (i = 0; i < pat->count; i++) {
+            register unsigned char *str = pat->str[i];
+            if (str[pat->minlen - 1] == fold[*win] && pat->len[i] <= end - start) {
+                register int j = 0;
+                while (j < pat->len[i] && fold[start[j]] == str[j]) j++;
+                if (j >= pat->len[i]) return 1;
+            }
+        }
+        win += pat->shift[*win];
+    }
+    return 0;
+}
+
+
+/* searchblocks: scan the blocks of an open file for the strings -
+   the tail of each buffer is kept so that strings which span two
+   reads are found. If the blocks can't be read we return one so
+   that the record scan will report the problem... */
+
+int searchblocks(struct SEARCHPAT *pat,struct FAB *fab,char *buffer)
+{
+    register unsigned sts,keep = 0;
+    int found = 0;
+    struct RAB rab = cc$rms_rab;
+    rab.rab$l_fab = fab;
+    if (((sts = sys$connect(&rab)) & 1) == 0) return 1;
+    rab.rab$w_usz = SEARCHBUF;
+    do {
+        register unsigned length;
+        rab.rab$l_ubf = buffer + keep;
+        if (((sts = sys$read(&rab)) & 1) == 0) break;
+        length = keep + rab.rab$w_rsz;
+        found = searchscan(pat,(unsigned char *) buffer,length);
+        keep = pat->maxlen - 1;
+        if (keep > length) keep = length;
+        memmove(buffer,buffer + length - keep,keep);
+    } while (!found);
+    sys$disconnect(&rab);
+    return found || (sts != RMS$_EOF);
+}
+
 
 unsigned search(int argc,char *argv[],int qualc,char *qualv[])
 {
     int sts = 0;
     int filecount = 0;
     int findcount = 0;
+    int options;
     char res[NAM$C_MAXRSS + 1],rsa[NAM$C_MAXRSS + 1];
     struct NAM nam = cc$rms_nam;
     struct FAB fab = cc$rms_fab;
-    register char *searstr = argv[2];
-    register char firstch = tolower(*searstr++);
-    register char *searend = searstr + strlen(searstr);
-    {
-        char *str = searstr;
-        while (str < searend) {
-            *str = tolower(*str);
-            str++;
-        }
+    struct SEARCHPAT pat;
+    char *buffer;
+    options = checkquals(searquals,qualc,qualv);
+    if (!searchcompile(&pat,argv[2])) {
+        printf("%%SEARCH-F-BADSTR, Need between 1 and %d search strings\n",SEARCHMAX);
+        return SS$_BADPARAM;
     }
-    nam = cc$rms_nam;
-    fab = cc$rms_fab;
+    buffer = malloc(SEARCHBUF + pat.maxlen);
+    if (buffer == NULL) return SS$_INSFMEM;
     nam.nam$l_esa = res;
     nam.nam$b_ess = NAM$C_MAXRSS;
     fab.fab$l_nam = &nam;
@@ -480,44 +718,39 @@ unsigned search(int argc,char *argv[],int qualc,char *qualv[])
             if ((sts & 1) == 0) {
                 printf("%%SEARCH-F-OPENFAIL, Open error: %d\n",sts);
             } else {
-                struct RAB rab = cc$rms_rab;
-                rab.rab$l_fab = &fab;
-                if ((sts = sys$connect(&rab)) & 1) {
-                    int printname = 1;
-                    char rec[MAXREC + 2];
-                    filecount++;
-                    rab.rab$l_ubf = rec;
-                    rab.rab$w_usz = MAXREC;
-                    while ((sts = sys$get(&rab)) & 1) {
-                        register char *strng = rec;
-                        register char *strngend = strng + (rab.rab$w_rsz - (searend - searstr));
-                        while (strng < strngend) {
-                            register char ch = *strng++;
-                            if (ch == firstch || (ch >= 'A' && ch <= 'Z' && ch + 32 == firstch)) {
-                                register char *str = strng;
-                                register char *cmp = searstr;
-                                while (cmp < searend) {
-                                    register char ch2 = *str++;
-                                    ch = *cmp;
-                                    if (ch2 != ch && (ch2 < 'A' || ch2 > 'Z' || ch2 + 32 != ch)) break;
-                                    cmp++;
+                filecount++;
+                rsa[nam.nam$b_rsl] = '\0';
+                if (searchblocks(&pat,&fab,buffer)) {
+                    struct RAB rab = cc$rms_rab;
+                    rab.rab$l_fab = &fab;
+                    if ((sts = sys$connect(&rab)) & 1) {
+                        unsigned matches = 0;
+                        char rec[MAXREC + 2];
+                        rab.rab$l_ubf = rec;
+                        rab.rab$w_usz = MAXREC;
+                        while ((sts = sys$get(&rab)) & 1) {
+                            if (searchscan(&pat,(unsigned char *) rec,rab.rab$w_rsz)) {
+                                findcount++;
+                                if (options & 2) {
+                                    printf("%s\n",rsa);
+                                    break;
+                                }
+                                if (matches++ == 0 && (options & 1) == 0) {
+                                    printf("\n******************************\n%s\n\n",rsa);
                                 }
-                                if (cmp >= searend) {
-                                    findcount++;
+                                if ((options & 1) == 0) {
                                     rec[rab.rab$w_rsz] = '\0';
-                                    if (printname) {
-                                        rsa[nam.nam$b_rsl] = '\0';
-                                        printf("\n******************************\n%s\n\n",rsa);
-                                        printname = 0;
-                                    }
                                     fputs(rec,stdout);
                                     if (fab.fab$b_rat & PRINT_ATTR) fputc('\n',stdout);
-                                    break;
                                 }
                             }
                         }
+                        if ((options & 1) && matches > 0) {
+                            printf("%s  %u record%s\n",rsa,matches,(matches == 1 ? "" : "s"));
+                        }
+                        sys$disconnect(&rab);
+                        if (sts == RMS$_EOF || (options & 2)) sts = 1;
                     }
-                    sys$disconnect(&rab);
                 }
                 if (sts == SS$_NOTINSTALL) {
                     printf("%%SEARCH-W-NOIMPLEM, file operation not implemented\n");
@@ -528,6 +761,7 @@ unsigned search(int argc,char *argv[],int qualc,char *qualv[])
         }
         if (sts == RMS$_NMF || sts == RMS$_FNF) sts = 1;
     }
+    free(buffer);
     if (sts & 1) {
         if (filecount < 1) {
             printf("%%SEARCH-W-NOFILES, no files found\n");
@@ -660,7 +894,7 @@ unsigned dodismount(int argc,char *argv[],int qualc,char *qualv[])
     return sts;
 }
 
-char *mouquals[] = {"write",NULL};
+char *mouquals[] = {"write","index",NULL};
 
 unsigned domount(int argc,char *argv[],int qualc,char *qualv[])
 {
@@ -715,6 +949,7 @@ unsigned statis(int argc,char *argv[],int qualc,char *qualv[])
     printf("Statistics:-\n");
     directshow();
     cacheshow();
+    sidecar_show();
     phyio_show();
     return 1;
 }
@@ -742,8 +977,10 @@ unsigned help(int argc,char *argv[],int qualc,char *qualv[])
     printf("  set_default type\n");
     printf(" Example:-\n    $ mount e:\n");
     printf("    $ search e:[vms$common.decc*...]*.h rms$_wld\n");
+    printf("    $ search/files-only e:[sysexe]*.exe sys$qio,sys$qiow\n");
     printf("    $ set default e:[sys0.sysmgr]\n");
     printf("    $ copy *.com;-1 c:\\*.*\n");
+    printf("    $ copy/all/binary e:[users] c:\\users\n");
     printf("    $ directory/file/size/date [-.sys*...].%%\n");
     printf("    $ exit\n");
     return 1;
@@ -761,7 +998,7 @@ struct CMDSET {
     unsigned int maxquals;
 } cmdset[] = {
     {
-        "copy",copy,3,3,3,0
+        "copy",copy,3,3,3,2
 },
     {
         "delete",del,3,2,2,0
@@ -782,7 +1019,7 @@ struct CMDSET {
         "show",show,2,2,2,0
 },
     {
-        "search",search,3,3,3,0
+        "search",search,3,3,3,2
 },
     {
         "set",set,3,2,3,0
@@ -885,12 +1122,37 @@ int cmdsplit(char *str)
 int main(int argc,char *argv[])
 {
     char str[2048];
+#ifndef VMSIO
+    int i;
+    for (i = 1; i < argc; i++) {
+        char *end;
+        unsigned long value;
+        if ((strcmp(argv[i],"-c") != 0 && strcmp(argv[i],"-r") != 0) ||
+            i + 1 >= argc) break;
+        value = strtoul(argv[i + 1],&end,10);
+        if (*end != '\0' || end == argv[i + 1]) break;
+        if (argv[i][1] == 'c') {
+            cachesetlimit(value * 1024);
+        } else {
+            vioc_readahead = value;
+        }
+        i++;
+    }
+    if (i < argc) {
+        printf("Usage: %s [-c cache-kbytes] [-r readahead-blocks]\n",argv[0]);
+        return 1;
+    }
+#endif
     str[sizeof(str)-1] = 0;
     printf(" ODS2 v1.2\n");
     while (1) {
         printf("$> ");
         if (fgets(str, sizeof(str)-1, stdin) == NULL) break;
+            str[strcspn(str,"\r\n")] = '\0';
             if (strlen(str)) if ((cmdsplit(str) & 1) == 0) break;
     }
+#ifndef VMSIO
+    sidecar_closeall();
+#endif
     return 1;
 }
@@ -27,6 +27,8 @@
                           device referred to by the handle.
             phyio_write() will write a number of bytes out to a 512 byte block
                           address on a device.
+            phyio_done()  to release a handle when its device is no
+                          longer needed, so it can be used again.
 
 */
 
@@ -42,3 +44,4 @@ void phyio_show(void);
 unsigned phyio_init(int devlen,char *devnam,unsigned *handle,struct phyio_info *info);
 unsigned phyio_read(unsigned handle,unsigned block,unsigned length,char *buffer);
 unsigned phyio_write(unsigned handle,unsigned block,unsigned length,char *buffer);
+unsigned phyio_done(unsigned handle);
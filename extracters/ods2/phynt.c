@@ -428,6 +428,18 @@ unsigned phyio_init(int devlen,char *devnam,unsigned *chanptr,struct phyio_info
 }
 
 
+/* Release a device when it is no longer wanted... */
+
+unsigned phyio_done(unsigned chan)
+{
+    if (chan >= chan_count) return SS$_IVCHAN;
+    VirtualFree(chantab[chan].IoBuffer,0,MEM_RELEASE);
+    chantab[chan].IoBuffer = NULL;
+    CloseHandle(chantab[chan].handle);
+    return 1;
+}
+
+
 
 
 /* Read a physical sector... */
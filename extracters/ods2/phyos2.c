@@ -129,6 +129,14 @@ unsigned phyio_init(int devlen,char *devnam,unsigned *hand,struct phyio_info *in
 }
 
 
+unsigned phyio_done(unsigned hand)
+{
+    if (hand >= hand_count) return SS$_IVCHAN;
+    DosClose(handle[hand].hand_hfile);
+    return 1;
+}
+
+
 unsigned phy_getsect(HFILE hfile,unsigned sector,char *buffer)
 {
     ULONG ulPinout,ulDinout;
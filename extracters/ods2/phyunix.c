@@ -0,0 +1,305 @@
+/* PHYUNIX.C v1.2    Physical I/O module for Unix */
+
+/*
+        This is part of ODS2 written by Paul Nankervis,
+        email address:  Paulnank@au1.ibm.com
+
+        ODS2 is distributed freely for all members of the
+        VMS community to use. However all derived works
+        must maintain comments in their source to acknowledge
+        the contibution of the original author.
+*/
+
+/*  On Unix a device is just a file: either a raw device or a
+    disk image. Device xxx: is looked for as the file xxx and
+    then as /dev/xxx. The device is opened for update if we are
+    allowed to, otherwise read-only.
+
+    Each request is done with a single pread/pwrite of the whole
+    length straight into the caller's buffer.
+
+    If the environment variable PHYIO_DIRECT is set devices are
+    opened with O_DIRECT (where the system has it) so that reads
+    of raw devices bypass the system cache. O_DIRECT needs aligned
+    buffers so requests whose buffer is not aligned are bounced
+    through a per-channel buffer. If the device still refuses a
+    direct transfer O_DIRECT is dropped for that channel. A write
+    which ends part way through a sector reads that sector first so
+    the rest of it is written back unchanged.
+
+    A channel is given back by phyio_done when its device is dropped
+    and its slot in the channel table is then free for another open. */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE             /* For O_DIRECT */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "phyio.h"
+#include "ssdef.h"
+
+#ifndef O_DIRECT
+#define O_DIRECT 0
+#endif
+
+#define CHAN_MAX 32
+#define DIRECT_ALIGN 4096       /* Buffer alignment for O_DIRECT */
+#define DIRECT_BUFSIZE (64 * 1024)      /* Bounce buffer size */
+
+unsigned init_count = 0;        /* Some counters so we can report */
+unsigned read_count = 0;        /* How often we get called */
+unsigned write_count = 0;
+
+unsigned chan_count = 0;        /* Slots ever used in chantab */
+struct CHANTAB {
+    int inuse;                  /* Slot holds an open device */
+    int fd;                     /* File descriptor of device */
+    int direct;                 /* Device opened with O_DIRECT */
+    char *bounce;               /* Aligned buffer for O_DIRECT */
+    char name[64];              /* Name of file opened */
+    unsigned reads;             /* Read requests */
+    unsigned writes;            /* Write requests */
+    unsigned long long readbytes;       /* Bytes read */
+    unsigned long long writebytes;      /* Bytes written */
+    unsigned errors;            /* Failed requests */
+} chantab[CHAN_MAX];
+
+
+/* phyio_show - print statistics for all channels */
+
+void phyio_show(void)
+{
+    unsigned chan;
+    printf("PHYIO_SHOW Initializations: %d Reads: %d Writes: %d\n",
+           init_count,read_count,write_count);
+    for (chan = 0; chan < chan_count; chan++) {
+        struct CHANTAB *ch = &chantab[chan];
+        if (!ch->inuse) continue;
+        printf("PHYIO_SHOW %s%s Reads: %u (%llu bytes) Writes: %u (%llu bytes) Errors: %u\n",
+               ch->name,ch->direct ? " (direct)" : "",ch->reads,ch->readbytes,
+               ch->writes,ch->writebytes,ch->errors);
+    }
+}
+
+
+/* phy_open - open a device file, for update if possible */
+
+static int phy_open(char *name,int flags,unsigned *status)
+{
+    int fd = open(name,O_RDWR | flags);
+    *status = 0;
+    if (fd < 0 && (errno == EACCES || errno == EROFS || errno == EPERM)) {
+        fd = open(name,O_RDONLY | flags);
+        *status = PHYIO_READONLY;
+    }
+    return fd;
+}
+
+
+unsigned phyio_init(int devlen,char *devnam,unsigned *handle,struct phyio_info *info)
+{
+    unsigned chan = 0;
+    struct CHANTAB *ch;
+    struct stat st;
+    char name[64];
+    int flags = 0;
+    init_count++;
+    info->status = 0;
+    info->sectors = 0;
+    info->sectorsize = 0;
+    *handle = 0;
+    while (chan < CHAN_MAX && chantab[chan].inuse) chan++;
+    if (chan >= CHAN_MAX) return SS$_NOIOCHAN;
+    if (devlen > 0 && devnam[devlen - 1] == ':') devlen--;
+    if (devlen < 1 || devlen > (int) sizeof(name) - 6) return SS$_NOSUCHDEV;
+    if (getenv("PHYIO_DIRECT") != NULL) flags = O_DIRECT;
+    ch = &chantab[chan];
+    memcpy(name,devnam,devlen);
+    name[devlen] = '\0';
+    ch->fd = phy_open(name,flags,&info->status);
+    if (ch->fd < 0 && errno == ENOENT && strchr(name,'/') == NULL) {
+        sprintf(name,"/dev/%.*s",devlen,devnam);
+        ch->fd = phy_open(name,flags,&info->status);
+    }
+    if (ch->fd < 0 && flags != 0 && errno == EINVAL) {
+        flags = 0;              /* File system can't do O_DIRECT */
+        ch->fd = phy_open(name,flags,&info->status);
+    }
+    if (ch->fd < 0) return SS$_NOSUCHDEV;
+    ch->direct = (flags != 0);
+    ch->bounce = NULL;
+    if (ch->direct &&
+        posix_memalign((void **) &ch->bounce,DIRECT_ALIGN,DIRECT_BUFSIZE) != 0) {
+        close(ch->fd);
+        return SS$_INSFMEM;
+    }
+    strcpy(ch->name,name);
+    ch->reads = ch->writes = ch->errors = 0;
+    ch->readbytes = ch->writebytes = 0;
+    if (fstat(ch->fd,&st) == 0 && S_ISREG(st.st_mode)) {
+        info->sectors = st.st_size / 512;
+        info->sectorsize = 512;
+    }
+    ch->inuse = 1;
+    *handle = chan;
+    if (chan >= chan_count) chan_count = chan + 1;
+    return SS$_NORMAL;
+}
+
+
+/* phyio_done - close a channel and free its slot for reuse */
+
+unsigned phyio_done(unsigned handle)
+{
+    struct CHANTAB *ch;
+    int sts;
+    if (handle >= chan_count || !chantab[handle].inuse) return SS$_IVCHAN;
+    ch = &chantab[handle];
+    sts = close(ch->fd);
+    free(ch->bounce);
+    memset(ch,0,sizeof(struct CHANTAB));
+    ch->fd = -1;
+    return sts == 0 ? SS$_NORMAL : SS$_PARITY;
+}
+
+
+/* phy_direct - check whether a transfer can be done with O_DIRECT
+   straight from the caller's buffer */
+
+static int phy_direct(char *buffer,unsigned length)
+{
+    return ((unsigned long) buffer % DIRECT_ALIGN) == 0 &&
+        (length % 512) == 0;
+}
+
+
+/* phy_nodirect - drop O_DIRECT on a channel which won't do it */
+
+static int phy_nodirect(struct CHANTAB *ch)
+{
+    int flags = fcntl(ch->fd,F_GETFL);
+    if (flags < 0 || fcntl(ch->fd,F_SETFL,flags & ~O_DIRECT) < 0) return 0;
+    ch->direct = 0;
+    return 1;
+}
+
+
+/* phy_transfer - read or write length bytes at offset, retrying
+   short transfers */
+
+static ssize_t phy_transfer(int fd,int wrt,char *buffer,size_t length,off_t offset)
+{
+    size_t done = 0;
+    while (done < length) {
+        ssize_t count;
+        if (wrt) {
+            count = pwrite(fd,buffer + done,length - done,offset + done);
+        } else {
+            count = pread(fd,buffer + done,length - done,offset + done);
+        }
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (count == 0) break;
+        done += count;
+    }
+    return done;
+}
+
+
+/* phy_io - do a transfer on a channel, bouncing it through the
+   aligned buffer if O_DIRECT needs it */
+
+static unsigned phy_io(unsigned chan,int wrt,unsigned block,unsigned length,char *buffer)
+{
+    struct CHANTAB *ch;
+    off_t offset = (off_t) block * 512;
+    ssize_t count;
+    if (chan >= chan_count || !chantab[chan].inuse) return SS$_IVCHAN;
+    ch = &chantab[chan];
+    while (1) {
+        if (!ch->direct || phy_direct(buffer,length)) {
+            count = phy_transfer(ch->fd,wrt,buffer,length,offset);
+        } else {
+            size_t done = 0;
+            count = 0;
+            while (done < length) {
+                size_t chunk = length - done;
+                size_t rounded;
+                ssize_t got;
+                if (chunk > DIRECT_BUFSIZE) chunk = DIRECT_BUFSIZE;
+                rounded = (chunk + 511) / 512 * 512;
+                if (wrt) {
+                    if (rounded > chunk) {
+                        /* Keep what follows the data in its last sector */
+                        got = phy_transfer(ch->fd,0,ch->bounce + rounded - 512,512,
+                                           offset + done + rounded - 512);
+                        if (got < 0) {
+                            count = -1;
+                            break;
+                        }
+                        memset(ch->bounce + rounded - 512 + got,0,512 - got);
+                    }
+                    memcpy(ch->bounce,buffer + done,chunk);
+                }
+                got = phy_transfer(ch->fd,wrt,ch->bounce,rounded,offset + done);
+                if (got < 0) {
+                    count = -1;
+                    break;
+                }
+                if ((size_t) got > chunk) got = chunk;
+                if (!wrt) memcpy(buffer + done,ch->bounce,got);
+                done += got;
+                count = done;
+                if ((size_t) got < chunk) break;
+            }
+        }
+        if (count >= 0 || errno != EINVAL || !ch->direct) break;
+        if (!phy_nodirect(ch)) break;
+    }
+    if (count < 0 || (size_t) count < length) {
+        ch->errors++;
+        if (count >= 0 && !wrt) {
+            memset(buffer + count,0,length - count);
+            return SS$_ENDOFFILE;
+        }
+        return (wrt && count < 0 && errno == EBADF) ? SS$_WRITLCK : SS$_PARITY;
+    }
+    if (wrt) {
+        ch->writes++;
+        ch->writebytes += length;
+    } else {
+        ch->reads++;
+        ch->readbytes += length;
+    }
+    return SS$_NORMAL;
+}
+
+
+unsigned phyio_read(unsigned handle,unsigned block,unsigned length,char *buffer)
+{
+#ifdef DEBUG
+    printf("Phyio read block: %d into %p (%d bytes)\n",block,buffer,length);
+#endif
+    read_count++;
+    return phy_io(handle,0,block,length,buffer);
+}
+
+
+unsigned phyio_write(unsigned handle,unsigned block,unsigned length,char *buffer)
+{
+#ifdef DEBUG
+    printf("Phyio write block: %d from %p (%d bytes)\n",block,buffer,length);
+#endif
+    write_count++;
+    return phy_io(handle,1,block,length,buffer);
+}
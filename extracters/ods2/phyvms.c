@@ -60,7 +60,7 @@ unsigned phyio_init(int devlen,char *devnam,unsigned *handle,struct phyio_info *
 }
 
 
-unsigned phyio_close(unsigned handle)
+unsigned phyio_done(unsigned handle)
 {
     return sys$dassgn(handle);
 }
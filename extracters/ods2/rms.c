@@ -635,7 +635,7 @@ unsigned do_parse(struct FAB *fab,struct WCCFILE **wccret)
 #endif
     }
     if (wccret != NULL) *wccret = wccfile;
-    if (nam != NULL) nam->nam$l_wcc = (int) wccfile;
+    if (nam != NULL) nam->nam$l_wcc = wccfile;
     return SS$_NORMAL;
 }
 
@@ -767,6 +767,14 @@ unsigned sys_get(struct RAB *rab)
     rab->rab$w_rfa[2] = offset = offset % 512;
 
 
+    /* While gets are sequential let accesschunk read ahead... */
+    if (block == fcb->seqvbn || block == fcb->seqvbn + 1) {
+        fcb->readahead = vioc_readahead;
+    } else {
+        fcb->readahead = 0;
+    }
+    fcb->seqvbn = block;
+
     eofblk = swapw(fcb->head->fh2$w_recattr.fat$l_efblk);
     if (block > eofblk || (block == eofblk &&
                            offset >= fcb->head->fh2$w_recattr.fat$w_ffbyte)) return RMS$_EOF;
@@ -856,6 +864,7 @@ unsigned sys_get(struct RAB *rab)
             sts = deaccesschunk(vioc,0,0);
             block += blocks;
             if (block > eofblk) return RMS$_EOF;
+            fcb->seqvbn = block;
             sts = accesschunk(fcb,block,&vioc,&buffer,&blocks,0,NULL);
             if ((sts & 1) == 0) return sts;
             offset = 0;
@@ -871,6 +880,49 @@ unsigned sys_get(struct RAB *rab)
 }
 
 
+/* read for block I/O: read rab$w_usz bytes of whole blocks from
+   virtual block rab$l_bkt (zero for the block following the last
+   read) - rab$w_rsz is set to the length read, which is short at
+   the end of file. The blocks are read straight from the file
+   extents rather than through the cache... */
+
+unsigned sys_read(struct RAB *rab)
+{
+    register unsigned sts,block,blocks,eofblk,ffbyte;
+    struct FCB *fcb = ifi_table[rab->rab$l_fab->fab$w_ifi]->wcf_fcb;
+
+    block = rab->rab$l_bkt;
+    if (block == 0) {
+        block = (rab->rab$w_rfa[1] << 16) + rab->rab$w_rfa[0];
+        block += (rab->rab$w_rsz + 511) / 512;
+        if (block == 0) block = 1;
+    }
+    rab->rab$w_rfa[0] = block & 0xffff;
+    rab->rab$w_rfa[1] = block >> 16;
+    rab->rab$w_rfa[2] = 0;
+    rab->rab$w_rsz = 0;
+
+    eofblk = swapw(fcb->head->fh2$w_recattr.fat$l_efblk);
+    ffbyte = fcb->head->fh2$w_recattr.fat$w_ffbyte;
+    if (eofblk == 0 || eofblk > fcb->hiblock) {
+        eofblk = fcb->hiblock + 1;
+        ffbyte = 0;
+    }
+    if (block > eofblk || (block == eofblk && ffbyte == 0)) return RMS$_EOF;
+    blocks = rab->rab$w_usz / 512;
+    if (blocks < 1) return RMS$_RTB;
+    if (blocks > eofblk - block) {
+        blocks = eofblk - block;
+        if (ffbyte) blocks++;
+    }
+    sts = accessread(fcb,block,blocks,rab->rab$l_ubf);
+    if ((sts & 1) == 0) return sts;
+    rab->rab$w_rsz = blocks * 512;
+    if (block + blocks > eofblk) rab->rab$w_rsz -= 512 - ffbyte;
+    return 1;
+}
+
+
 /* display to fill fab & xabs with info from the file header... */
 
 unsigned sys_display(struct FAB *fab)
@@ -127,7 +127,7 @@ struct NAM {
     char *nam$l_type;
     int nam$b_ver;
     char *nam$l_ver;
-    int nam$l_wcc;
+    void *nam$l_wcc;
     int nam$b_nop;
     int nam$l_fnb;
 };
@@ -149,10 +149,11 @@ struct RAB {
     unsigned rab$w_rsz;
     int rab$b_rac;
     unsigned short rab$w_rfa[3];
+    unsigned rab$l_bkt;
 };
 
 #ifdef RMS_INITIALIZE
-struct RAB cc$rms_rab = {NULL,NULL,NULL,0,0,0,{0,0,0}};
+struct RAB cc$rms_rab = {NULL,NULL,NULL,0,0,0,{0,0,0},0};
 #else
 extern struct RAB cc$rms_rab;
 #endif
@@ -210,6 +211,7 @@ extern struct FAB cc$rms_fab;
 #define sys$connect     sys_connect
 #define sys$disconnect  sys_disconnect
 #define sys$get         sys_get
+#define sys$read        sys_read
 #define sys$display     sys_display
 #define sys$close       sys_close
 #define sys$open        sys_open
@@ -221,6 +223,7 @@ unsigned sys_parse(struct FAB *fab);
 unsigned sys_connect(struct RAB *rab);
 unsigned sys_disconnect(struct RAB *rab);
 unsigned sys_get(struct RAB *rab);
+unsigned sys_read(struct RAB *rab);
 unsigned sys_display(struct FAB *fab);
 unsigned sys_close(struct FAB *fab);
 unsigned sys_open(struct FAB *fab);
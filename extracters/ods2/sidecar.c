@@ -0,0 +1,342 @@
+/* Sidecar.c v1.2    Persistent index of volume metadata */
+
+/*
+        This is part of ODS2 written by Paul Nankervis,
+        email address:  Paulnank@au1.ibm.com
+
+        ODS2 is distributed freely for all members of the
+        VMS community to use. However all derived works
+        must maintain comments in their source to acknowledge
+        the contibution of the original author.
+*/
+
+/*  Looking through a large volume means reading file headers from
+    INDEXF.SYS and the blocks of every directory file - and doing it
+    all again each time the same image is mounted. When a volume is
+    mounted with /INDEX the blocks read from the index file and from
+    directory files are kept in a sidecar file (the device name with
+    .idx added) which is written out at dismount or exit. On the next
+    mount the sidecar is loaded (mapped into memory where we can) and
+    file headers, retrieval pointers and directory entries are found
+    there instead of being read from the device again.
+
+    The sidecar keeps a copy of the home block and is thrown away if
+    the volume home block, and so its revision date, has changed.
+    Blocks written through ODS2 are updated in the sidecar as well. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssdef.h"
+#include "access.h"
+#include "phyio.h"
+#include "sidecar.h"
+
+#if defined(unix) || defined(__unix__) || defined(__APPLE__)
+#define SIDECAR_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+struct SIDECAR *sidecar_list = NULL;
+
+
+/* sidecar_show - print statistics for each index */
+
+void sidecar_show(void)
+{
+    register struct SIDECAR *side;
+    for (side = sidecar_list; side != NULL; side = side->next) {
+        printf("SIDECAR_SHOW %s Blocks: %u Hits: %u Misses: %u%s\n",
+               side->name,side->count,side->hits,side->misses,
+               side->dirty ? " (modified)" : "");
+    }
+}
+
+
+/* sidecar_find - bisect the table for the first entry at or
+   after a logical block */
+
+unsigned sidecar_find(struct SIDECAR *side,unsigned lbn)
+{
+    register unsigned lo = 0,hi = side->count;
+    while (lo < hi) {
+        register unsigned mid = (lo + hi) / 2;
+        if (side->ent[mid].lbn < lbn) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+
+/* sidecar_unload - release the table and the index file contents */
+
+void sidecar_unload(struct SIDECAR *side)
+{
+    register unsigned i;
+    for (i = 0; i < side->count; i++) {
+        register char *data = side->ent[i].data;
+        if (side->map == NULL || data < side->map || data >= side->map + side->mapsize) {
+            free(data);
+        }
+    }
+    free(side->ent);
+    if (side->map != NULL) {
+#ifdef SIDECAR_MMAP
+        if (side->mapped) {
+            munmap(side->map,side->mapsize);
+        } else {
+            free(side->map);
+        }
+#else
+        free(side->map);
+#endif
+    }
+    side->ent = NULL;
+    side->map = NULL;
+    side->mapsize = 0;
+    side->mapped = 0;
+    side->count = side->max = 0;
+}
+
+
+/* sidecar_load - bring in an existing index file and check that
+   it belongs to this volume */
+
+int sidecar_load(struct SIDECAR *side)
+{
+    register unsigned i;
+    register struct SIDEHDR *hdr;
+    register u_lword *table;
+#ifdef SIDECAR_MMAP
+    struct stat st;
+    int fd = open(side->name,O_RDONLY);
+    if (fd < 0) return 0;
+    if (fstat(fd,&st) != 0 || st.st_size < 1024) {
+        close(fd);
+        return 0;
+    }
+    side->map = mmap(NULL,st.st_size,PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (side->map == (char *) MAP_FAILED) {
+        side->map = NULL;
+        return 0;
+    }
+    side->mapsize = st.st_size;
+    side->mapped = 1;
+#else
+    long size;
+    FILE *fp = fopen(side->name,"rb");
+    if (fp == NULL) return 0;
+    if (fseek(fp,0,SEEK_END) != 0 || (size = ftell(fp)) < 1024) {
+        fclose(fp);
+        return 0;
+    }
+    rewind(fp);
+    side->map = malloc(size);
+    if (side->map != NULL) side->mapsize = size;
+    if (side->map == NULL || fread(side->map,size,1,fp) != 1) {
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+#endif
+    hdr = (struct SIDEHDR *) side->map;
+    if (memcmp(hdr->magic,SIDECAR_MAGIC,8) != 0 || hdr->count > SIDECAR_MAX ||
+        hdr->datablk < 2 + (hdr->count * sizeof(u_lword) + 511) / 512 ||
+        (unsigned long) (hdr->datablk + hdr->count) * 512 > side->mapsize ||
+        memcmp(side->map + 512,&side->home,sizeof(struct HOME)) != 0) return 0;
+    side->ent = (struct SIDEENT *) malloc((hdr->count + 1) * sizeof(struct SIDEENT));
+    if (side->ent == NULL) return 0;
+    table = (u_lword *) (side->map + 1024);
+    for (i = 0; i < hdr->count; i++) {
+        if (i > 0 && table[i] <= table[i - 1]) break;
+        side->ent[i].lbn = table[i];
+        side->ent[i].data = side->map + (hdr->datablk + i) * 512;
+    }
+    side->max = hdr->count + 1;
+    side->count = i;
+    return i == hdr->count;
+}
+
+
+/* sidecar_save - write the index out to a new file and then
+   replace the old one with it */
+
+int sidecar_save(struct SIDECAR *side)
+{
+    register unsigned i;
+    register int ok;
+    struct SIDEHDR hdr;
+    unsigned tblocks = (side->count * sizeof(u_lword) + 511) / 512;
+    char tmpname[sizeof(side->name) + 4];
+    u_lword *table;
+    FILE *fp;
+    table = (u_lword *) calloc(tblocks + 1,512);
+    if (table == NULL) return 0;
+    for (i = 0; i < side->count; i++) table[i] = side->ent[i].lbn;
+    memset(&hdr,0,sizeof(hdr));
+    memcpy(hdr.magic,SIDECAR_MAGIC,8);
+    hdr.count = side->count;
+    hdr.datablk = 2 + tblocks;
+    sprintf(tmpname,"%s.tmp",side->name);
+    fp = fopen(tmpname,"wb");
+    if (fp == NULL) {
+        free(table);
+        return 0;
+    }
+    ok = fwrite(&hdr,sizeof(hdr),1,fp) == 1 &&
+        fwrite(&side->home,sizeof(struct HOME),1,fp) == 1 &&
+        (tblocks == 0 || fwrite(table,512,tblocks,fp) == tblocks);
+    for (i = 0; ok && i < side->count; i++) {
+        ok = fwrite(side->ent[i].data,512,1,fp) == 1;
+    }
+    free(table);
+    if (fclose(fp) != 0) ok = 0;
+    if (ok) {
+        remove(side->name);
+        ok = rename(tmpname,side->name) == 0;
+    }
+    if (!ok) remove(tmpname);
+    return ok;
+}
+
+
+/* sidecar_add - put a copy of a block read from the device into
+   the index */
+
+int sidecar_add(struct SIDECAR *side,unsigned lbn,char *data)
+{
+    register unsigned pos = sidecar_find(side,lbn);
+    register char *copy;
+    if (pos < side->count && side->ent[pos].lbn == lbn) return 1;
+    if (side->count >= SIDECAR_MAX) return 0;
+    if (side->count >= side->max) {
+        register unsigned max = side->max * 2 + 256;
+        register struct SIDEENT *ent;
+        if (max > SIDECAR_MAX) max = SIDECAR_MAX;
+        ent = (struct SIDEENT *) realloc(side->ent,max * sizeof(struct SIDEENT));
+        if (ent == NULL) return 0;
+        side->ent = ent;
+        side->max = max;
+    }
+    copy = (char *) malloc(512);
+    if (copy == NULL) return 0;
+    memcpy(copy,data,512);
+    memmove(&side->ent[pos + 1],&side->ent[pos],(side->count - pos) * sizeof(struct SIDEENT));
+    side->ent[pos].lbn = lbn;
+    side->ent[pos].data = copy;
+    side->count++;
+    side->dirty = 1;
+    return 1;
+}
+
+
+/* sidecar_read - read metadata blocks: from the index if they are
+   all there, otherwise from the device adding them to the index */
+
+unsigned sidecar_read(struct DEV *dev,unsigned lbn,unsigned length,char *buffer)
+{
+    register struct SIDECAR *side = dev->sidecar;
+    register unsigned i,sts;
+    register unsigned pos = sidecar_find(side,lbn);
+    if (pos + length <= side->count && side->ent[pos].lbn == lbn &&
+        side->ent[pos + length - 1].lbn == lbn + length - 1) {
+        for (i = 0; i < length; i++) memcpy(buffer + i * 512,side->ent[pos + i].data,512);
+        side->hits += length;
+        return SS$_NORMAL;
+    }
+    sts = phyio_read(dev->handle,lbn,length * 512,buffer);
+    if (sts & 1) {
+        side->misses += length;
+        for (i = 0; i < length; i++) {
+            if (!sidecar_add(side,lbn + i,buffer + i * 512)) break;
+        }
+    }
+    return sts;
+}
+
+
+/* sidecar_write - keep the index in step with blocks written */
+
+void sidecar_write(struct DEV *dev,unsigned lbn,unsigned length,char *buffer)
+{
+    register struct SIDECAR *side = dev->sidecar;
+    register unsigned pos;
+    if (side == NULL) return;
+    pos = sidecar_find(side,lbn);
+    while (pos < side->count && side->ent[pos].lbn < lbn + length) {
+        memcpy(side->ent[pos].data,buffer + (side->ent[pos].lbn - lbn) * 512,512);
+        side->dirty = 1;
+        pos++;
+    }
+}
+
+
+/* sidecar_open - set up the index for a device being mounted */
+
+unsigned sidecar_open(struct DEV *dev,struct HOME *home)
+{
+    register struct SIDECAR *side;
+    if (dev->sidecar != NULL) sidecar_close(dev);
+    if (dev->devlen + 5 > (int) sizeof(side->name)) return SS$_BADPARAM;
+    side = (struct SIDECAR *) calloc(1,sizeof(struct SIDECAR));
+    if (side == NULL) return SS$_INSFMEM;
+    side->dev = dev;
+    memcpy(&side->home,home,sizeof(struct HOME));
+    sprintf(side->name,"%.*s.idx",dev->devlen,dev->devnam);
+    if (!sidecar_load(side)) {
+        sidecar_unload(side);
+        side->dirty = 1;
+    }
+    side->next = sidecar_list;
+    sidecar_list = side;
+    dev->sidecar = side;
+    return SS$_NORMAL;
+}
+
+
+/* sidecar_close - write out the index if it has changed and
+   release it */
+
+unsigned sidecar_close(struct DEV *dev)
+{
+    register struct SIDECAR *side = dev->sidecar;
+    register struct SIDECAR **link = &sidecar_list;
+    register unsigned sts = SS$_NORMAL;
+    if (side == NULL) return sts;
+    if (side->dirty && !sidecar_save(side)) {
+        printf("%%ODS2-W-NOINDEX, Could not write index file %s\n",side->name);
+        sts = SS$_WRITLCK;
+    }
+    while (*link != side) link = &(*link)->next;
+    *link = side->next;
+    sidecar_unload(side);
+    free(side);
+    dev->sidecar = NULL;
+    return sts;
+}
+
+
+/* sidecar_discard - release the index without writing it out,
+   for a mount which failed */
+
+unsigned sidecar_discard(struct DEV *dev)
+{
+    if (dev->sidecar != NULL) dev->sidecar->dirty = 0;
+    return sidecar_close(dev);
+}
+
+
+/* sidecar_closeall - write out all indexes before we exit */
+
+void sidecar_closeall(void)
+{
+    while (sidecar_list != NULL) sidecar_close(sidecar_list->dev);
+}
@@ -0,0 +1,61 @@
+/* Sidecar.h v1.2    Definitions for the persistent metadata index */
+
+/*
+        This is part of ODS2 written by Paul Nankervis,
+        email address:  Paulnank@au1.ibm.com
+
+        ODS2 is distributed freely for all members of the
+        VMS community to use. However all derived works
+        must maintain comments in their source to acknowledge
+        the contibution of the original author.
+*/
+
+#ifndef SIDECAR_MAGIC
+
+#define SIDECAR_MAGIC "ODS2IDX1"
+#define SIDECAR_MAX 262144      /* Most blocks kept in an index */
+
+/* The index file is laid out in 512 byte blocks so that it can be
+   mapped straight into memory:-
+        block 0         struct SIDEHDR
+        block 1         copy of the volume home block
+        block 2...      sorted table of the logical block numbers
+        after that      the blocks themselves, in table order */
+
+struct SIDEHDR {
+    char magic[8];              /* SIDECAR_MAGIC */
+    u_lword count;              /* Number of blocks indexed */
+    u_lword datablk;            /* Index block of first data block */
+    u_byte reserved[496];
+};
+
+struct SIDEENT {
+    unsigned lbn;               /* Logical block number */
+    char *data;                 /* Block contents */
+};
+
+struct SIDECAR {
+    struct SIDECAR *next;       /* Next open index */
+    struct DEV *dev;            /* Device indexed */
+    struct HOME home;           /* Home block the index is valid for */
+    unsigned count;             /* Blocks in index */
+    unsigned max;               /* Size of entry table */
+    struct SIDEENT *ent;        /* Sorted entry table */
+    char *map;                  /* Index file contents (if loaded) */
+    unsigned long mapsize;      /* Size of index file contents */
+    int mapped;                 /* Contents are memory mapped */
+    int dirty;                  /* Index needs to be rewritten */
+    unsigned hits;              /* Blocks found in index */
+    unsigned misses;            /* Blocks read from device */
+    char name[68];              /* Index file name */
+};
+
+unsigned sidecar_open(struct DEV *dev,struct HOME *home);
+unsigned sidecar_read(struct DEV *dev,unsigned lbn,unsigned length,char *buffer);
+void sidecar_write(struct DEV *dev,unsigned lbn,unsigned length,char *buffer);
+unsigned sidecar_close(struct DEV *dev);
+unsigned sidecar_discard(struct DEV *dev);
+void sidecar_closeall(void);
+void sidecar_show(void);
+
+#endif
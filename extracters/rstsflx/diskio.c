@@ -1,5 +1,9 @@
 /* subroutines to do rsts disk (logical block) I/O */
 
+#ifdef __linux__
+#define _GNU_SOURCE			/* for fallocate */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,6 +15,15 @@
 #include "diskio.h"
 #include "absio.h"
 
+#ifdef __unix__
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define ZEROBLKS	64	/* blocks per write when zeroing */
+
 #define	DEFDEVICE	"rsts.dsk"
 
 #define NOLAST		0
@@ -39,6 +52,42 @@ FILE		*rstsfile;    	/* rsts disk or container file */
 int		lastio;		/* what type of I/O, if any, was last done */
 long		nextblk;	/* next block after end of last I/O */
 
+#ifdef __unix__
+/* On Unix, once the disk is open, I/O is done with pread and pwrite on
+ * its file descriptor rather than through stdio.  If the disk is a
+ * container file it is also mapped into memory; reads and writes then
+ * just copy to or from the mapping, and rmapread can hand out pointers
+ * straight into it.  The part of the mapping that has been written is
+ * tracked so rclose only has to msync that range.
+ */
+
+int		diskfd = -1;	/* disk file descriptor, -1 to use stdio */
+byte		*diskmap;	/* disk contents if mapped, else NULL */
+off_t		maplen;		/*  and how much of it is mapped */
+off_t		dirtylo, dirtyhi;	/* range written through mapping */
+#endif
+
+/* Directory blocks are kept in a small cache, so that walking [*,*]
+ * doesn't re-read the MFD and GFD blocks every time it moves from one
+ * UFD to the next.  Blocks written by fbwrite stay in the cache until
+ * they are evicted or the disk is closed.  rread and rwrite keep the
+ * cache coherent with I/O done directly by the rest of the program.
+ */
+
+#define DCSIZE		128	/* number of blocks in directory cache */
+
+typedef struct {
+	long		lbn;		/* block held here, -1 if none */
+	int		dirty;		/* TRUE if it needs to be written */
+	unsigned long	used;		/* last use, for LRU replacement */
+	byte		data[BLKSIZE];
+} dcent;
+
+dcent		dcache[DCSIZE];
+unsigned long	dcclock;	/* LRU clock */
+int		dcdirty;	/* number of dirty blocks in cache */
+long		dchits, dcmisses, dcwrites;	/* statistics */
+
 const diskent	sizetbl[] = {
 	{ "rx50", 800, 800, FALSE },
 	{ "rf11", 1024, 1024, FALSE },
@@ -192,6 +241,9 @@ void ropen (const char *mode)
 	struct stat	sbuf;
 
 	fiblk = -1;			/* indicate no valid FIBUF */
+	fiblkw = FALSE;
+	rflush ();			/* in case a command was aborted */
+	dcinval ();			/* nothing in directory cache */
 	lastio = NOLAST;		/*  and no previous I/O */
 	womsat = FALSE;			/* SATT is clean */
 	setrname ();
@@ -232,6 +284,23 @@ void ropen (const char *mode)
 		}
 	}
 	diskblocks = adjsize (diskblocks);	/* adjust for bad block tbl */
+#ifdef __unix__
+	if (!absflag) {
+		diskfd = fileno (rstsfile);
+		if (S_ISREG(sbuf.st_mode) &&
+		    sbuf.st_size >= (off_t) diskblocks * BLKSIZE) {
+			maplen = (off_t) diskblocks * BLKSIZE;
+			diskmap = (byte *) mmap (NULL, maplen, 
+				strcmp (mode, DREADMODE) ? PROT_READ | PROT_WRITE : PROT_READ,
+				MAP_SHARED, diskfd, 0);
+			if (diskmap == (byte *) MAP_FAILED) diskmap = NULL;
+			dirtylo = maplen;
+			dirtyhi = 0;
+			if (sw.debug != NULL && diskmap != NULL)
+				printf ("mapped %ld blocks of %s\n", diskblocks, rname);
+		}
+	}
+#endif
 	d = (diskblocks - 1) >> 16;	/* high order bits of last LBN */
 	dcs = 1;			/* compute DCS */
 	while (d) {
@@ -250,46 +319,439 @@ void rseek (long block)
 		printf ("seek to: %ld\n", block);
 }
 
-void rread (long block, long size, void *buffer)
+#ifdef __unix__
+/* transfer to or from the disk by way of the mapping or pread/pwrite.
+ * returns the number of bytes transferred.
+ */
+
+static long unxio (long block, long size, void *buffer, int wrt)
 {
-	long	iosize;
+	off_t	off = (off_t) block * BLKSIZE;
+	long	done;
+	ssize_t	n;
 
-	if (lastio != LASTREAD || nextblk != block) {
-		rseek (block);
-		lastio = LASTREAD;
+	if (block >= diskblocks) rabort(BADBLK);
+	if (diskmap != NULL && off + size <= maplen) {
+		if (wrt) {
+			memcpy (diskmap + off, buffer, size);
+			if (off < dirtylo) dirtylo = off;
+			if (off + size > dirtyhi) dirtyhi = off + size;
+		} else	memcpy (buffer, diskmap + off, size);
+		return (size);
+	}
+	for (done = 0; done < size; done += n) {
+		if (wrt) n = pwrite (diskfd, (byte *) buffer + done, 
+				     size - done, off + done);
+		else	 n = pread (diskfd, (byte *) buffer + done,
+				    size - done, off + done);
+		if (n < 0 && errno == EINTR) n = 0;
+		else if (n <= 0) break;
 	}
-	if (absflag) {
-		if (absread (block, size, buffer))
-		    iosize = 0;
-		else iosize = size;
+	return (done);
+}
+#endif
+
+static void diskread (long block, long size, void *buffer)
+{
+	long	iosize;
+
+#ifdef __unix__
+	if (diskfd >= 0)
+		iosize = unxio (block, size, buffer, FALSE);
+	else
+#endif
+	{
+		if (lastio != LASTREAD || nextblk != block) {
+			rseek (block);
+			lastio = LASTREAD;
+		}
+		if (absflag) {
+			if (absread (block, size, buffer))
+			    iosize = 0;
+			else iosize = size;
+		}
+		else iosize = fread (buffer, 1, size, rstsfile);
+		nextblk = block + size / BLKSIZE;
 	}
-	else iosize = fread (buffer, 1, size, rstsfile);
 	if (sw.debug != NULL)
 		printf ("size requested: %ld, read: %ld\n", size, iosize);
 	if (iosize != size) rabort(DISKIO);
-	nextblk = block + size / BLKSIZE;
 }
 
-void rwrite (long block, long size, void *buffer)
+static void diskwrite (long block, long size, void *buffer)
 {
 	long	iosize;
 
-	if (lastio != LASTWRITE || nextblk != block) {
-		rseek (block);
-		lastio = LASTWRITE;
-	}
-	if (absflag) {
-		if (abswrite (block, size, buffer))
-			iosize = 0;
-		else iosize = size;
+#ifdef __unix__
+	if (diskfd >= 0)
+		iosize = unxio (block, size, buffer, TRUE);
+	else
+#endif
+	{
+		if (lastio != LASTWRITE || nextblk != block) {
+			rseek (block);
+			lastio = LASTWRITE;
+		}
+		if (absflag) {
+			if (abswrite (block, size, buffer))
+				iosize = 0;
+			else iosize = size;
+		}
+		else iosize = fwrite (buffer, 1, size, rstsfile);
+		nextblk = block + size / BLKSIZE;
 	}
-	else iosize = fwrite (buffer, 1, size, rstsfile);
 	if (iosize != size) rabort(DISKIO);
-	nextblk = block + size / BLKSIZE;
+}
+
+/* rread and rwrite do I/O on the disk for callers that bypass the
+ * directory cache.  A read picks up any newer data for those blocks
+ * that is still in the cache; a write replaces the cached copy.
+ */
+
+void rread (long block, long size, void *buffer)
+{
+	dcent	*c;
+
+	diskread (block, size, buffer);
+	if (dcdirty == 0) return;
+	for (c = dcache; c < dcache + DCSIZE; c++)
+		if (c->dirty && c->lbn >= block &&
+		    c->lbn < block + size / BLKSIZE)
+			memcpy ((byte *) buffer + (c->lbn - block) * BLKSIZE,
+				c->data, BLKSIZE);
+}
+
+/* rpread is rread for clean's directory pre-scan, which reads from
+ * several threads at once.  It never aborts; it returns TRUE if the
+ * whole transfer was done and FALSE if not.  It only works where the
+ * disk is read with pread or through the mapping.  rconcurrent returns
+ * how many threads can usefully call it at once (one per processor),
+ * or 0 if it can't be used.  The directory cache must not change while
+ * rpread is in use.
+ */
+
+int rconcurrent (void)
+{
+#ifdef __unix__
+	long	n;
+
+	if (diskfd < 0) return (0);
+	n = sysconf (_SC_NPROCESSORS_ONLN);
+	return (n < 1 ? 1 : (int) n);
+#else
+	return (0);
+#endif
+}
+
+int rpread (long block, long size, void *buffer)
+{
+#ifdef __unix__
+	dcent	*c;
+
+	if (diskfd < 0 || block < 0 || block + size / BLKSIZE > diskblocks)
+		return (FALSE);
+	if (unxio (block, size, buffer, FALSE) != size) return (FALSE);
+	if (dcdirty == 0) return (TRUE);
+	for (c = dcache; c < dcache + DCSIZE; c++)
+		if (c->dirty && c->lbn >= block &&
+		    c->lbn < block + size / BLKSIZE)
+			memcpy ((byte *) buffer + (c->lbn - block) * BLKSIZE,
+				c->data, BLKSIZE);
+	return (TRUE);
+#else
+	return (FALSE);
+#endif
+}
+
+void rwrite (long block, long size, void *buffer)
+{
+	dcent	*c;
+
+	for (c = dcache; c < dcache + DCSIZE; c++)
+		if (c->lbn >= block && c->lbn < block + size / BLKSIZE)
+		{
+			memcpy (c->data, (byte *) buffer + (c->lbn - block) * BLKSIZE,
+				BLKSIZE);
+			if (c->dirty) dcdirty--;
+			c->dirty = FALSE;
+		}
+	diskwrite (block, size, buffer);
+}
+
+/* write a dirty directory cache block to the disk */
+
+static void dcput (dcent *c)
+{
+	c->dirty = FALSE;		/* first, in case write aborts */
+	dcdirty--;
+	dcwrites++;
+	diskwrite (c->lbn, BLKSIZE, c->data);
+}
+
+/* rzero sets "count" blocks starting at "block" to zero.  If the disk
+ * is a container file, this is done by freeing that part of the file
+ * (punching a hole, or just extending the file if the blocks are past
+ * its end) where the system can do that; otherwise zeros are written.
+ */
+
+void rzero (long block, long count)
+{
+	static byte	zeros[ZEROBLKS * BLKSIZE];
+	dcent		*c;
+	long		n;
+#ifdef __unix__
+	struct stat	sbuf;
+	off_t		start, end;
+	int		fd;
+#endif
+
+	if (block >= diskblocks) rabort(BADBLK);
+	for (c = dcache; c < dcache + DCSIZE; c++)
+		if (c->lbn >= block && c->lbn < block + count)
+		{
+			memset (c->data, 0, BLKSIZE);
+			if (c->dirty) dcdirty--;
+			c->dirty = FALSE;
+		}
+#ifdef __unix__
+	fd = diskfd;
+	if (fd < 0 && !absflag) {	/* not opened by ropen (init) */
+		fflush (rstsfile);
+		fd = fileno (rstsfile);
+		lastio = NOLAST;	/* make the next stdio I/O seek */
+	}
+	start = (off_t) block * BLKSIZE;
+	end = start + (off_t) count * BLKSIZE;
+	if (fd >= 0 && fstat (fd, &sbuf) == 0 && S_ISREG(sbuf.st_mode)) {
+		if (end > sbuf.st_size && ftruncate (fd, end) == 0) {
+			end = sbuf.st_size;	/* new part reads as zeros */
+			if (end <= start) return;
+		}
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+		if (end <= sbuf.st_size &&
+		    fallocate (fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			       start, end - start) == 0)
+			return;
+#endif
+	}
+#endif
+	for ( ; count > 0; count -= n, block += n) {
+		n = count;
+		if (n > ZEROBLKS) n = ZEROBLKS;
+		diskwrite (block, n * BLKSIZE, zeros);
+	}
+}
+
+/* rprefetch tells the system that "count" blocks starting at "block"
+ * will be read soon, so it can start reading them while we do other
+ * things.  It does nothing if the system has no way to do that.
+ */
+
+void rprefetch (long block, long count)
+{
+	if (block >= diskblocks) return;
+	if (block + count > diskblocks) count = diskblocks - block;
+#ifdef __unix__
+	if (diskmap != NULL) {
+		off_t	pg = sysconf (_SC_PAGESIZE);
+		off_t	start = DOWN((off_t) block * BLKSIZE, pg);
+
+		madvise (diskmap + start, 
+			 (off_t) (block + count) * BLKSIZE - start, MADV_WILLNEED);
+	}
+#if defined(POSIX_FADV_WILLNEED)
+	else if (diskfd >= 0)
+		posix_fadvise (diskfd, (off_t) block * BLKSIZE, 
+			       (off_t) count * BLKSIZE, POSIX_FADV_WILLNEED);
+#endif
+#endif
+}
+
+/* rspace returns the space (in blocks) the container file takes up
+ * on the host disk, or -1 if that isn't known.
+ */
+
+long rspace (void)
+{
+#ifdef __unix__
+	struct stat	sbuf;
+
+	if (!absflag && fstat (fileno (rstsfile), &sbuf) == 0 &&
+	    S_ISREG(sbuf.st_mode))
+		return ((long) (sbuf.st_blocks * 512 / BLKSIZE));
+#endif
+	return (-1);
+}
+
+/* rmapread is rread for callers that only look at the data: if the
+ * disk is mapped, it returns a pointer to the data in the mapping and
+ * the buffer isn't used; otherwise it reads into the buffer and returns
+ * that.  Dirty directory blocks in the range are written out first.
+ */
+
+const void *rmapread (long block, long size, void *buffer)
+{
+#ifdef __unix__
+	dcent	*c;
+
+	if (diskmap != NULL && (off_t) block * BLKSIZE + size <= maplen) {
+		if (block >= diskblocks) rabort(BADBLK);
+		for (c = dcache; dcdirty && c < dcache + DCSIZE; c++)
+			if (c->dirty && c->lbn >= block &&
+			    c->lbn < block + size / BLKSIZE)
+				dcput (c);
+		return (diskmap + (off_t) block * BLKSIZE);
+	}
+#endif
+	rread (block, size, buffer);
+	return (buffer);
+}
+
+/* find a block in the directory cache, or NULL if it isn't there */
+
+static dcent *dcfind (long block)
+{
+	dcent	*c;
+
+	for (c = dcache; c < dcache + DCSIZE; c++)
+		if (c->lbn == block) 
+		{
+			c->used = ++dcclock;
+			return (c);
+		}
+	return (NULL);
+}
+
+/* get a cache entry for a new block, evicting (and if necessary
+ * writing) the least recently used one.
+ */
+
+static dcent *dcslot (void)
+{
+	dcent	*c, *lru;
+
+	lru = dcache;
+	for (c = dcache; c < dcache + DCSIZE; c++)
+	{
+		if (c->lbn < 0)
+		{
+			lru = c;
+			break;
+		}
+		if (c->used < lru->used) lru = c;
+	}
+	if (lru->dirty) dcput (lru);
+	lru->lbn = -1;
+	lru->used = ++dcclock;
+	return (lru);
+}
+
+/* read a directory block through the cache */
+
+void dcread (long block, void *buffer)
+{
+	dcent	*c;
+
+	if ((c = dcfind (block)) != NULL) dchits++;
+	else
+	{
+		dcmisses++;
+		c = dcslot ();
+		diskread (block, BLKSIZE, c->data);
+		c->lbn = block;
+	}
+	memcpy (buffer, c->data, BLKSIZE);
+}
+
+/* write a directory block; it goes to disk when evicted or flushed */
+
+void dcwrite (long block, const void *buffer)
+{
+	dcent	*c;
+
+	if ((c = dcfind (block)) == NULL)
+	{
+		c = dcslot ();
+		c->lbn = block;
+	}
+	memcpy (c->data, buffer, BLKSIZE);
+	if (!c->dirty) dcdirty++;
+	c->dirty = TRUE;
+}
+
+static int dccomp (const void *a, const void *b)
+{
+	long	la = (*(const dcent **) a)->lbn;
+	long	lb = (*(const dcent **) b)->lbn;
+
+	return ((la > lb) - (la < lb));
+}
+
+/* write all dirty directory blocks, in LBN order */
+
+void dcflush (void)
+{
+	dcent	*list[DCSIZE];
+	int	n, j;
+
+	if (dcdirty == 0) return;
+	n = 0;
+	for (j = 0; j < DCSIZE; j++)
+		if (dcache[j].dirty) list[n++] = &dcache[j];
+	qsort (list, n, sizeof (dcent *), dccomp);
+	for (j = 0; j < n; j++) dcput (list[j]);
+}
+
+/* empty the directory cache (any dirty blocks are discarded) */
+
+void dcinval (void)
+{
+	int	j;
+
+	for (j = 0; j < DCSIZE; j++)
+	{
+		dcache[j].lbn = -1;
+		dcache[j].dirty = FALSE;
+	}
+	dcdirty = 0;
+	dchits = dcmisses = dcwrites = 0;
+}
+
+/* write out the directory cache, and stop using the mapping (if any)
+ * after making sure what was written through it gets to the disk.
+ * this is done on close, and also on abort since the disk is left
+ * open in that case.
+ */
+
+void rflush (void)
+{
+	dcflush ();			/* write out directory blocks */
+#ifdef __unix__
+	if (diskmap != NULL) {
+		long	pg = sysconf (_SC_PAGESIZE);
+
+		if (dirtyhi > dirtylo) {
+			dirtylo = DOWN(dirtylo, pg);
+			if (msync (diskmap + dirtylo, dirtyhi - dirtylo, MS_SYNC))
+			{
+				diskmap = NULL;
+				rabort(DISKIO);
+			}
+		}
+		munmap (diskmap, maplen);
+		diskmap = NULL;
+	}
+	diskfd = -1;
+#endif
 }
 
 void rclose ()
 {
+	rflush ();
+	if (sw.debug != NULL)
+		printf ("directory cache: %ld hits, %ld misses, %ld writes\n",
+			dchits, dcmisses, dcwrites);
+	dcinval ();
 	if (absflag)	absclose ();
 	else		fclose (rstsfile);
 }
@@ -4,5 +4,16 @@ extern void setrname(void);
 extern void ropen(const char * mode);
 extern void rseek(long block);
 extern void rread(long block , long size , void * buffer);
+extern int rconcurrent(void);
+extern int rpread(long block , long size , void * buffer);
 extern void rwrite(long block , long size , void * buffer);
+extern const void *rmapread(long block , long size , void * buffer);
+extern void rzero(long block , long count);
+extern long rspace(void);
+extern void rprefetch(long block , long count);
+extern void rflush(void);
 extern void rclose(void);
+extern void dcread(long block , void * buffer);
+extern void dcwrite(long block , const void * buffer);
+extern void dcflush(void);
+extern void dcinval(void);
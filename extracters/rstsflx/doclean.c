@@ -17,6 +17,9 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
+#ifdef __unix__
+#include <pthread.h>
+#endif
 
 #include "flx.h"
 #include "fldef.h"
@@ -41,6 +44,8 @@
  *	gfdmap	- bitmap of allocated GFD blockettes
  *	ufdbuf	- the entire current UFD
  *	ufdmap	- bitmap of allocated UFD blockettes
+ *	crossmap - clusters the pre-scan found cross-linked (same form
+ *		  as sattbuf), NULL if there was no scan or none were found
  *
  * note: the blockette maps don't explicitly represent the label or
  * fdcm spots, since those are in use by definition.  however, the
@@ -64,6 +69,19 @@ byte	*gfdbuf = NULL;
 byte	*gfdmap = NULL;
 byte	*ufdbuf = NULL;
 byte	*ufdmap = NULL;
+byte	*crossmap = NULL;
+
+/* who first allocated each cross-linked cluster, so the walk can name
+ * both owners when it finds the second one.
+ */
+typedef struct
+{
+	long	pcn;
+	char	owner[22];
+} crossent;
+
+crossent *crosslist = NULL;
+int	crosscount, crossmax;
 
 byte	curproj, curprog;
 char	curdir[10];
@@ -180,6 +198,317 @@ static void readdir (word dcn, byte *buf)
 	}
 }
 
+/* the mfd and each gfd have a table of the dcns of the directories
+ * below them.  before those directories are cleaned one by one, this
+ * function asks for all of them to be read ahead, in lbn order, so
+ * the reads overlap with the checking instead of each one waiting.
+ * it asks for as much as readdir starts with.
+ */
+static int dcncomp (const void *a, const void *b)
+{
+	return (int) *(const word16 *) a - (int) *(const word16 *) b;
+}
+
+static void prefetchdirs (const byte *buf)
+{
+	word16	dcns[255];
+	int	i, n;
+
+	n = 0;
+	for (i = 0; i < 255; i++)
+	{
+		dcns[n] = *(const word16 *) (buf + 01000 + (2 * i));
+		if (dcns[n] != 0) n++;
+	}
+	qsort (dcns, n, sizeof (word16), dcncomp);
+	for (i = 0; i < n; i++)
+		rprefetch (dcntolbn (dcns[i]), 16);
+}
+
+#ifdef __unix__
+/* the fix-up walk below has to go one directory at a time, since it
+ * asks questions and changes things as it goes.  before it starts, the
+ * ufds are scanned read-only by several threads at once.  each thread
+ * has its own directory buffer and its own map of the clusters used by
+ * the ufds it scanned.  when all are done the maps are merged, and any
+ * cluster that shows up in two maps (or twice in one) is cross-linked.
+ * the merged map is kept in crossmap, so that the walk can say which
+ * file or directory a doubly allocated cluster already belongs to; the
+ * walk does all the reporting.  the scan's reads go around the
+ * directory cache, so each ufd is read twice, but the threads bring
+ * them in from the disk in parallel and the walk finds them in the
+ * system's cache.
+ *
+ * the scan only looks.  it follows links as long as they look valid
+ * and leaves every repair to the walk.  it needs a disk that can be
+ * read from several threads (see rpread), and it isn't done for
+ * RDS0 packs, where clean doesn't walk the ufds.
+ */
+
+#define MAXSCAN	8			/* most threads to scan with */
+
+typedef struct
+{
+	word	dcn;			/* starting dcn of the ufd */
+	byte	proj, prog;		/*  and its ppn */
+} scanent;
+
+typedef struct
+{
+	byte	*buf;			/* directory buffer */
+	byte	*map;			/* clusters used by ufds scanned */
+	byte	*xmap;			/* clusters found more than once */
+	pthread_t tid;
+} scanwork;
+
+static scanent	*scanlist;		/* ufds to scan */
+static int	scancount, scannext;	/*  how many, and next to do */
+static pthread_mutex_t scanlock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ulk2 for the scan: it returns the offset of the entry in the buffer,
+ * or -1 if the link is null or invalid.  it touches no globals.
+ */
+static long scanlink (word link, const byte *buf)
+{
+	const fdcm *m;
+	int	clu, blk;
+	long	off;
+
+	if (NULLINK (link)) return -1;
+	m = (const fdcm *) (buf + 0760);
+	off = link & ul_eno;
+	clu = (link & ul_clo) >> sl_clo;
+	blk = (link & ul_blo) >> sl_blo;
+	if (blk >= m->uclus ||
+	    clu > 6 ||
+	    off == 0760 ||
+	    m->uent[clu] == 0)
+		return -1;
+	return off + (clu * m->uclus + blk) * BLKSIZE;
+}
+
+/* mark clusters as used in a scan thread's map, the way alloc does
+ * in sattbf2.  a cluster already marked goes into the thread's map of
+ * cross-linked clusters.
+ */
+static void scanmark (scanwork *w, word dcn, int clusiz)
+{
+	long	pos, n;
+	int	m;
+
+	if (clusiz < dcs && dcs > 16)
+		clusiz = dcs;		/* directories on large disks */
+	if (dcn == 0 || clusiz < dcs || (dcn - 1) % (clusiz / dcs))
+		return;
+	pos = dcntopcn (dcn);
+	if (pos >= pcns) return;
+	n = clusiz / pcs;
+	if (n == 0) n = 1;
+	if (pos + n > pcns) n = pcns - pos;
+	for ( ; n > 0; n--, pos++)
+	{
+		m = 1 << (pos % 8);
+		if (w->map[pos / 8] & m) w->xmap[pos / 8] |= m;
+		else w->map[pos / 8] |= m;
+	}
+}
+
+/* read a directory for the scan and mark its clusters.  unlike readdir
+ * it reads one cluster at a time, and it gives up (returning FALSE) on
+ * anything that doesn't look right.
+ */
+static int scanread (scanwork *w, word dcn)
+{
+	fdcm	*m;
+	int	i, clu;
+
+	if (dcn == 0 || dcntopcn (dcn) >= pcns) return FALSE;
+	if (!rpread (dcntolbn (dcn), BLKSIZE, w->buf)) return FALSE;
+	m = (fdcm *) (w->buf + 0760);
+	clu = m->uclus;
+	if (m->uent[0] != dcn ||
+	    clu == 0 ||
+	    clu > 16 ||
+	    (clu & (-clu)) != clu)
+		return FALSE;
+	for (i = 0; i < 7; i++)
+	{
+		if (m->uent[i] == 0) break;
+		if (dcntopcn (m->uent[i]) >= pcns ||
+		    !rpread (dcntolbn (m->uent[i]), BLKSIZE * clu,
+			     w->buf + i * clu * BLKSIZE))
+			return FALSE;
+	}
+	for (i = 0; i < 7; i++)
+	{
+		if (m->uent[i] == 0) break;
+		scanmark (w, m->uent[i], clu);
+	}
+	return TRUE;
+}
+
+/* scan one ufd: mark the clusters of every file that the walk would
+ * allocate (see cleanfile).  chains are cut off after as many steps as
+ * the ufd has blockettes, in case they loop.
+ */
+static void scanufd (scanwork *w, const scanent *s)
+{
+	byte	*buf = w->buf;
+	ufdne	*n;
+	ufdre	*r;
+	long	off, steps;
+	word	link;
+	int	clu, i;
+	char	name[11];
+
+	if (!scanread (w, s->dcn)) return;
+	steps = dirmapsize * 8;
+	link = ((ufdlabel *) buf)->ulnk;
+	while (--steps > 0 && (off = scanlink (link, buf)) >= 0)
+	{
+		n = (ufdne *) (buf + off);
+		link = n->ulnk;
+		if ((n->ustat & (us_del | us_ufd | us_out)) ||
+		    n->unam[2] == TMP)
+			continue;
+		if (s->proj == 0 && s->prog == 1)
+		{
+			memset (name, 0, sizeof (name));
+			r50filename (n->unam, name, 0);
+			if (strcmp (name, "badb.sys") == 0) continue;
+		}
+		if ((off = scanlink (n->uaa, buf)) < 0) continue;
+		clu = ((ufdae *) (buf + off))->uclus;
+		if (clu > 256 || clu < pcs || (clu & (-clu)) != clu)
+			continue;
+		for (off = scanlink (n->uar, buf);
+		     off >= 0 && --steps > 0;
+		     off = scanlink (r->ulnk, buf))
+		{
+			r = (ufdre *) (buf + off);
+			for (i = 0; i < 7; i++)
+			{
+				if (r->uent[i] == 0) break;
+				scanmark (w, r->uent[i], clu);
+			}
+		}
+	}
+}
+
+static void *scanthread (void *arg)
+{
+	scanwork *w = (scanwork *) arg;
+	int	n;
+
+	for (;;)
+	{
+		pthread_mutex_lock (&scanlock);
+		n = scannext++;
+		pthread_mutex_unlock (&scanlock);
+		if (n >= scancount) return NULL;
+		scanufd (w, &scanlist[n]);
+	}
+}
+
+static int scancomp (const void *a, const void *b)
+{
+	return (int) ((const scanent *) a)->dcn -
+		(int) ((const scanent *) b)->dcn;
+}
+
+/* build the list of ufds from the mfd and gfds (marking the clusters
+ * of those as we go), scan the ufds, and merge the maps.  if any
+ * clusters are cross-linked, crossmap is left pointing to them.
+ */
+static void prescan (void)
+{
+	scanwork w[MAXSCAN];
+	word16	gdcn[255], *dcnp, *unep;
+	gfdne	*n;
+	long	off, x, i;
+	int	nw, started, j, proj, prog;
+
+	if ((nw = rconcurrent ()) == 0) return;
+	if (nw > MAXSCAN) nw = MAXSCAN;
+	for (j = 0; j < nw; j++)
+	{
+		if ((w[j].buf = (byte *) malloc (dirbufsize)) == NULL ||
+		    (w[j].map = (byte *) calloc (sattsize, 1)) == NULL ||
+		    (w[j].xmap = (byte *) calloc (sattsize, 1)) == NULL)
+			rabort (NOMEM);
+	}
+	if ((scanlist = (scanent *) malloc (255 * 255 * sizeof (scanent)))
+	    == NULL) rabort (NOMEM);
+	scancount = scannext = 0;
+
+	/* the pack label and the mfd, then each gfd in the mfd */
+	if (pflags & uc_new) scanmark (&w[0], 1, pcs);
+	if (scanread (&w[0], mfddcn))
+	{
+		memcpy (gdcn, w[0].buf + 01000, sizeof (gdcn));
+		prefetchdirs (w[0].buf);
+		for (proj = 0; proj < 255; proj++)
+		{
+			if (!scanread (&w[0], gdcn[proj])) continue;
+			for (prog = 0; prog < 255; prog++)
+			{
+				dcnp = (word16 *) (w[0].buf + 01000 + (2 * prog));
+				unep = (word16 *) (w[0].buf + 02000 + (2 * prog));
+				if (*dcnp == 0 ||
+				    (off = scanlink (*unep, w[0].buf)) < 0)
+					continue;
+				n = (gfdne *) (w[0].buf + off);
+				if ((n->ustat & (us_del | us_ufd)) != us_ufd)
+					continue;
+				scanlist[scancount].dcn = *dcnp;
+				scanlist[scancount].proj = proj;
+				scanlist[scancount].prog = prog;
+				scancount++;
+			}
+		}
+	}
+
+	/* scan the ufds in lbn order, this thread helping the others */
+	qsort (scanlist, scancount, sizeof (scanent), scancomp);
+	for (started = 1; started < nw && started < scancount; started++)
+		if (pthread_create (&w[started].tid, NULL, scanthread,
+				    &w[started]) != 0)
+			break;
+	scanthread (&w[0]);
+	for (j = 1; j < started; j++)
+		pthread_join (w[j].tid, NULL);
+	if (sw.debug != NULL)
+		printf ("\nprescan: %d ufds, %d threads\n", scancount, started);
+
+	/* merge the maps into the first one */
+	for (j = 1; j < started; j++)
+		for (i = 0; i < sattsize; i++)
+		{
+			w[0].xmap[i] |= w[j].xmap[i] | (w[0].map[i] & w[j].map[i]);
+			w[0].map[i] |= w[j].map[i];
+		}
+	x = 0;
+	for (i = 0; i < pcns; i++)
+		if (w[0].xmap[i / 8] & (1 << (i % 8))) x++;
+	if (sw.debug != NULL)
+		printf ("prescan: %ld cross-linked clusters\n", x);
+	if (x != 0)
+	{
+		crossmap = w[0].xmap;
+		w[0].xmap = NULL;
+	}
+
+	for (j = 0; j < nw; j++)
+	{
+		free (w[j].buf);
+		free (w[j].map);
+		free (w[j].xmap);
+	}
+	free (scanlist);
+	scanlist = NULL;
+}
+#endif
+
 /* this function writes back a directory.  no validation is done, since
  * that was all done before.
  */
@@ -427,6 +756,55 @@ static void dealloc (word pos, int clusiz)
 	}
 }
 
+/* the pcns of a cluster, the way alloc sees it */
+static long crossrange (word pos, int clusiz, long *n)
+{
+	if (clusiz < dcs && dcs > 16)
+		clusiz = dcs;		/* directories on large disks */
+	*n = clusiz / pcs;
+	if (*n == 0) *n = 1;
+	return dcntopcn (pos);
+}
+
+/* after a cluster has been allocated, remember who it went to if the
+ * pre-scan found it (or part of it) cross-linked.
+ */
+static void crossnote (word pos, int clusiz, const char *owner)
+{
+	long	p, n;
+
+	if (crossmap == NULL) return;
+	for (p = crossrange (pos, clusiz, &n); n > 0; n--, p++)
+	{
+		if (p >= pcns) return;
+		if ((crossmap[p / 8] & (1 << (p % 8))) == 0) continue;
+		if (crosscount == crossmax)
+		{
+			crossmax = crossmax ? crossmax * 2 : 16;
+			crosslist = (crossent *) realloc (crosslist,
+				crossmax * sizeof (crossent));
+			if (crosslist == NULL) rabort (NOMEM);
+		}
+		crosslist[crosscount].pcn = p;
+		strcpy (crosslist[crosscount].owner, owner);
+		crosscount++;
+	}
+}
+
+/* find who already has a doubly allocated cluster; NULL if not known */
+static const char *crossowner (word pos, int clusiz)
+{
+	long	p, n;
+	int	i;
+
+	if (crossmap == NULL) return NULL;
+	for (p = crossrange (pos, clusiz, &n); n > 0; n--, p++)
+		for (i = 0; i < crosscount; i++)
+			if (crosslist[i].pcn == p)
+				return crosslist[i].owner;
+	return NULL;
+}
+
 /* common directory cleanup
  * this function reads a directory into the indicated buffer, clears
  * out the blockette map, and validates all the fdcm's.  if it's happy,
@@ -449,6 +827,7 @@ static retcode cleandir (word dcn, int clu,
 	retcode	st, ret = ok;
 	mfdlabel *l;
 	word16	id;
+	const char *owner;
 	
 	/* figure out what we're cleaning */
 	if (prog == 255)
@@ -610,6 +989,8 @@ static retcode cleandir (word dcn, int clu,
 	{
 		if (first->uent[i] == 0) break;
 		st = alloc (first->uent[i], clu);
+		if (st == ok || st == badblock)
+			crossnote (first->uent[i], clu, curdir);
 		switch (st)
 		{
 		    case ok:
@@ -629,7 +1010,10 @@ static retcode cleandir (word dcn, int clu,
 			break;
 		    default: rabort (INTERNAL);
 		}
-		printf (", dcn %d in directory %s\n", first->uent[i], curdir);
+		printf (", dcn %d in directory %s", first->uent[i], curdir);
+		if (st == dup && (owner = crossowner (first->uent[i], clu)) != NULL)
+			printf (" (already in %s)", owner);
+		printf ("\n");
 		if (st != badblock)	/* bad blk is warning, others quit */
 		{
 			while (i > 0) dealloc (first->uent[--i], clu);
@@ -769,6 +1153,7 @@ static retcode cleanfile (ufdne *n, byte *buf, byte *map)
 	word	prev;
 	char	name[11];
 	long	dfsize;			/* file size currently in dir */
+	const char *owner;
 	
 	memset (name, 0, sizeof (name));
 	init = satt = badb = 0;		/* not one of the special files */
@@ -881,6 +1266,8 @@ static retcode cleanfile (ufdne *n, byte *buf, byte *map)
 			if (badb || (n->ustat & us_out))
 				st = ok;
 			else	st = alloc (r->uent[i], clu);
+			if (st == ok || st == badblock)
+				crossnote (r->uent[i], clu, curfile);
 			switch (st)
 			{
 			    case ok:
@@ -914,6 +1301,9 @@ static retcode cleanfile (ufdne *n, byte *buf, byte *map)
 				rabort (INTERNAL);
 			}
 			printf (", dcn %d in file %s", r->uent[i], curfile);
+			if (st == dup &&
+			    (owner = crossowner (r->uent[i], clu)) != NULL)
+				printf (" (already in %s)", owner);
 			if (sysfile) rabort (BADPAK);
 			printf (" -- file will be truncated\n");
 			while (i < 7) r->uent[i++] = 0;
@@ -1204,6 +1594,7 @@ static int cleangfd (word dcn, retcode proj)
 	}
 	
 	/* now process each user */
+	prefetchdirs (gfdbuf);
 	for (prog = 0; prog < 255; prog++)
 	{
 		dcnp = (word16 *) (gfdbuf + 01000 + (2 * prog));
@@ -1450,6 +1841,7 @@ static void cleannewmfd (void)
 	}
 	
 	/* now process each group */
+	prefetchdirs (mfdbuf);
 	for (proj = 0; proj < 255; proj++)
 	{
 		dcnp = (word16 *) (mfdbuf + 01000 + (2 * proj));
@@ -1489,7 +1881,9 @@ static void cleannewmfd (void)
 	finishdir (mfdbuf, mfdmap);
 }
 
-/* go clean the mfd for an old format (RDS0) disk */
+/* go clean the mfd for an old format (RDS0) disk.  only the mfd itself
+ * is read here, so there is nothing to read ahead or to scan first.
+ */
 static void cleanoldmfd (void)
 {
 	retcode	ret;
@@ -1701,6 +2095,10 @@ void doclean (int argc, char **argv)
 	if (ufdmap != NULL) free (ufdmap);
 	if ((ufdmap = (byte *) malloc (dirmapsize)) == NULL) rabort (NOMEM);
 	
+	if (crossmap != NULL) free (crossmap);
+	crossmap = NULL;
+	crosscount = 0;
+
 	/* init stats */
 	gfds = ufds = files = clusters = 0;
 
@@ -1721,6 +2119,9 @@ void doclean (int argc, char **argv)
 	cleanlabel ();
 	
 	/* now do the rest of the file structure */
+#ifdef __unix__
+	if (plevel) prescan ();
+#endif
 	if (plevel) cleannewmfd ();
 	else cleanoldmfd ();
 	
@@ -1778,6 +2179,7 @@ void doclean (int argc, char **argv)
 		if (sw.prot == NULL)
 		{
 			memcpy (sattbufp, sattbf2, sattsize);
+			sattinval ();
 			MARKS;		/* indicate SATT needs writing */
 		}
 	}
@@ -22,7 +22,7 @@ static byte toprint (byte c)
 	return ('.');
 }
 
-static void dumpbuf (firqb *f, word16 *buf, long count, long firstbyte)
+static void dumpbuf (firqb *f, const word16 *buf, long count, long firstbyte)
 {
 	int	b;
 	long	off, block;
@@ -86,8 +86,8 @@ static void dumpdisk (void)
 		iocount = (endblk - lbn) * BLKSIZE;
 		if (iocount > iobufsize) iocount = iobufsize;
 		if (iocount <= 0) return;
-		rread (lbn, iocount, iobuf);
-		dumpbuf (NULL, (word16 *) iobuf, iocount, totalbytes);
+		dumpbuf (NULL, (const word16 *) rmapread (lbn, iocount, iobuf),
+			 iocount, totalbytes);
 		totalbytes += iocount;
 	}
 } 
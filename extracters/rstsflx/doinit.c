@@ -76,7 +76,7 @@ const word16	dummyboot[] = {
 
 void doinit (int argc, char **argv)
 {
-	long		n, count, sattblks;
+	long		n, sattblks;
 	firqb		f, packid;
 	long		newclu, newsize, newrsize;
 	int		dec166;
@@ -174,12 +174,10 @@ void doinit (int argc, char **argv)
 			perror (progname);	/* report any details */
 			return;
 		}
-		memset (iobuf, 0, iobufsize);	/* zero the entire buffer */
-		for (n = 0; n < newsize; n += iobufsize / BLKSIZE) {
-			count = iobufsize / BLKSIZE;
-			if (newsize - n < count) count = newsize - n;
-			rwrite (n, count * BLKSIZE, iobuf);
-		}
+		rzero (0, newsize);		/* zero the whole container */
+		if (sw.verbose != NULL && rspace () >= 0)
+			printf ("%ld of %ld container blocks allocated\n",
+				rspace (), newsize);
 		if (dec166) {			/* set up bad block table */
 			word16 *w;
 			memset (iobuf, -1, BLKSIZE);	/* set end marker */
@@ -229,6 +227,7 @@ void doinit (int argc, char **argv)
 	memset (sattbufp, 0xff, sattsize);	/* first mark everything in use */
 	memset (sattbufp, 0, pcns / 8);		/* make all real clusters free */
 	if (pcns & 7) sattbufp[pcns / 8] = 0xff << (pcns & 7); /* ditto any leftover bits */
+	sattinval ();				/* new SATT, no free counts */
 	satptr = 0;				/* MFD/label goes at the start */
 	if (plevel == RDS0) {			/* doing an old pack */
 		if (!extdir2 (0, MFDCLU, 0, &newmlabel)) rabort(INTERNAL);
@@ -265,6 +264,7 @@ void doinit (int argc, char **argv)
 				printf ("merged %s (%ld blocks)\n",
 					sw.merge, mblocks);
 		} else	*sattbufp = 0x01;	/* mark first cluster (pack label) allocated */
+		sattinval ();			/* SATT changed directly */
 		satptr = pcns / 2;		/* put the rest in the middle */
 		mfdclu = MFDCLU;		/* default MFD clustersize */
 		if (pcs > mfdclu) mfdclu = pcs;
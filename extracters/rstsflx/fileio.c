@@ -337,6 +337,17 @@ void fileseek (firqb *f, long vbn)	/* seek to (0-based) vbn */
 	curvbn = vbn;			/*   and finally, current vbn */
 }
 
+/* seqio handler for binary get: leaves the data where rmapread found
+ * it rather than copying it into the buffer.
+ */
+
+static const void *mapdata;
+
+static void mapio (long block, long size, void *buffer)
+{
+	mapdata = rmapread (block, size, buffer);
+}
+
 /* get a RSTS file and copy it to a specified local file.  Transfers in
  * binary (block) mode or ascii (record) mode according to the third
  * argument.  The return value is the count of bytes transferred.
@@ -352,8 +363,8 @@ long getfile (FILE *to, firqb *f, int binary)
 	openfile (f);			/* set up file transfer */
 	totalbytes = 0;
 	if (binary) {
-		while ((iocount = seqio (f, iobufsize, rread, iobuf)) != 0) {
-			fwrite (iobuf, 1, iocount, to);
+		while ((iocount = seqio (f, iobufsize, mapio, iobuf)) != 0) {
+			fwrite (mapdata, 1, iocount, to);
 			totalbytes += iocount;
 		}
 	} else {
@@ -23,7 +23,7 @@ int	fiblkw;			/* TRUE if FIBUF needs to be written back */
 
 void fbwrite (void)		/* write current block from fibuf */
 {
-	rwrite (fiblk, BLKSIZE, fibuf);
+	dcwrite (fiblk, fibuf);
 	fiblkw = FALSE;
 }
 
@@ -37,7 +37,7 @@ void fbread (long block)		/* read block into fibuf if needed */
 	if (fiblk != block)
 	{
 		checkwrite ();
-		rread (block, BLKSIZE, fibuf);
+		dcread (block, fibuf);
 		fiblk = block;
 	}
 }
@@ -111,120 +111,166 @@ int readlktbl (word link)
 	return (readlk (link));			/* now do the actual read */
 }
 
-/* utility routines for getclu */
-
-/* both of these scan the satt from "start" through "last", looking
- * to allocate a chunk of "clucount" clusters, with clustersize
- * "clusiz" (i.e., aligned on "clusiz" boundary) -- both of the latter
- * being expressed as a count of pack clusters.
- * scanbytes works for clusiz >= 8, where the scan is for whole bytes of
- * zero.  scanbits works for smaller clusiz values, and looks for fields
- * of zero bits.  In both cases, if a spot is found, it is allocated,
- * satptr is set to the next cluster after the allocated area, and the
- * start DCN returned; zero means failure (and SATT and satptr are 
- * unchanged).
+/* SATT scanning.  The SATT is looked at 64 bits at a time, and a count
+ * of free clusters is kept for each SATT block (region) once allocation
+ * starts, so that fully allocated regions can be skipped with a single
+ * test and an allocation that can't fit fails without scanning at all.
+ * getclu and retclu keep the counts up to date; anything else that
+ * changes the SATT in memory must call sattinval.
  */
 
-long scanbytes (long start, long last, int clusiz, long clucount)
+typedef unsigned long long	sattword;
+
+#define SATREGION	(BLKSIZE * 8)	/* clusters per SATT block */
+
+int	*sattfree;		/* free clusters per region, or NULL */
+long	sattotal;		/* total free clusters */
+
+#ifdef __GNUC__
+#define ctz64(x)	__builtin_ctzll (x)
+#define popc64(x)	__builtin_popcountll (x)
+#else
+static int ctz64 (sattword x)
 {
-	long	clusizbyt, clu, cluoff, clucountbyt, found;
-	byte	*s;
+	int	n;
+
+	for (n = 0; (x & 1) == 0; n++) x >>= 1;
+	return (n);
+}
+
+static int popc64 (sattword x)
+{
+	int	n;
+
+	for (n = 0; x != 0; n++) x &= x - 1;
+	return (n);
+}
+#endif
+
+/* fetch SATT bits w*64 through w*64+63, lowest numbered cluster in
+ * the low order bit, regardless of host byte order.
+ */
+
+static sattword satword (long w)
+{
+	const byte	*p = sattbufp + w * 8;
+
+	return ((sattword) p[0] | (sattword) p[1] << 8 |
+		(sattword) p[2] << 16 | (sattword) p[3] << 24 |
+		(sattword) p[4] << 32 | (sattword) p[5] << 40 |
+		(sattword) p[6] << 48 | (sattword) p[7] << 56);
+}
+
+void sattinval (void)		/* SATT changed, drop free counts */
+{
+	free (sattfree);
+	sattfree = NULL;
+}
 
-	clusizbyt = clusiz / 8;		/* byte alignment needed */
-	clucountbyt = clucount / 8;	/* allocation size in bytes */
-	s = sattbufp + (start / 8);	/* byte pointer to start of scan */
-	for (clu = start; clu <= last; clu += clusiz, s+= clusizbyt)
+static void satcount (void)	/* set up free counts if needed */
+{
+	long	r, w, n;
+
+	if (sattfree != NULL) return;
+	n = sattsize / BLKSIZE;
+	if ((sattfree = (int *) malloc (n * sizeof (int))) == NULL) 
+		rabort(NOMEM);
+	sattotal = 0;
+	for (r = 0; r < n; r++)
 	{
-		if (*s != 0)
-			continue;	/* if not free, keep scanning */
-		found = TRUE;		/* found something... */
-		for (cluoff = 1; cluoff < clucountbyt; cluoff++) 
-			if (*(s + cluoff) != 0)
-			{
-				cluoff = DOWN(cluoff,clusizbyt);
-				s += cluoff;
-				clu += cluoff * 8;
-				found = FALSE;	/* never mind... */
-				break;
-			}
-		if (!found)
-			continue;	/* keep going if no luck */
-		for (cluoff = 0; cluoff < clucountbyt; cluoff++) *s++ = 0xff;
-		satptr = clu + clucount;	/* update satptr */
-		MARKS;				/* SATT is dirty */
-		return (pcntodcn(clu));
+		sattfree[r] = SATREGION;
+		for (w = r * SATREGION / 64; w < (r + 1) * SATREGION / 64; w++)
+			sattfree[r] -= popc64 (satword (w));
+		sattotal += sattfree[r];
 	}
-	return (0);				/* nothing found */
 }
 
-long scanbits (long start, long last, int clusiz, long clucount)
+/* return the first cluster at or after "pos" and before "limit" that
+ * is allocated (if used is TRUE) or free (if FALSE); "limit" if none.
+ */
+
+static long satfind (long pos, long limit, int used)
 {
-	long	mask, mask1, mask2, cluoff, clu, found;
-	byte	*s, *s2;
-
-	clucount /= clusiz;		/* make it count of file clusters */
-	mask1 = (1 << clusiz) - 1;	/* mask to match on */
-	s = sattbufp + start / 8;	/* byte pointer to start of scan */
-	mask = mask1 << (start % 8);	/* form starting bit field */
-	for (clu = start; clu <= last; clu += clusiz)
+	long		w;
+	sattword	x;
+
+	satcount ();
+	while (pos < limit)
 	{
-		if ((*s & mask) != 0)	/* not all free, keep looking... */
+		if (sattfree[pos / SATREGION] == (used ? SATREGION : 0))
 		{
-			if (mask < 0x80)
-				mask <<= clusiz;
-			else
-			{
-				mask = mask1;
-				s++;
-			}
-			continue;
+			pos = (pos / SATREGION + 1) * SATREGION;
+			continue;	/* nothing of interest in region */
 		}
-		found = TRUE;		/* found something... */
-		mask2 = mask;		/* now look for contiguous piece */
-		s2 = s;
-		for (cluoff = 0; cluoff < clucount; cluoff++)
+		w = pos / 64;
+		x = satword (w);
+		if (!used) x = ~x;
+		x &= ~(sattword) 0 << (pos % 64);
+		if (x != 0)
 		{
-			if ((*s2 & mask2) != 0)	/* not all free, keep looking... */
-			{
-				clu += cluoff;
-				if (mask2 < 0x80)
-					mask2 <<= clusiz;
-				else
-				{
-					mask2 = mask1;
-					s2++;
-				}
-				s = s2;
-				mask = mask2;	/* continue just past here */
-				found = FALSE;	/* never mind... */
-				break;
-			}
-			if (mask2 < 0x80)
-				mask2 <<= clusiz;
-			else
-			{
-				mask2 = mask1;
-				s2++;
-			}
+			pos = w * 64 + ctz64 (x);
+			break;
 		}
-		if (!found)
-			continue;	/* keep going if no luck */
-		for (cluoff = 0; cluoff < clucount; cluoff++)
+		pos = (w + 1) * 64;
+	}
+	if (pos > limit) pos = limit;
+	return (pos);
+}
+
+/* sattrun returns the end (exclusive) of the run of clusters starting
+ * at "pos" that are all allocated or all free, stopping at "limit".
+ * *used tells which kind of run it was.
+ */
+
+long sattrun (long pos, long limit, int *used)
+{
+	*used = (sattbufp[pos / 8] >> (pos % 8)) & 1;
+	return (satfind (pos, limit, !*used));
+}
+
+/* set (used TRUE) or clear "count" SATT bits starting at "pos" */
+
+static void satmark (long pos, long count, int used)
+{
+	long	end;
+	int	m, n, d;
+	byte	*s;
+
+	for (end = pos + count; pos < end; pos += n)
+	{
+		s = sattbufp + pos / 8;
+		n = 8 - pos % 8;	/* bits to do in this byte */
+		if (n > end - pos) n = end - pos;
+		m = ((1 << n) - 1) << (pos % 8);
+		if (sattfree != NULL)
 		{
-			*s |= mask;
-			if (mask < 0x80)
-				mask <<= clusiz;
-			else
-			{
-				mask = mask1;
-				s++;
-			}
+			d = popc64 ((used ? ~*s : *s) & m);  /* bits changing */
+			if (used) d = -d;
+			sattfree[pos / SATREGION] += d;
+			sattotal += d;
 		}
-		satptr = clu + clucount;	/* update satptr */
-		MARKS;				/* SATT is dirty */
-		return (pcntodcn(clu));
+		if (used) *s |= m;
+		else	  *s &= ~m;
+	}
+}
+
+/* look for "clucount" free clusters starting on a multiple of "clusiz",
+ * at a cluster from "start" through "last".  Returns the starting 
+ * cluster, or -1 if there is no such spot.
+ */
+
+static long satfit (long start, long last, long clusiz, long clucount)
+{
+	long	pos, end;
+
+	for (pos = start; pos <= last; pos = UP(end + 1,clusiz))
+	{
+		pos = UP(satfind (pos, last + 1, FALSE),clusiz);
+		if (pos > last) break;
+		end = satfind (pos, pos + clucount, TRUE);
+		if (end == pos + clucount) return (pos);
 	}
-	return (0);				/* nothing found */
+	return (-1);
 }
 
 /* getclu allocates clusters of the specified size, for a file of specified
@@ -234,13 +280,15 @@ long scanbits (long start, long last, int clusiz, long clucount)
  * is returned.
  * A single allocation is done, so the "size" argument should be equal to
  * the clustersize unless a contiguous allocation is being done.
+ * The scan starts at satptr and wraps around to the start of the SATT;
+ * satptr is left just past what was allocated.
  */
 
 int	pcs;				/* pack clustersize */
 
 long getclu (int clusiz, long size)
 {
-	long	start, alloc, clucount;
+	long	start, clu, clucount;
 
 	if (sw.debug != NULL)
 		printf ("getclu(%d,%ld)\n", clusiz, size);
@@ -252,21 +300,19 @@ long getclu (int clusiz, long size)
 		rabort(INTERNAL);
 	if (clucount <= 0)
 		rabort(INTERNAL);
+	satcount ();
+	if (sattotal < clucount)
+		return (0);		/* can't possibly fit */
 	start = UP(satptr,clusiz);	/* align start of scan */
-	if (clusiz < 8)			/* scanning bitwise */
-	{
-		alloc = scanbits (start, pcns - clucount, clusiz, clucount);
-		if (alloc)
-			return (alloc);	/* found it in rest of satt */
-		return (scanbits (0, start - clusiz, clusiz, clucount));
-	}
-	else				/* scanning whole bytes */
-	{
-		alloc = scanbytes (start, pcns - clucount, clusiz, clucount);
-		if (alloc)
-			return (alloc);	/* found it in rest of satt */
-		return (scanbytes (0, start - clusiz, clusiz, clucount));
-	}
+	clu = satfit (start, pcns - clucount, clusiz, clucount);
+	if (clu < 0)			/* not in rest of satt, try the front */
+		clu = satfit (0, start - clusiz, clusiz, clucount);
+	if (clu < 0)
+		return (0);
+	satmark (clu, clucount, TRUE);
+	satptr = clu + clucount;	/* update satptr */
+	MARKS;				/* SATT is dirty */
+	return (pcntodcn(clu));
 }
 
 /* retclu returns a single cluster.  "pos" is the DCN of the cluster,
@@ -275,9 +321,6 @@ long getclu (int clusiz, long size)
 
 void retclu (long pos, int clusiz)
 {
-	long	m, n;
-	byte	*s;
-
 	if (sw.debug != NULL)
 		printf ("retclu(%lo,%d)\n", pos, clusiz);
 	if (sattsize == 0) 
@@ -286,18 +329,7 @@ void retclu (long pos, int clusiz)
 	clusiz /= pcs;			/* fcs as count of clusters */
 	if (clusiz <= 0)
 		rabort(INTERNAL);
-	s = sattbufp + pos / 8;		/* byte pointer to start of cluster */
-	if (clusiz < 8)			/* scanning bitwise */
-	{
-		m = (1 << clusiz) - 1;	/* mask to match on */
-		m <<= (pos % 8);	/* form starting bit field */
-		*s &= ~m;		/* free this cluster */
-	}
-	else				/* scanning whole bytes */
-	{
-		clusiz /= 8;		/* change to count of bytes to free */
-		for (n = 0; n < clusiz; n++) *s++ = 0;
-	}
+	satmark (pos, clusiz, FALSE);	/* free this cluster */
 	MARKS;				/* mark SATT dirty */
 }
 
@@ -1472,6 +1504,7 @@ void findsat (void)
 	readlk (f.rlink);
 	sattlbn = dcntolbn(use(ufdre,k)->uent[0]);
 	rread (sattlbn, sattsize, sattbufp);
+	sattinval ();			/* no free counts yet */
 	satptr = 0;			/* nothing allocated yet */
 }
 
@@ -1511,6 +1544,7 @@ void rmountrw (void)			/* mount the RSTS pack read/write */
 		p->mnttim = curtime ();
 	}
 	fbwrite ();			/* write it back */
+	dcflush ();			/*  right now */
 }
 
 void rumount (void)			/* dismount for users of rmount() */
@@ -1532,6 +1566,7 @@ void rumountrw (void)			/* dismount (no longer read/write) */
 		rwrite (sattlbn, sattsize, sattbufp);
 	womsat = FALSE;			/* SATT written out if needed */
 	free (sattbufp);		/* release satt memory copy */
+	dcflush ();			/* directories before the label */
 	p->pstat &= ~uc_mnt;		/* mark no longer mounted */
 	if (plevel >= RDS12)		/* if new pack */
 	{
@@ -14,8 +14,8 @@ extern int readlk(word link);
 extern int readlktbl(word link);
 		/* Prototype include a typedef name.
 		   It should be moved after the typedef declaration */
-extern long scanbytes(long start , long last , int clusiz , long clucount);
-extern long scanbits(long start , long last , int clusiz , long clucount);
+extern void sattinval(void);
+extern long sattrun(long pos , long limit , int * used);
 extern long getclu(int clusiz , long size);
 extern void retclu(long pos , int clusiz);
 extern void readlabel(void);
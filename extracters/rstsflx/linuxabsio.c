@@ -10,6 +10,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <asm/ioctl.h>
 #include <linux/fs.h>
 #include <linux/hdreg.h>
@@ -71,9 +72,8 @@ static void flushtrack (void)
 {
 	if (writecurrent)
 	{
-		lseek (floppy, curtrack * sizeof (trackbuf), SEEK_SET);
-		if (write (floppy, trackbuf, sizeof (trackbuf)) !=
-		    sizeof (trackbuf))
+		if (pwrite (floppy, trackbuf, sizeof (trackbuf),
+			    curtrack * sizeof (trackbuf)) != sizeof (trackbuf))
 			doabort (DISKIO, __FILE__, __LINE__);
 		writecurrent = FALSE;
 	}
@@ -84,9 +84,8 @@ static void gettrack (int track)
 	if (track != curtrack)
 	{
 		flushtrack ();
-		lseek (floppy, track * sizeof (trackbuf), SEEK_SET);
-		if (read (floppy, trackbuf, sizeof (trackbuf)) !=
-		    sizeof (trackbuf))
+		if (pread (floppy, trackbuf, sizeof (trackbuf),
+			   track * sizeof (trackbuf)) != sizeof (trackbuf))
 			doabort (DISKIO, __FILE__, __LINE__);
 		curtrack = track;
 	}
@@ -78,6 +78,7 @@ void doabort(int status, const char *srcfile, int srcline)
 	{
 		printf ("  in module %s, line %d\n", srcfile, srcline);
 	}
+	rflush ();		/* finish disk writes already done */
 	longjmp (mainbuf, 1);
 }
 